@@ -0,0 +1,90 @@
+// ClosestPrecedingNode on a finger table filled from a random ring, the
+// step every lookup takes once per hop. built once per id width, see
+// bench/CMakeLists.txt.
+//
+//   closest_preceding_bench_64 [ring sizes...]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "node/fingertable.h"
+
+using namespace tsc::node;
+using namespace tsc::type;
+
+namespace {
+constexpr int kRounds = 200;
+constexpr size_t kTargets = 1 << 16;
+
+NodeID RandomId(std::mt19937_64& rng) {
+  return static_cast<NodeID>(rng());
+}
+
+// fingers as a settled node would have them: finger i is the successor of
+// owner + 2^i in the ring
+void Fill(FingerTable& table, const std::set<NodeID>& ring) {
+  for (int i = 0; i < FingerTable::kSize; ++i) {
+    auto it = ring.lower_bound(table.GetStart(i));
+    if (it == ring.end()) {
+      it = ring.begin();
+    }
+    table.Set(i, NodeInfo{
+      .id_ = *it,
+      .address_ = {
+        .ip_ = "127.0.0.1",
+        .port_ = static_cast<u16>(1024 + *it % 60000),
+      },
+    });
+  }
+}
+
+void Run(size_t ring_size) {
+  std::mt19937_64 rng(7);
+  std::set<NodeID> ring;
+  while (ring.size() < ring_size) {
+    ring.insert(RandomId(rng));
+  }
+
+  PeerTable peers;
+  FingerTable table(*ring.begin(), peers);
+  Fill(table, ring);
+
+  std::vector<NodeID> targets(kTargets);
+  for (auto& target : targets) {
+    target = RandomId(rng);
+  }
+
+  // summed so the calls cannot be optimised away
+  u64 checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < kRounds; ++round) {
+    for (NodeID target : targets) {
+      auto node = table.ClosestPrecedingNode(target);
+      checksum += node ? static_cast<u64>(node->id_) : 0;
+    }
+  }
+  std::chrono::duration<double, std::nano> took =
+      std::chrono::steady_clock::now() - start;
+
+  std::cout << "bits " << kMBits << " ring " << ring_size << ": "
+            << took.count() / (kRounds * kTargets) << " ns/call (checksum "
+            << checksum << ")\n";
+}
+} // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    for (size_t ring_size : {8, 64, 1024, 65536}) {
+      Run(ring_size);
+    }
+    return 0;
+  }
+  for (int i = 1; i < argc; ++i) {
+    Run(std::strtoull(argv[i], nullptr, 10));
+  }
+  return 0;
+}
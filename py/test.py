@@ -23,11 +23,18 @@ class ChordClient:
     PUT_RESP = 0x13
 
     TIMEOUT = 1.0
+    # must match the binary's TSC_ID_BITS
+    ID_BITS = 32
+
+    @staticmethod
+    def _id_format() -> str:
+        return ">I" if ChordClient.ID_BITS == 32 else ">Q"
 
     @staticmethod
     def hash_key(key: str) -> int:
         digest = hashlib.sha1(key.encode()).digest()
-        return int.from_bytes(digest[:4], byteorder="little")
+        return int.from_bytes(digest[:ChordClient.ID_BITS // 8],
+                              byteorder="little")
 
     @staticmethod
     def _encode_string(s: str) -> bytes:
@@ -62,7 +69,8 @@ class ChordClient:
 
     @staticmethod
     def find_successor(host: str, port: int, key_id: int) -> Optional[tuple[int, str, int]]:
-        payload = bytes([ChordClient.FIND_SUCCESSOR_REQ]) + struct.pack(">I", key_id)
+        payload = (bytes([ChordClient.FIND_SUCCESSOR_REQ])
+                   + struct.pack(ChordClient._id_format(), key_id))
         resp = ChordClient._send_recv(host, port, payload)
 
         if resp is None or len(resp) < 2:
@@ -76,8 +84,10 @@ class ChordClient:
             return None
 
         offset = 2
-        node_id = struct.unpack(">I", resp[offset:offset + 4])[0]
-        offset += 4
+        id_bytes = ChordClient.ID_BITS // 8
+        node_id = struct.unpack(ChordClient._id_format(),
+                                resp[offset:offset + id_bytes])[0]
+        offset += id_bytes
         ip, offset = ChordClient._decode_string(resp, offset)
         node_port = struct.unpack(">H", resp[offset:offset + 2])[0]
         return (node_id, ip, node_port)
@@ -115,6 +125,7 @@ NUM_LEGIT_NODES = 5
 NUM_MALICIOUS_NODES = 10       # for eclipse/sybil attacks
 NUM_TEST_KEYS = 500            # key-value pairs for integrity testing
 NUM_RUNS = 3                   # num of runs to average out scenarios
+SKEW_DURATION = 15             # seconds of hot spot reads for the skew scenarios
 VERBOSE = False
 
 @dataclass
@@ -127,6 +138,8 @@ class ScenarioResult:
     keys_correct: int = 0
     lookup_success_rate: float = 0.0
     lookup_success_rate_std: float = 0.0
+    get_p50_ms: float = 0.0
+    get_p99_ms: float = 0.0
     module_metrics: dict = field(default_factory=dict)
     duration_seconds: float = 0.0
     runs: list = field(default_factory=list)
@@ -140,6 +153,7 @@ class Scenario:
     description: str = ""
     pre_store_attack: bool = False
     sybil_flags: list[str] = field(default_factory=list)
+    num_crash: int = 0
 
 
 SCENARIOS = {
@@ -235,6 +249,42 @@ SCENARIOS = {
         pre_store_attack=True,
         description="DoS flood during store and retrieve, with rate limiting",
     ),
+    # replication
+    "replication_r1_crash": Scenario(
+        name="replication_r1_crash",
+        security_flags=[],
+        attack_type="crash",
+        num_crash=1,
+        description="One node crashes after store, no replication",
+    ),
+    "replication_r3_crash": Scenario(
+        name="replication_r3_crash",
+        security_flags=["--replicas", "3"],
+        attack_type="crash",
+        num_crash=1,
+        description="One node crashes after store, 3 replicas (W=1, R=1)",
+    ),
+    "replication_r3_w2r2_crash": Scenario(
+        name="replication_r3_w2r2_crash",
+        security_flags=["--replicas", "3", "--write-quorum", "2",
+                        "--read-quorum", "2"],
+        attack_type="crash",
+        num_crash=1,
+        description="One node crashes after store, 3 replicas (W=2, R=2)",
+    ),
+    # load balancing
+    "skew_no_rebalance": Scenario(
+        name="skew_no_rebalance",
+        security_flags=[],
+        attack_type="skew",
+        description="Hot spot reads on a sixteenth of the ring, no rebalancing",
+    ),
+    "skew_rebalance": Scenario(
+        name="skew_rebalance",
+        security_flags=["--rebalance"],
+        attack_type="skew",
+        description="Hot spot reads on a sixteenth of the ring, with rebalancing",
+    ),
 }
 
 class NodeProcess:
@@ -408,12 +458,15 @@ class TestRing:
         time.sleep(1)
         return test_data
 
-    def verify_data(self, test_data: dict[str, str]) -> tuple[int, int]:
+    def verify_data(self, test_data: dict[str, str]) -> tuple[int, int, list[float]]:
         retrieved = 0
         correct = 0
+        latencies_ms = []
 
         for key, expected_value in test_data.items():
+            started = time.perf_counter()
             result = ChordClient.get("127.0.0.1", self.base_port, key)
+            latencies_ms.append((time.perf_counter() - started) * 1000)
             if result is not None:
                 retrieved += 1
                 if result == expected_value:
@@ -425,7 +478,7 @@ class TestRing:
 
         print(f"Verified: {correct}/{len(test_data)} correct")
         print(f"{retrieved}/{len(test_data)} retrieved")
-        return retrieved, correct
+        return retrieved, correct, latencies_ms
 
     def collect_metrics(self) -> list[dict]:
         all_metrics = []
@@ -490,6 +543,29 @@ def attack_dos(ring: TestRing):
     ring._flood_stop = stop_event
     ring._flood_threads = threads
 
+def attack_crash(ring: TestRing, num_crash: int):
+    # never the entry node, the harness talks to it
+    for node in ring.nodes[1 : 1 + num_crash]:
+        if node.process and node.process.poll() is None:
+            node.process.kill()
+            node.process.wait()
+            print(f"Crashed node on port {node.port}")
+
+
+def attack_skew(ring: TestRing):
+    # not an attack, just a skewed workload: every read goes to the keys in
+    # one sixteenth of the ring, spread over all entry nodes
+    hot = [f"test_key_{i}" for i in range(NUM_TEST_KEYS)
+           if ChordClient.hash_key(f"test_key_{i}")
+              < (1 << ChordClient.ID_BITS) // 16]
+    reads = 0
+    deadline = time.time() + SKEW_DURATION
+    while hot and time.time() < deadline:
+        for key in hot:
+            node = ring.nodes[reads % len(ring.nodes)]
+            ChordClient.get(node.ip, node.port, key)
+            reads += 1
+    print(f"Sent {reads} reads for {len(hot)} hot keys")
 
 
 ATTACK_FUNCTIONS = {
@@ -499,6 +575,8 @@ ATTACK_FUNCTIONS = {
       "eclipse": lambda ring, scenario: attack_eclipse(ring, scenario.num_sybil,
                                                        scenario.sybil_flags or None),
       "dos":     lambda ring, scenario: attack_dos(ring),
+      "crash":   lambda ring, scenario: attack_crash(ring, scenario.num_crash),
+      "skew":    lambda ring, scenario: attack_skew(ring),
   }
 
 
@@ -539,10 +617,12 @@ def run_scenario(binary: str, scenario: Scenario,
 
         time.sleep(METRICS_DELAY)
 
-        retrieved, correct = ring.verify_data(test_data)
+        retrieved, correct, latencies_ms = ring.verify_data(test_data)
         result.keys_retrieved = retrieved
         result.keys_correct = correct
         result.lookup_success_rate = correct / max(len(test_data), 1)
+        result.get_p50_ms = _percentile(latencies_ms, 50)
+        result.get_p99_ms = _percentile(latencies_ms, 99)
 
         metrics = ring.collect_metrics()
         result.module_metrics = metrics
@@ -555,6 +635,12 @@ def run_scenario(binary: str, scenario: Scenario,
 
 import statistics as _stats
 
+def _percentile(samples: list[float], pct: float) -> float:
+    if not samples:
+        return 0.0
+    ordered = sorted(samples)
+    return ordered[min(len(ordered) - 1, int(len(ordered) * pct / 100))]
+
 def _avg_module_metrics(all_runs_metrics: list[list[dict]]) -> list[dict]:
     """Average module counter/gauge values across runs, per node."""
     if not all_runs_metrics or not all_runs_metrics[0]:
@@ -607,6 +693,8 @@ def average_results(run_list: list[ScenarioResult]) -> ScenarioResult:
         keys_correct=round(_stats.mean(r.keys_correct for r in run_list)),
         lookup_success_rate=_stats.mean(rates),
         lookup_success_rate_std=_stats.stdev(rates) if len(rates) > 1 else 0.0,
+        get_p50_ms=_stats.mean(r.get_p50_ms for r in run_list),
+        get_p99_ms=_stats.mean(r.get_p99_ms for r in run_list),
         duration_seconds=_stats.mean(r.duration_seconds for r in run_list),
         module_metrics=_avg_module_metrics([r.module_metrics for r in run_list]),
         runs=[
@@ -615,6 +703,8 @@ def average_results(run_list: list[ScenarioResult]) -> ScenarioResult:
                 "keys_retrieved": r.keys_retrieved,
                 "keys_correct": r.keys_correct,
                 "lookup_success_rate": r.lookup_success_rate,
+                "get_p50_ms": r.get_p50_ms,
+                "get_p99_ms": r.get_p99_ms,
                 "duration_seconds": r.duration_seconds,
             }
             for i, r in enumerate(run_list)
@@ -636,6 +726,8 @@ def save_results_json(results: list[ScenarioResult], output_dir: str = "results"
             "keys_correct": r.keys_correct,
             "lookup_success_rate": r.lookup_success_rate,
             "lookup_success_rate_std": r.lookup_success_rate_std,
+            "get_p50_ms": r.get_p50_ms,
+            "get_p99_ms": r.get_p99_ms,
             "duration_seconds": r.duration_seconds,
             "module_metrics": r.module_metrics,
             "runs": r.runs,
@@ -670,8 +762,13 @@ def main():
         "--verbose", action="store_true",
         help="Show node stderr output for debugging"
     )
+    parser.add_argument(
+        "--id-bits", type=int, choices=(32, 64), default=32,
+        help="TSC_ID_BITS the binary was built with (default: 32)"
+    )
 
     args = parser.parse_args()
+    ChordClient.ID_BITS = args.id_bits
 
     global VERBOSE
     VERBOSE = args.verbose
@@ -734,6 +831,8 @@ def main():
         print(
             f"{r.scenario_name:<35} {r.attack_type:<10}"
             f"{r.lookup_success_rate*100:>6.1f}%"   
+            f"{r.get_p50_ms:>8.2f}ms p50"
+            f"{r.get_p99_ms:>8.2f}ms p99"
             f"{r.duration_seconds:>6.1f}s"
         )
     print(f"{'=' * 60}")
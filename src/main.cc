@@ -32,11 +32,14 @@ void print_usage(const char* program) {
 void print_help() {
     std::cout << "\nAvailable commands:\n"
               << "  put <key> <value>  - Store a key-value pair\n"
+              << "  putttl <key> <seconds> <value> - Store a pair that expires\n"
               << "  get <key>          - Retrieve a value\n"
+              << "  del <key>          - Delete a key\n"
+              << "  sync <ip:port>     - Pull whatever differs in our range from a peer\n"
               << "  state              - Show node state\n"
               << "  fingers            - Show finger table\n"
               << "  hash <string>      - Show hash of a string\n"
-              << "  metrics            - Print security module metrics as JSON\n"
+              << "  metrics            - Print node metrics as JSON\n"
               << "  help               - Show this help\n"
               << "  quit               - Leave the ring and exit\n\n";
 }
@@ -97,6 +100,43 @@ void run_interactive(node::Node& node) {
                 std::cout << "Failed to store key\n";
             }
         }
+        else if (cmd == "putttl") {
+            std::string key, value;
+            long seconds = 0;
+            iss >> key >> seconds;
+            std::getline(iss, value);
+
+            if (!value.empty() && value[0] == ' ') {
+                value = value.substr(1);
+            }
+
+            if (key.empty() || value.empty() || seconds <= 0) {
+                std::cout << "Usage: putttl <key> <seconds> <value>\n";
+                continue;
+            }
+
+            if (node.Put(key, value, std::chrono::seconds(seconds))) {
+                std::cout << "Stored: " << key << " -> " << value
+                          << " (expires in " << seconds << "s)\n";
+            } else {
+                std::cout << "Failed to store key\n";
+            }
+        }
+        else if (cmd == "del") {
+            std::string key;
+            iss >> key;
+
+            if (key.empty()) {
+                std::cout << "Usage: del <key>\n";
+                continue;
+            }
+
+            if (node.Remove(key)) {
+                std::cout << "Deleted: " << key << "\n";
+            } else {
+                std::cout << "Key not found\n";
+            }
+        }
         else if (cmd == "get") {
             std::string key;
             iss >> key;
@@ -113,6 +153,31 @@ void run_interactive(node::Node& node) {
                 std::cout << "Key not found\n";
             }
         }
+        else if (cmd == "sync") {
+            std::string target;
+            iss >> target;
+
+            auto colon = target.find(':');
+            if (colon == std::string::npos) {
+                std::cout << "Usage: sync <ip:port>\n";
+                continue;
+            }
+
+            type::NodeAddress peer{
+                .ip_ = target.substr(0, colon),
+                .port_ = static_cast<type::u16>(std::stoi(target.substr(colon + 1))),
+            };
+            // (predecessor, self], or the whole ring when alone
+            auto predecessor = node.GetPredecessor();
+            type::KeyID start = predecessor ? predecessor->id_ : node.ID();
+
+            auto pulled = node.SyncRange(peer, start, node.ID());
+            if (pulled) {
+                std::cout << "Synced " << *pulled << " records from " << target << "\n";
+            } else {
+                std::cout << "Sync with " << target << " failed\n";
+            }
+        }
         else if (cmd == "hash") {
             std::string str;
             iss >> str;
@@ -154,7 +219,21 @@ void parse_flags(int argc, char* argv[], int start_idx, node::Node::Config& conf
     }
 
     else if (flag == "--malicious")        config.is_malicious = true;
+    else if (flag == "--delay-ms" && i + 1 < argc) config.emulated_delay_ms = std::stoi(argv[++i]);
     else if (flag == "--ip" && i + 1 < argc) config.ip_ = argv[++i];
+    else if (flag == "--lsm-dir" && i + 1 < argc) config.lsm_dir = argv[++i];
+    else if (flag == "--max-bytes" && i + 1 < argc) config.storage_max_bytes = std::stoull(argv[++i]);
+    else if (flag == "--compress-min" && i + 1 < argc) config.compress_min_bytes = std::stoull(argv[++i]);
+    else if (flag == "--replicas" && i + 1 < argc) config.replication_factor = std::stoi(argv[++i]);
+    else if (flag == "--write-quorum" && i + 1 < argc) config.write_quorum = std::stoi(argv[++i]);
+    else if (flag == "--read-quorum" && i + 1 < argc) config.read_quorum = std::stoi(argv[++i]);
+    else if (flag == "--iterative")        config.iterative_lookup = true;
+    else if (flag == "--alpha" && i + 1 < argc) config.lookup_parallelism = std::stoi(argv[++i]);
+    else if (flag == "--pns")              config.proximity_fingers = true;
+    else if (flag == "--location-cache" && i + 1 < argc) config.location_cache_size = std::stoull(argv[++i]);
+    else if (flag == "--one-hop")          config.one_hop = true;
+    else if (flag == "--vnodes" && i + 1 < argc) config.virtual_nodes = std::stoi(argv[++i]);
+    else if (flag == "--rebalance")        config.rebalance = true;
 
     else if (flag == "--subnet-max" && i + 1 < argc) config.subnet_max_per = std::stoi(argv[++i]);
     else if (flag == "--rl-tokens" && i + 1 < argc)  config.rate_limit_max_tokes = std::stoi(argv[++i]);
@@ -6,8 +6,11 @@
 #include <netinet/in.h>
 #include <poll.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <array>
 #include <cerrno>
 #include <iostream>
 
@@ -16,6 +19,15 @@
 namespace tsc::tcp {
 using namespace tsc::msg;
 using namespace tsc::type;
+
+namespace {
+thread_local u64 requests_sent = 0;
+} // namespace
+
+u64 TcpClient::RequestsSent() {
+  return requests_sent;
+}
+
 int TcpClient::ConnectTo(const NodeAddress& target,
                          [[maybe_unused]] std::chrono::milliseconds timeout) {
   int sock = socket(AF_INET, SOCK_STREAM, 0);
@@ -51,15 +63,32 @@ int TcpClient::ConnectTo(const NodeAddress& target,
   return sock;
 }
 
-bool TcpClient::SendAll(int socket, const std::vector<std::byte>& data) {
-  size_t total_sent = 0;
-  while(total_sent < data.size()) {
-    ssize_t sent = send(socket, data.data() + total_sent,
-      data.size() - total_sent, 0);
-    if(sent <= 0) {
+bool TcpClient::SendAll(int socket, const std::vector<std::byte>& head,
+                        const std::vector<std::byte>& body) {
+  std::array<iovec, 2> parts{{
+    {.iov_base = const_cast<std::byte*>(head.data()),
+     .iov_len = head.size()},
+    {.iov_base = const_cast<std::byte*>(body.data()),
+     .iov_len = body.size()},
+  }};
+
+  size_t first = 0;
+  while (first < parts.size()) {
+    ssize_t sent = writev(socket, &parts[first],
+                          static_cast<int>(parts.size() - first));
+    if (sent <= 0) {
       return false;
     }
-    total_sent += sent;
+    auto remaining = static_cast<size_t>(sent);
+    while (first < parts.size() && remaining >= parts[first].iov_len) {
+      remaining -= parts[first].iov_len;
+      ++first;
+    }
+    if (first < parts.size()) {
+      parts[first].iov_base =
+          static_cast<std::byte*>(parts[first].iov_base) + remaining;
+      parts[first].iov_len -= remaining;
+    }
   }
   return true;
 }
@@ -71,26 +100,43 @@ std::optional<std::vector<std::byte>> TcpClient::ReceiveMessage(
   tv.tv_usec = (timeout.count() % 1000) * 1000;
   setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
 
-  std::vector<std::byte> buffer(4096);
-  ssize_t received = recv(socket, buffer.data(), buffer.size(), 0);
-
-  if(received < 0) {
-    return std::nullopt;
+  std::vector<std::byte> buffer;
+  size_t used = 0;
+  while(true) {
+    if(buffer.size() - used < 4096) {
+      buffer.resize(used + std::max<size_t>(4096, used));
+    }
+    ssize_t received = recv(socket, buffer.data() + used, buffer.size() - used, 0);
+    if(received == 0) {
+      break;
+    }
+    if(received < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+      // a timeout after some bytes still leaves a usable (if short) reply
+      if(used == 0) {
+        return std::nullopt;
+      }
+      break;
+    }
+    used += static_cast<size_t>(received);
   }
 
-  buffer.resize(received);
+  buffer.resize(used);
   return buffer;
 }
 
 std::optional<std::vector<std::byte>> TcpClient::SendRequest(
     const NodeAddress& target, const std::vector<std::byte>& request,
     std::chrono::milliseconds timeout) {
+  ++requests_sent;
   int sock = ConnectTo(target, timeout);
   if(sock < 0) {
     return std::nullopt;
   }
 
-  if(!SendAll(sock, request)) {
+  if(!SendAll(sock, RequestHeader(target.vnode_, request.size()), request)) {
     close(sock);
     return std::nullopt;
   }
@@ -143,6 +189,90 @@ std::optional<NodeInfo> TcpClient::GetPredecessor(const NodeAddress& target) {
   return std::nullopt;
 }
 
+std::optional<LookupHop> TcpClient::NextHop(const NodeAddress& target,
+                                           NodeID id, u8 more,
+                                           std::chrono::milliseconds timeout) {
+  auto response = SendRequest(target, EncodeNextHop(id, more), timeout);
+  if(!response) {
+    return std::nullopt;
+  }
+  return DecodeNextHop(std::move(*response));
+}
+
+std::vector<std::byte> TcpClient::EncodeNextHop(NodeID id, u8 more) {
+  return NextHopRequest{id, more}.Serialise();
+}
+
+std::optional<LookupHop> TcpClient::DecodeNextHop(
+    std::vector<std::byte> response) {
+  if(response.empty() ||
+     static_cast<MessageType>(response[0]) != MessageType::kNextHopResponse) {
+    return std::nullopt;
+  }
+
+  try {
+    return NextHopResponse::Deserialise(response).hop_;
+  }
+  catch(...) {}
+
+  return std::nullopt;
+}
+
+std::optional<MembershipDelta> TcpClient::PullMembership(
+    const NodeAddress& target, u64 since) {
+  auto response = SendRequest(target, MembershipRequest{since}.Serialise());
+
+  if(!response || response->empty() ||
+     static_cast<MessageType>((*response)[0]) !=
+         MessageType::kMembershipResponse) {
+    return std::nullopt;
+  }
+
+  try {
+    return std::move(MembershipResponse::Deserialise(*response).delta_);
+  }
+  catch(...) {}
+
+  return std::nullopt;
+}
+
+std::optional<LoadSummary> TcpClient::ExchangeLoad(const NodeAddress& target,
+                                                   const NodeInfo& sender,
+                                                   const LoadSummary& load) {
+  auto response = SendRequest(target, LoadRequest{sender, load}.Serialise());
+
+  if(!response || response->empty() ||
+     static_cast<MessageType>((*response)[0]) != MessageType::kLoadResponse) {
+    return std::nullopt;
+  }
+
+  try {
+    return LoadResponse::Deserialise(*response).load_;
+  }
+  catch(...) {}
+
+  return std::nullopt;
+}
+
+std::optional<std::vector<NodeInfo>> TcpClient::GetSuccessorList(
+    const NodeAddress& target) {
+  GetSuccessorListRequest request;
+  auto response = SendRequest(target, request.Serialise());
+
+  if(!response || response->empty() ||
+     static_cast<MessageType>((*response)[0]) !=
+         MessageType::kGetSuccessorListResponse) {
+    return std::nullopt;
+  }
+
+  try {
+    return GetSuccessorListResponse::Deserialise(*response).successors_;
+  }
+  catch(...) {}
+
+  return std::nullopt;
+}
+
 bool TcpClient::Notify(const NodeAddress& target, const NodeInfo& self) {
   NotifyMessage message{self};
   auto response = SendRequest(target, message.Serialise());
@@ -180,9 +310,9 @@ bool TcpClient::Ping(const NodeAddress& target) {
   return false;
 }
 
-std::optional<std::string> TcpClient::Get(const NodeAddress& target,
-                                          [[maybe_unused]] const std::string& key) {
-  GetRequest request{key};
+std::optional<EncodedValue> TcpClient::Get(const NodeAddress& target,
+                                           std::string_view key) {
+  GetRequest request{std::string{key}, true};
   auto response = SendRequest(target, request.Serialise());
 
   if(!response) {
@@ -192,7 +322,10 @@ std::optional<std::string> TcpClient::Get(const NodeAddress& target,
   try {
     auto resp = GetResponse::Deserialise(*response);
     if(resp.found_) {
-      return resp.value_;
+      return EncodedValue{
+        .bytes_ = std::move(resp.value_),
+        .compressed_ = resp.compressed_,
+      };
     }
   }
   catch(...) {}
@@ -200,9 +333,13 @@ std::optional<std::string> TcpClient::Get(const NodeAddress& target,
   return std::nullopt;
 }
 
-bool TcpClient::Put(const NodeAddress& target, [[maybe_unused]] const std::string& key,
-                    [[maybe_unused]] const std::string& value) {
-  PutRequest request{key, value};
+bool TcpClient::Put(const NodeAddress& target, std::string_view key,
+                    EncodedValue value,
+                    std::chrono::milliseconds ttl) {
+  PutRequest request{std::string{key}, std::move(value.bytes_),
+                     static_cast<u64>(std::max<i64>(ttl.count(), 0))};
+  request.encoded_ = true;
+  request.compressed_ = value.compressed_;
   auto response = SendRequest(target, request.Serialise());
 
   if(!response) {
@@ -218,11 +355,271 @@ bool TcpClient::Put(const NodeAddress& target, [[maybe_unused]] const std::strin
   return false;
 }
 
+bool TcpClient::Delete(const NodeAddress& target, std::string_view key) {
+  DeleteRequest request{std::string{key}};
+  auto response = SendRequest(target, request.Serialise());
+
+  if(!response) {
+    return false;
+  }
+
+  try {
+    auto resp = DeleteResponse::Deserialise(*response);
+    return resp.removed_;
+  }
+  catch(...) {}
+
+  return false;
+}
+
+bool TcpClient::PutReplica(const NodeAddress& target, std::string_view key,
+                           const EncodedValue& value,
+                           std::chrono::milliseconds ttl) {
+  PutRequest request{std::string{key}, value.bytes_,
+                     static_cast<u64>(std::max<i64>(ttl.count(), 0))};
+  request.replica_ = true;
+  request.compressed_ = value.compressed_;
+  auto response = SendRequest(target, request.Serialise());
+
+  if(!response) {
+    return false;
+  }
+
+  try {
+    if(*GetMessageType(*response) != MessageType::kPutResponse) {
+      return false;
+    }
+    return PutResponse::Deserialise(*response).success_;
+  }
+  catch(...) {}
+
+  return false;
+}
+
+Result<std::optional<EncodedValue>> TcpClient::GetReplica(
+    const NodeAddress& target, std::string_view key, bool forwarded) {
+  GetRequest request{std::string{key}, true};
+  request.local_ = true;
+  request.forwarded_ = forwarded;
+  auto response = SendRequest(target, request.Serialise());
+
+  if(!response) {
+    return std::unexpected("replica unreachable");
+  }
+
+  try {
+    if(*GetMessageType(*response) != MessageType::kGetResponse) {
+      return std::unexpected("unexpected reply");
+    }
+    auto resp = GetResponse::Deserialise(*response);
+    if(!resp.found_) {
+      return std::nullopt;
+    }
+    return EncodedValue{
+      .bytes_ = std::move(resp.value_),
+      .compressed_ = resp.compressed_,
+    };
+  }
+  catch(const std::exception& e) {
+    return std::unexpected(e.what());
+  }
+}
+
+Result<bool> TcpClient::DeleteReplica(const NodeAddress& target,
+                                      std::string_view key,
+                                      bool forwarded) {
+  DeleteRequest request{std::string{key}};
+  request.local_ = true;
+  request.forwarded_ = forwarded;
+  auto response = SendRequest(target, request.Serialise());
+
+  if(!response) {
+    return std::unexpected("replica unreachable");
+  }
+
+  try {
+    if(*GetMessageType(*response) != MessageType::kDeleteResponse) {
+      return std::unexpected("unexpected reply");
+    }
+    return DeleteResponse::Deserialise(*response).removed_;
+  }
+  catch(const std::exception& e) {
+    return std::unexpected(e.what());
+  }
+}
+
+Result<std::optional<EncodedValue>> TcpClient::GetOwned(
+    const NodeAddress& target, std::string_view key) {
+  GetRequest request{std::string{key}, true};
+  request.owned_ = true;
+  auto response = SendRequest(target, request.Serialise());
+
+  if(!response) {
+    return std::unexpected("owner unreachable");
+  }
+
+  try {
+    if(*GetMessageType(*response) != MessageType::kGetResponse) {
+      return std::unexpected("not owner");
+    }
+    auto resp = GetResponse::Deserialise(*response);
+    if(!resp.found_) {
+      return std::nullopt;
+    }
+    return EncodedValue{
+      .bytes_ = std::move(resp.value_),
+      .compressed_ = resp.compressed_,
+    };
+  }
+  catch(const std::exception& e) {
+    return std::unexpected(e.what());
+  }
+}
+
+Result<bool> TcpClient::PutOwned(const NodeAddress& target,
+                                 std::string_view key, EncodedValue& value,
+                                 std::chrono::milliseconds ttl) {
+  PutRequest request{std::string{key}, std::move(value.bytes_),
+                     static_cast<u64>(std::max<i64>(ttl.count(), 0))};
+  request.owned_ = true;
+  request.compressed_ = value.compressed_;
+  auto serialised = request.Serialise();
+  value.bytes_ = std::move(request.value_);
+  auto response = SendRequest(target, serialised);
+
+  if(!response) {
+    return std::unexpected("owner unreachable");
+  }
+
+  try {
+    if(*GetMessageType(*response) != MessageType::kPutResponse) {
+      return std::unexpected("not owner");
+    }
+    return PutResponse::Deserialise(*response).success_;
+  }
+  catch(const std::exception& e) {
+    return std::unexpected(e.what());
+  }
+}
+
+Result<bool> TcpClient::DeleteOwned(const NodeAddress& target,
+                                    std::string_view key) {
+  DeleteRequest request{std::string{key}};
+  request.owned_ = true;
+  auto response = SendRequest(target, request.Serialise());
+
+  if(!response) {
+    return std::unexpected("owner unreachable");
+  }
+
+  try {
+    if(*GetMessageType(*response) != MessageType::kDeleteResponse) {
+      return std::unexpected("not owner");
+    }
+    return DeleteResponse::Deserialise(*response).removed_;
+  }
+  catch(const std::exception& e) {
+    return std::unexpected(e.what());
+  }
+}
+
+std::optional<size_t> TcpClient::Replicate(const NodeAddress& target,
+                                           KeyID start, KeyID end,
+                                           const NodeInfo& source,
+                                           bool adopt) {
+  ReplicateRequest request{start, end, source, adopt};
+  auto response = SendRequest(target, request.Serialise());
+
+  if(!response) {
+    return std::nullopt;
+  }
+
+  try {
+    if(*GetMessageType(*response) != MessageType::kReplicateResponse) {
+      return std::nullopt;
+    }
+    auto resp = ReplicateResponse::Deserialise(*response);
+    if(resp.synced_) {
+      return resp.pulled_;
+    }
+  }
+  catch(...) {}
+
+  return std::nullopt;
+}
+
+std::optional<size_t> TcpClient::Leave(const NodeAddress& target,
+                                       const NodeInfo& node,
+                                       const std::optional<NodeInfo>& predecessor,
+                                       const NodeInfo& successor,
+                                       KeyID start, bool heir,
+                                       std::chrono::milliseconds timeout) {
+  LeaveRequest request;
+  request.node_ = node;
+  request.predecessor_ = predecessor;
+  request.successor_ = successor;
+  request.start_ = start;
+  request.heir_ = heir;
+  auto response = SendRequest(target, request.Serialise(), timeout);
+
+  if(!response) {
+    return std::nullopt;
+  }
+
+  try {
+    if(*GetMessageType(*response) != MessageType::kLeaveResponse) {
+      return std::nullopt;
+    }
+    auto resp = LeaveResponse::Deserialise(*response);
+    if(resp.accepted_) {
+      return resp.pulled_;
+    }
+  }
+  catch(...) {}
+
+  return std::nullopt;
+}
+
+std::optional<std::vector<u64>> TcpClient::MerkleHashes(
+    const NodeAddress& target, u8 level, const std::vector<u32>& indices) {
+  std::vector<u64> hashes;
+  hashes.reserve(indices.size());
+
+  for(size_t first{}; first < indices.size(); first += MerkleRequest::kMaxIndices) {
+    size_t last = std::min(indices.size(), first + MerkleRequest::kMaxIndices);
+    MerkleRequest request{level, {indices.begin() + first, indices.begin() + last}};
+
+    auto response = SendRequest(target, request.Serialise());
+    if(!response) {
+      return std::nullopt;
+    }
+
+    try {
+      if(*GetMessageType(*response) != MessageType::kMerkleResponse) {
+        return std::nullopt;
+      }
+      auto resp = MerkleResponse::Deserialise(*response);
+      if(resp.hashes_.size() != last - first) {
+        return std::nullopt;
+      }
+      hashes.insert(hashes.end(), resp.hashes_.begin(), resp.hashes_.end());
+    }
+    catch(...) {
+      return std::nullopt;
+    }
+  }
+
+  return hashes;
+}
+
 std::optional<std::vector<std::pair<std::string, std::string>>>
-TcpClient::TransferKeys(const NodeAddress& target, NodeID start, NodeID end) {
+TcpClient::TransferKeys(const NodeAddress& target, NodeID start, NodeID end,
+                        std::optional<NodeInfo> mover, u32 limit) {
   TransferKeysRequest request;
   request.start_ = start;
   request.end_ = end;
+  request.mover_ = std::move(mover);
+  request.limit_ = limit;
 
   auto response = SendRequest(target, request.Serialise());
 
@@ -238,5 +635,150 @@ TcpClient::TransferKeys(const NodeAddress& target, NodeID start, NodeID end) {
 
   return std::nullopt;
 }
+RequestSet::~RequestSet() {
+  for (const auto& request : pending_) {
+    close(request.socket_);
+  }
+}
+
+bool RequestSet::Start(u64 tag, const NodeAddress& target,
+                       std::vector<std::byte> request,
+                       std::chrono::milliseconds timeout) {
+  ++requests_sent;
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(target.port_);
+  if (inet_pton(AF_INET, target.ip_.c_str(), &addr.sin_addr) <= 0) {
+    return false;
+  }
+
+  int sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (sock < 0) {
+    return false;
+  }
+  if (connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 &&
+      errno != EINPROGRESS) {
+    close(sock);
+    return false;
+  }
+
+  auto framed = RequestHeader(target.vnode_, request.size());
+  framed.insert(framed.end(), request.begin(), request.end());
+  pending_.push_back(Pending{
+    .tag_ = tag,
+    .socket_ = sock,
+    .state_ = State::kConnecting,
+    .request_ = std::move(framed),
+    .sent_ = 0,
+    .response_ = {},
+    .deadline_ = std::chrono::steady_clock::now() + timeout,
+  });
+  return true;
+}
+
+std::vector<RequestSet::Done> RequestSet::Poll(
+    std::chrono::milliseconds timeout) {
+  std::vector<Done> done;
+  auto now = std::chrono::steady_clock::now();
+  auto until = now + timeout;
+
+  while (done.empty() && !pending_.empty()) {
+    std::vector<pollfd> fds;
+    fds.reserve(pending_.size());
+    auto wake = until;
+    for (const auto& request : pending_) {
+      fds.push_back({
+        .fd = request.socket_,
+        .events = static_cast<short>(
+            request.state_ == State::kReceiving ? POLLIN : POLLOUT),
+        .revents = 0,
+      });
+      wake = std::min(wake, request.deadline_);
+    }
+
+    auto wait = std::chrono::ceil<std::chrono::milliseconds>(wake - now);
+    int ready = poll(fds.data(), fds.size(),
+                     static_cast<int>(std::max<i64>(wait.count(), 0)));
+    if (ready < 0 && errno != EINTR) {
+      break;
+    }
+    now = std::chrono::steady_clock::now();
+
+    // walk backwards so finished requests can be swapped out in place
+    for (size_t i = pending_.size(); i-- > 0;) {
+      auto& request = pending_[i];
+      bool ok = false;
+      bool finished = false;
+      if (ready > 0 && fds[i].revents != 0) {
+        finished = Advance(request, fds[i].revents, ok);
+      }
+      if (!finished && now >= request.deadline_) {
+        finished = true;
+        ok = false;
+      }
+      if (!finished) {
+        continue;
+      }
+
+      close(request.socket_);
+      done.push_back({
+        .tag_ = request.tag_,
+        .response_ = ok ? std::optional{std::move(request.response_)}
+                        : std::nullopt,
+      });
+      pending_[i] = std::move(pending_.back());
+      pending_.pop_back();
+    }
+
+    if (now >= until) {
+      break;
+    }
+  }
+  return done;
+}
+
+bool RequestSet::Advance(Pending& request, short revents, bool& ok) {
+  if (request.state_ == State::kConnecting) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    getsockopt(request.socket_, SOL_SOCKET, SO_ERROR, &error, &length);
+    if (error != 0) {
+      return true;
+    }
+    request.state_ = State::kSending;
+  }
+
+  if (request.state_ == State::kSending) {
+    while (request.sent_ < request.request_.size()) {
+      ssize_t sent = send(request.socket_, request.request_.data() + request.sent_,
+                          request.request_.size() - request.sent_, MSG_NOSIGNAL);
+      if (sent < 0) {
+        return errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR;
+      }
+      request.sent_ += static_cast<size_t>(sent);
+    }
+    request.state_ = State::kReceiving;
+    return false;
+  }
+
+  if (!(revents & (POLLIN | POLLHUP | POLLERR))) {
+    return false;
+  }
+  // the server closes after replying, a reply is everything up to EOF
+  std::array<std::byte, 4096> chunk;
+  while (true) {
+    ssize_t received = recv(request.socket_, chunk.data(), chunk.size(), 0);
+    if (received > 0) {
+      request.response_.insert(request.response_.end(), chunk.begin(),
+                               chunk.begin() + received);
+      continue;
+    }
+    if (received == 0) {
+      ok = !request.response_.empty();
+      return true;
+    }
+    return errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR;
+  }
+}
 } // namespace tsc::tcp
 
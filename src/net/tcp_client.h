@@ -2,6 +2,7 @@
 #define TCP_CLIENT_H
 
 #include <string>
+#include <string_view>
 #include <optional>
 #include <chrono>
 #include <optional>
@@ -20,34 +21,157 @@ public:
     std::chrono::milliseconds timeout = kDefaultTimeout
   );
 
+  // requests the calling thread has started so far, through here or a
+  // RequestSet
+  static u64 RequestsSent();
+
   static std::optional<NodeInfo> FindSuccessor(
     const NodeAddress& target,
     NodeID id,
     std::optional<NodeInfo> sender = std::nullopt
   );
 
+  // nullopt if target did not answer or has no successor yet. more asks
+  // for that many candidates besides the next hop
+  static std::optional<LookupHop> NextHop(
+    const NodeAddress& target,
+    NodeID id,
+    u8 more = 0,
+    std::chrono::milliseconds timeout = kDefaultTimeout
+  );
+
+  // NextHop in two halves, for lookups that drive several at once through
+  // a RequestSet
+  static std::vector<std::byte> EncodeNextHop(NodeID id, u8 more);
+  static std::optional<LookupHop> DecodeNextHop(
+    std::vector<std::byte> response
+  );
+
   static std::optional<NodeInfo> GetPredecessor(const NodeAddress& target);
 
+  // target's membership changes after since, see node/membership.h. nullopt
+  // if it did not answer or does not keep a membership table
+  static std::optional<MembershipDelta> PullMembership(
+    const NodeAddress& target,
+    u64 since
+  );
+
+  // tells target, our successor, how loaded we are and returns its load
+  static std::optional<LoadSummary> ExchangeLoad(
+    const NodeAddress& target,
+    const NodeInfo& sender,
+    const LoadSummary& load
+  );
+
+  // nullopt only if target did not answer, an empty list is a real answer
+  static std::optional<std::vector<NodeInfo>> GetSuccessorList(
+    const NodeAddress& target
+  );
+
   static bool Notify(const NodeAddress& target, const NodeInfo& self);
 
   static bool Ping(const NodeAddress& target);
 
-  static std::optional<std::string> Get(
+  // node to node, so compressed values come back as they are stored
+  static std::optional<EncodedValue> Get(
     const NodeAddress& target,
-    const std::string& key
+    std::string_view key
   );
 
   static bool Put(
     const NodeAddress& target,
-    const std::string& key,
-    const std::string& value
+    std::string_view key,
+    EncodedValue value,
+    std::chrono::milliseconds ttl = {}
+  );
+
+  static bool Delete(const NodeAddress& target, std::string_view key);
+
+  // replica operations act on target's own storage without routing. reads
+  // and deletes tell an unreachable replica (error) from a missing key
+
+  static bool PutReplica(
+    const NodeAddress& target,
+    std::string_view key,
+    const EncodedValue& value,
+    std::chrono::milliseconds ttl = {}
+  );
+
+  // forwarded: target answers from storage only, see GetRequest
+  static Result<std::optional<EncodedValue>> GetReplica(
+    const NodeAddress& target,
+    std::string_view key,
+    bool forwarded = false
+  );
+
+  static Result<bool> DeleteReplica(
+    const NodeAddress& target,
+    std::string_view key,
+    bool forwarded = false
+  );
+
+  // owned operations go straight to the node a location cache says owns
+  // the key. it handles them locally or refuses (error) if the key is not
+  // its own, so a stale cache entry never sends a request round the ring
+
+  static Result<std::optional<EncodedValue>> GetOwned(
+    const NodeAddress& target,
+    std::string_view key
+  );
+
+  // value is only borrowed, it is still there for a fallback on error
+  static Result<bool> PutOwned(
+    const NodeAddress& target,
+    std::string_view key,
+    EncodedValue& value,
+    std::chrono::milliseconds ttl = {}
   );
 
+  static Result<bool> DeleteOwned(
+    const NodeAddress& target,
+    std::string_view key
+  );
+
+  // has target pull (start, end] from source, returns the records pulled.
+  // with adopt target also takes the range over from source, its neighbour
+  static std::optional<size_t> Replicate(
+    const NodeAddress& target,
+    KeyID start,
+    KeyID end,
+    const NodeInfo& source,
+    bool adopt = false
+  );
+
+  // records target holds in (start, end]. with a mover target gives them
+  // up to it, at most limit (0 for all) per call, see Node::HandOverRange
   static std::optional<std::vector<std::pair<std::string, std::string>>>
   TransferKeys(
     const NodeAddress& target,
     NodeID start,
-    NodeID end
+    NodeID end,
+    std::optional<NodeInfo> mover = std::nullopt,
+    u32 limit = 0
+  );
+
+  // tells target, a neighbour of node, that node is leaving, see
+  // LeaveRequest. returns the records target pulled as heir, nullopt if it
+  // did not take the request
+  static std::optional<size_t> Leave(
+    const NodeAddress& target,
+    const NodeInfo& node,
+    const std::optional<NodeInfo>& predecessor,
+    const NodeInfo& successor,
+    KeyID start,
+    bool heir,
+    std::chrono::milliseconds timeout = kDefaultTimeout
+  );
+
+  // digests of the given merkle tree nodes on one level, batched so each
+  // request fits MerkleRequest::kMaxIndices
+  static std::optional<std::vector<u64>> MerkleHashes(
+    const NodeAddress& target,
+    u8 level,
+    const std::vector<u32>& indices
   );
 
 private:
@@ -56,12 +180,63 @@ private:
     std::chrono::milliseconds timeout
   );
 
-  static bool SendAll(int socket, const std::vector<std::byte>& data);
+  // head then body, in one go so a small head is not left waiting for an
+  // ack on its own
+  static bool SendAll(int socket, const std::vector<std::byte>& head,
+                      const std::vector<std::byte>& body);
 
+  // the server closes after replying, so a reply is everything up to EOF
   static std::optional<std::vector<std::byte>> ReceiveMessage(
     int socket, std::chrono::milliseconds timeout
   );
 };
+
+// several requests in flight from one thread. connecting, sending and
+// reading are all non-blocking and driven by Poll, so a request nobody
+// wants any more is simply closed rather than waited out.
+class RequestSet {
+public:
+  struct Done {
+    u64 tag_;
+    // nullopt if the target refused, failed or ran out of time
+    std::optional<std::vector<std::byte>> response_;
+  };
+
+  RequestSet() = default;
+  ~RequestSet();
+
+  RequestSet(const RequestSet&) = delete;
+  RequestSet& operator=(const RequestSet&) = delete;
+
+  // false if the connection could not even be started
+  bool Start(u64 tag, const NodeAddress& target,
+             std::vector<std::byte> request,
+             std::chrono::milliseconds timeout);
+
+  // waits up to timeout for requests to finish and hands back every one
+  // that did, answered or not
+  std::vector<Done> Poll(std::chrono::milliseconds timeout);
+
+  [[nodiscard]] size_t InFlight() const { return pending_.size(); }
+
+private:
+  enum class State { kConnecting, kSending, kReceiving };
+
+  struct Pending {
+    u64 tag_;
+    int socket_;
+    State state_;
+    std::vector<std::byte> request_;
+    size_t sent_{0};
+    std::vector<std::byte> response_;
+    std::chrono::steady_clock::time_point deadline_;
+  };
+
+  // advances one request after poll flagged it, true once it is finished
+  static bool Advance(Pending& request, short revents, bool& ok);
+
+  std::vector<Pending> pending_;
+};
 } // namespace tsc::tcp
 
 #endif // TCP_CLIENT_H
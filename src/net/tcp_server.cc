@@ -6,7 +6,11 @@
 #include <netinet/in.h>
 #include <poll.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
+#include <algorithm>
+#include <array>
+#include <cerrno>
 #include <cstring>
 #include <format>
 #include <iostream>
@@ -17,6 +21,9 @@ namespace tsc::tcp {
 using namespace tsc::msg;
 using namespace tsc::node;
 
+// a put received here is sealed into its record without reallocating
+static_assert(PutRequest::kValueSpare >= Record::kMaxTrailer);
+
 TcpServer::TcpServer(u16 port, Node* node) : port_(port), node_(node) {}
 
 TcpServer::~TcpServer() { Stop(); }
@@ -53,6 +60,7 @@ bool TcpServer::Start() {
   fcntl(server_socket_, F_SETFL, flags | O_NONBLOCK);
 
   running_ = true;
+  workers_ = std::make_unique<util::ThreadPool>(kWorkers);
   server_thread_ = std::jthread(&TcpServer::ServerLoop, this);
 
   return true;
@@ -69,6 +77,9 @@ void TcpServer::Stop() {
   if (server_thread_.joinable()) {
     server_thread_.join();
   }
+
+  // answers whatever was already accepted
+  workers_.reset();
 }
 
 void TcpServer::ServerLoop() {
@@ -95,7 +106,14 @@ void TcpServer::ServerLoop() {
           .ip_ = std::string(ip_str),
           .port_ = client_port,
         };
-        HandleClient(client_socket, sender_addr);
+
+        if (workers_->Pending() >= kMaxPending) {
+          close(client_socket);
+          continue;
+        }
+        workers_->Submit([this, client_socket, sender = std::move(sender_addr)] {
+          HandleClient(client_socket, sender);
+        });
       }
     }
   }
@@ -107,13 +125,20 @@ void TcpServer::HandleClient(int client_socket, const NodeAddress& sender) {
   tv.tv_usec = 0;
   setsockopt(client_socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
 
-  std::vector<std::byte> buffer(4096);
-  ssize_t received = recv(client_socket, buffer.data(), buffer.size(), 0);
-
-  if (received > 0) {
-    buffer.resize(received);
+  std::vector<std::byte> buffer;
+  if (auto request = ReadRequest(client_socket, buffer)) {
+    // everything but vnode 0 comes wrapped, see RequestHeader
+    std::span<std::byte> message = *request;
+    auto vnode = UnwrapVNode(message);
+    Node* target = vnode ? node_->VirtualNode(*vnode) : nullptr;
+    if (!target) {
+      SendReply(client_socket,
+                ErrorResponse("no such virtual node").Serialise());
+      close(client_socket);
+      return;
+    }
 
-    auto msg_type = GetMessageType(buffer);
+    auto msg_type = GetMessageType(message);
     if (msg_type) {
       auto& policy = node_->GetSecurityPolicy();
       if (!policy.AllowMessage(sender, *msg_type)) {
@@ -122,17 +147,96 @@ void TcpServer::HandleClient(int client_socket, const NodeAddress& sender) {
       }
     }
 
-    auto response = ProcessMessage(buffer);
+    if (auto delay = node_->EmulatedDelay(); delay.count() > 0) {
+      std::this_thread::sleep_for(delay);
+    }
+
+    auto reply = ProcessMessage(*target, message, sender);
 
-    if (!response.empty()) {
-      send(client_socket, response.data(), response.size(), 0);
+    if (!reply.head_.empty()) {
+      SendReply(client_socket, reply);
     }
   }
 
   close(client_socket);
 }
 
-std::vector<std::byte> TcpServer::ProcessMessage(std::span<std::byte> message) {
+std::optional<std::span<std::byte>> TcpServer::ReadRequest(
+    int client_socket, std::vector<std::byte>& buffer) {
+  buffer.resize(4096);
+  size_t used = 0;
+  std::optional<size_t> framed;
+  while (true) {
+    ssize_t received = recv(client_socket, buffer.data() + used,
+                            buffer.size() - used, 0);
+    if (received < 0 && errno == EINTR) {
+      continue;
+    }
+    if (received <= 0) {
+      return std::nullopt;
+    }
+    used += static_cast<size_t>(received);
+
+    std::span<const std::byte> data(buffer.data(), used);
+    if (!framed) {
+      framed = FramedSize(data);
+    }
+    if (framed) {
+      if (*framed > kMaxMessage) {
+        return std::nullopt;
+      }
+      if (used >= *framed) {
+        return std::span(buffer).subspan(kFrameHeader,
+                                         *framed - kFrameHeader);
+      }
+      // the header says how much is coming, so grow once
+      buffer.resize(*framed);
+      continue;
+    }
+    if (Complete(data)) {
+      return std::span(buffer).first(used);
+    }
+    if (used == buffer.size()) {
+      if (used == kMaxMessage) {
+        return std::nullopt;
+      }
+      buffer.resize(std::min(2 * used, kMaxMessage));
+    }
+  }
+}
+
+bool TcpServer::SendReply(int client_socket, const Reply& reply) {
+  std::array<iovec, 2> parts{{
+    {.iov_base = const_cast<std::byte*>(reply.head_.data()),
+     .iov_len = reply.head_.size()},
+    {.iov_base = const_cast<char*>(reply.tail_.view_.data()),
+     .iov_len = reply.tail_.view_.size()},
+  }};
+
+  size_t first = 0;
+  while (first < parts.size()) {
+    ssize_t sent = writev(client_socket, &parts[first],
+                          static_cast<int>(parts.size() - first));
+    if (sent < 0) {
+      return false;
+    }
+    auto remaining = static_cast<size_t>(sent);
+    while (first < parts.size() && remaining >= parts[first].iov_len) {
+      remaining -= parts[first].iov_len;
+      ++first;
+    }
+    if (first < parts.size()) {
+      parts[first].iov_base =
+          static_cast<std::byte*>(parts[first].iov_base) + remaining;
+      parts[first].iov_len -= remaining;
+    }
+  }
+  return true;
+}
+
+TcpServer::Reply TcpServer::ProcessMessage(Node& node,
+                                           std::span<std::byte> message,
+                                           const NodeAddress& sender) {
   if (message.empty()) {
     return {};
   }
@@ -145,12 +249,12 @@ std::vector<std::byte> TcpServer::ProcessMessage(std::span<std::byte> message) {
         auto req = FindSuccessorRequest::Deserialise(message);
 
         if (req.sender_) {
-          if (!node_->GetSecurityPolicy().AllowNode(*req.sender_)) {
+          if (!node.GetSecurityPolicy().AllowNode(*req.sender_)) {
             return ErrorResponse("Blocked").Serialise();
           }
         }
 
-        auto successor = node_->FindSuccessor(req.id_);
+        auto successor = node.FindSuccessor(req.id_);
 
         FindSuccessorResponse response;
         if(successor) {
@@ -163,7 +267,7 @@ std::vector<std::byte> TcpServer::ProcessMessage(std::span<std::byte> message) {
         return response.Serialise();
       }
       case MessageType::kGetPredecessorRequest: {
-        auto predecessor = node_->GetPredecessor();
+        auto predecessor = node.GetPredecessor();
 
         GetPredecessorResponse response;
         if(predecessor) {
@@ -177,7 +281,7 @@ std::vector<std::byte> TcpServer::ProcessMessage(std::span<std::byte> message) {
       }
       case MessageType::kNotify: {
         auto msg = NotifyMessage::Deserialise(message);
-        node_->Notify(msg.node_);
+        node.Notify(msg.node_);
 
         NotifyAck ack;
         ack.accepted_ = true;
@@ -186,53 +290,181 @@ std::vector<std::byte> TcpServer::ProcessMessage(std::span<std::byte> message) {
       case MessageType::kPing: {
         return PongMessage().Serialise();
       }
+      case MessageType::kGetSuccessorListRequest: {
+        GetSuccessorListResponse response;
+        response.successors_ = node.SuccessorList();
+        return response.Serialise();
+      }
+      case MessageType::kNextHopRequest: {
+        auto req = NextHopRequest::Deserialise(message);
+        NextHopResponse response;
+        response.hop_ = node.NextHop(
+            req.id_, std::min<size_t>(req.more_, NextHopResponse::kMaxMore));
+        return response.Serialise();
+      }
+      case MessageType::kMembershipRequest: {
+        auto req = MembershipRequest::Deserialise(message);
+        auto delta = node.MembershipSince(req.since_);
+        if (!delta) {
+          return ErrorResponse("one hop routing is off").Serialise();
+        }
+        MembershipResponse response;
+        response.delta_ = std::move(*delta);
+        return response.Serialise();
+      }
+      case MessageType::kLoadRequest: {
+        auto req = LoadRequest::Deserialise(message);
+        LoadResponse response;
+        response.load_ = node.PeerLoad(req.sender_, req.load_);
+        return response.Serialise();
+      }
       case MessageType::kGetRequest: {
-        if (node_->IsMalicious()) {
+        if (node.IsMalicious()) {
           GetResponse response;
           response.found_ = false;
           return response.Serialise();
         }
 
         auto req = GetRequest::Deserialise(message);
-        auto value = node_->Get(req.key_);   // routed — calls ValidateLookup
-
-        GetResponse response;
+        if (req.owned_ && !node.Owns(req.key_)) {
+          return ErrorResponse("not owner").Serialise();
+        }
+        auto value = req.local_
+            ? node.LocalGetShared(req.key_, !req.forwarded_)
+            : node.GetShared(req.key_);   // routed — calls ValidateLookup
+
+        // compressed values go out as they are unless this is the last hop
+        // and the client cannot expand them itself
+        if (value && (!value.compressed_ || req.accept_compressed_)) {
+          return {GetResponse::SerialiseHeader(
+                      static_cast<u32>(value.view_.size()), value.compressed_),
+                  std::move(value)};
+        }
         if (value) {
-          response.found_ = true;
-          response.value_ = *value;
-        } else {
-          response.found_ = false;
+          if (auto plain = node.Codec().Decode(value)) {
+            GetResponse response;
+            response.found_ = true;
+            response.value_ = std::move(*plain);
+            return response.Serialise();
+          }
         }
+        GetResponse response;
+        response.found_ = false;
         return response.Serialise();
       }
       case MessageType::kPutRequest: {
-        if (node_->IsMalicious()) {
+        if (node.IsMalicious()) {
           PutResponse response;
           response.success_ = true;
           return response.Serialise();
         }
 
         auto req = PutRequest::Deserialise(message);
-        bool ok = node_->Put(req.key_, req.value_);  // routed — calls ValidateLookup
+        if (req.owned_ && !node.Owns(req.key_)) {
+          return ErrorResponse("not owner").Serialise();
+        }
+        std::chrono::milliseconds ttl(req.ttl_ms_);
+        if (req.replica_) {
+          PutResponse response;
+          response.success_ = node.StoreReplica(req.key_,
+                                                {.bytes_ = std::move(req.value_),
+                                                 .compressed_ = req.compressed_},
+                                                ttl);
+          return response.Serialise();
+        }
+        // values straight from a client get encoded here, values from other
+        // nodes already were
+        bool ok = req.encoded_
+            ? node.PutEncoded(req.key_,
+                                {.bytes_ = std::move(req.value_),
+                                 .compressed_ = req.compressed_},
+                                ttl)
+            : node.Put(req.key_, std::move(req.value_), ttl);  // routed — calls ValidateLookup
 
         PutResponse response;
         response.success_ = ok;
         return response.Serialise();
       }
+      case MessageType::kDeleteRequest: {
+        if (node.IsMalicious()) {
+          DeleteResponse response;
+          response.removed_ = true;
+          return response.Serialise();
+        }
+
+        auto req = DeleteRequest::Deserialise(message);
+        if (req.owned_ && !node.Owns(req.key_)) {
+          return ErrorResponse("not owner").Serialise();
+        }
+
+        DeleteResponse response;
+        response.removed_ = req.local_
+            ? node.LocalRemove(req.key_, !req.forwarded_)
+            : node.Remove(req.key_);  // routed like put
+        return response.Serialise();
+      }
       case MessageType::kTransferKeysRequest: {
-        if (node_->IsMalicious()) {
+        if (node.IsMalicious()) {
           // just return no keys if malicious
           TransferKeysResponse response;
           return response.Serialise();
         }
 
         auto req = TransferKeysRequest::Deserialise(message);
-        auto keys = node_->GetKeysInRange(req.start_, req.end_);
+        std::vector<std::pair<std::string, std::string>> keys;
+        if (!req.mover_) {
+          keys = node.GetKeysInRange(req.start_, req.end_);
+        }
+        // records only move to the node asking for them
+        else if (sender.ip_ == req.mover_->address_.ip_) {
+          keys = node.HandOverRange(*req.mover_, req.start_, req.end_,
+                                    req.limit_);
+        }
 
         TransferKeysResponse response;
         response.keys_ = keys;
         return response.Serialise();
       }
+      case MessageType::kMerkleRequest: {
+        auto req = MerkleRequest::Deserialise(message);
+
+        MerkleResponse response;
+        auto hashes = node.MerkleHashes(req.level_, req.indices_);
+        if (!hashes) {
+          return ErrorResponse(hashes.error()).Serialise();
+        }
+        response.hashes_ = std::move(*hashes);
+        return response.Serialise();
+      }
+      case MessageType::kReplicateRequest: {
+        auto req = ReplicateRequest::Deserialise(message);
+
+        ReplicateResponse response;
+        if (node.IsMalicious() ||
+            !node.GetSecurityPolicy().AllowNode(req.source_)) {
+          return response.Serialise();
+        }
+        auto pulled = req.adopt_
+            ? node.AdoptRange(req.source_, req.start_, req.end_)
+            : node.SyncRange(req.source_.address_, req.start_, req.end_);
+        response.synced_ = pulled.has_value();
+        response.pulled_ = static_cast<u32>(pulled.value_or(0));
+        return response.Serialise();
+      }
+      case MessageType::kLeaveRequest: {
+        auto req = LeaveRequest::Deserialise(message);
+
+        LeaveResponse response;
+        // a node only leaves for itself
+        if (node.IsMalicious() || sender.ip_ != req.node_.address_.ip_) {
+          return response.Serialise();
+        }
+        auto pulled = node.PeerLeaving(req.node_, req.predecessor_,
+                                       req.successor_, req.start_, req.heir_);
+        response.accepted_ = pulled.has_value();
+        response.pulled_ = static_cast<u32>(pulled.value_or(0));
+        return response.Serialise();
+      }
       default: {
         return ErrorResponse("Unknown message type").Serialise();
       }
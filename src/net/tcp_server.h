@@ -1,11 +1,14 @@
 #ifndef TCP_SERVER_H
 #define TCP_SERVER_H
 
+#include <memory>
+#include <optional>
 #include <span>
 #include <thread>
 #include <vector>
 
 #include "types/types.h"
+#include "util/thread_pool.h"
 
 namespace tsc::node {
 class Node;
@@ -14,8 +17,18 @@ class Node;
 namespace tsc::tcp {
 using namespace tsc::type;
 
+// one thread accepts, a small pool answers. requests regularly call other
+// nodes (recursive lookups, replica fan-out) which may be calling back into
+// this one, so a single handler would deadlock until a timeout broke it.
 class TcpServer {
 public:
+  static constexpr size_t kWorkers = 8;
+  // connections waiting for a worker beyond this are closed unanswered
+  static constexpr size_t kMaxPending = 256;
+
+  // a request larger than this is dropped unread
+  static constexpr size_t kMaxMessage = 64 << 20;
+
   explicit TcpServer(u16 port, node::Node* node);
   ~TcpServer();
 
@@ -27,18 +40,43 @@ public:
 
   u16 Port() const;
 
+  // reads one request off client_socket into buffer and returns it, frame
+  // header taken off. nullopt if the sender went quiet before it was whole
+  // or it would not fit in kMaxMessage
+  static std::optional<std::span<std::byte>> ReadRequest(
+      int client_socket, std::vector<std::byte>& buffer);
+
 private:
+  // a serialised response, optionally followed on the wire by a shared value
+  // buffer that goes from storage to the socket without being copied
+  struct Reply {
+    Reply() = default;
+    Reply(std::vector<std::byte> head) : head_(std::move(head)) {}
+    Reply(std::vector<std::byte> head, ValueSlice tail)
+      : head_(std::move(head))
+      , tail_(std::move(tail)) {}
+
+    std::vector<std::byte> head_;
+    ValueSlice tail_;
+  };
+
   void ServerLoop();
 
   void HandleClient(int client_socket, const NodeAddress& sender);
 
-  std::vector<std::byte> ProcessMessage(std::span<std::byte> message);
+  // message is for node, the host or one of its virtual nodes. sender's
+  // port is the connection's, not its server's
+  Reply ProcessMessage(node::Node& node, std::span<std::byte> message,
+                       const NodeAddress& sender);
+
+  static bool SendReply(int client_socket, const Reply& reply);
 
   u16 port_;
   node::Node* node_;
 
   int server_socket_ = -1;
   std::atomic<bool> running_{false};
+  std::unique_ptr<util::ThreadPool> workers_;
   std::jthread server_thread_;
 };
 } // namespace tsc::tcp
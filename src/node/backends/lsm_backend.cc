@@ -0,0 +1,650 @@
+#include "node/backends/lsm_backend.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+
+namespace tsc::node::backend {
+namespace {
+// rough cost of a std::map node on top of the key and value bytes
+constexpr size_t kEntryOverhead = 64;
+
+class Cursor {
+public:
+  virtual ~Cursor() = default;
+
+  [[nodiscard]] virtual bool Valid() const = 0;
+  [[nodiscard]] virtual const InternalKey& Key() const = 0;
+  [[nodiscard]] virtual const std::optional<std::string>& Value() const = 0;
+  virtual void Next() = 0;
+};
+
+// owns a copy of a slice of the live memtable
+class SliceCursor : public Cursor {
+public:
+  using Slice = std::vector<std::pair<InternalKey, std::optional<std::string>>>;
+
+  explicit SliceCursor(Slice slice) : slice_(std::move(slice)) {}
+
+  bool Valid() const override { return pos_ < slice_.size(); }
+  const InternalKey& Key() const override { return slice_[pos_].first; }
+  const std::optional<std::string>& Value() const override {
+    return slice_[pos_].second;
+  }
+  void Next() override { ++pos_; }
+
+private:
+  Slice slice_;
+  size_t pos_{0};
+};
+
+// walks a frozen memtable in place
+template <typename Map>
+class MapCursor : public Cursor {
+public:
+  MapCursor(std::shared_ptr<const Map> map, KeyID from)
+    : map_(std::move(map))
+    , it_(map_->lower_bound(InternalKey{.id_ = from, .key_ = {}})) {}
+
+  bool Valid() const override { return it_ != map_->end(); }
+  const InternalKey& Key() const override { return it_->first; }
+  const std::optional<std::string>& Value() const override {
+    return it_->second;
+  }
+  void Next() override { ++it_; }
+
+private:
+  std::shared_ptr<const Map> map_;
+  typename Map::const_iterator it_;
+};
+
+class TableCursor : public Cursor {
+public:
+  TableCursor(std::shared_ptr<const SSTable> table, KeyID from)
+    : it_(std::move(table), from) {}
+
+  bool Valid() const override { return it_.Valid(); }
+  const InternalKey& Key() const override { return it_.Current().key_; }
+  const std::optional<std::string>& Value() const override {
+    return it_.Current().value_;
+  }
+  void Next() override { it_.Next(); }
+
+private:
+  SSTable::Iterator it_;
+};
+
+// chains the non-overlapping, sorted tables of one level
+class LevelCursor : public Cursor {
+public:
+  LevelCursor(std::vector<std::shared_ptr<SSTable>> tables, KeyID from)
+    : tables_(std::move(tables)) {
+    while (next_ < tables_.size() && tables_[next_]->Largest().id_ < from) {
+      ++next_;
+    }
+    Advance(from);
+  }
+
+  bool Valid() const override { return it_ && it_->Valid(); }
+  const InternalKey& Key() const override { return it_->Current().key_; }
+  const std::optional<std::string>& Value() const override {
+    return it_->Current().value_;
+  }
+  void Next() override {
+    it_->Next();
+    if (!it_->Valid()) {
+      Advance(0);
+    }
+  }
+
+private:
+  void Advance(KeyID from) {
+    it_.reset();
+    while (next_ < tables_.size()) {
+      it_.emplace(tables_[next_++], from);
+      if (it_->Valid()) {
+        return;
+      }
+    }
+  }
+
+  std::vector<std::shared_ptr<SSTable>> tables_;
+  size_t next_{0};
+  std::optional<SSTable::Iterator> it_;
+};
+} // namespace
+
+// k-way merge over sorted cursors. cursors are ordered newest first, so when
+// several hold the same key the first one wins and the rest are skipped.
+class MergingCursor {
+public:
+  explicit MergingCursor(std::vector<std::unique_ptr<Cursor>> cursors)
+    : cursors_(std::move(cursors)) {
+    FindSmallest();
+  }
+
+  [[nodiscard]] bool Valid() const { return current_ != nullptr; }
+  [[nodiscard]] const InternalKey& Key() const { return current_->Key(); }
+  [[nodiscard]] const std::optional<std::string>& Value() const {
+    return current_->Value();
+  }
+
+  void Next() {
+    for (auto& cursor : cursors_) {
+      if (cursor.get() != current_ && cursor->Valid() &&
+          cursor->Key() == current_->Key()) {
+        cursor->Next();
+      }
+    }
+    current_->Next();
+    FindSmallest();
+  }
+
+private:
+  void FindSmallest() {
+    current_ = nullptr;
+    for (auto& cursor : cursors_) {
+      if (cursor->Valid() && (!current_ || cursor->Key() < current_->Key())) {
+        current_ = cursor.get();
+      }
+    }
+  }
+
+  std::vector<std::unique_ptr<Cursor>> cursors_;
+  Cursor* current_{nullptr};
+};
+
+LsmBackend::LsmBackend(Config config)
+  : config_(std::move(config))
+  , mem_(std::make_unique<Memtable>())
+  , version_(std::make_shared<const Version>()) {
+  std::filesystem::create_directories(config_.dir);
+  for (const auto& file : std::filesystem::directory_iterator(config_.dir)) {
+    if (file.path().extension() == ".sst") {
+      std::filesystem::remove(file.path());
+    }
+  }
+
+  background_thread_ = std::jthread([this](const std::stop_token& stop) {
+    BackgroundLoop(stop);
+  });
+}
+
+LsmBackend::~LsmBackend() {
+  background_thread_.request_stop();
+  background_cv_.notify_all();
+  if (background_thread_.joinable()) {
+    background_thread_.join();
+  }
+
+  for (const auto& level : version_->levels_) {
+    for (const auto& table : level) {
+      table->MarkObsolete();
+    }
+  }
+}
+
+bool LsmBackend::Put(KeyID id, std::string_view key, std::string value) {
+  // writes are blind, so telling a new key from an overwrite costs a point
+  // read. Size and the listener both need it. writers to the same key have
+  // to be serialised by the caller for before to be right.
+  auto before = Get(id, key);
+  if (!before) {
+    live_keys_.fetch_add(1, std::memory_order_relaxed);
+  }
+  NotifyChange(id, key, before ? &*before : nullptr, &value);
+  Write(id, key, std::move(value));
+  return true;
+}
+
+bool LsmBackend::Remove(KeyID id, std::string_view key) {
+  auto before = Get(id, key);
+  if (before) {
+    Write(id, key, std::nullopt);
+    live_keys_.fetch_sub(1, std::memory_order_relaxed);
+    NotifyChange(id, key, &*before, nullptr);
+  }
+  return before.has_value();
+}
+
+void LsmBackend::Write(KeyID id, std::string_view key,
+                       std::optional<std::string> value) {
+  std::unique_lock lock(mutex_);
+
+  mem_bytes_ += key.size() + (value ? value->size() : 0) + kEntryOverhead;
+  mem_->insert_or_assign(InternalKey{.id_ = id, .key_ = std::string{key}},
+                         std::move(value));
+
+  if (mem_bytes_ < config_.memtable_bytes) {
+    return;
+  }
+
+  // stall until the previous memtable is on disk and level 0 has room
+  write_cv_.wait(lock, [this] {
+    return !imm_ &&
+           version_->levels_[0].size() < config_.l0_stop_trigger;
+  });
+
+  imm_ = std::move(mem_);
+  mem_ = std::make_unique<Memtable>();
+  mem_bytes_ = 0;
+  background_cv_.notify_one();
+}
+
+std::optional<std::string> LsmBackend::Get(KeyID id,
+                                           std::string_view key) const {
+  InternalKey ikey{.id_ = id, .key_ = std::string{key}};
+
+  std::shared_ptr<const Memtable> imm;
+  std::shared_ptr<const Version> version;
+  {
+    std::lock_guard lock(mutex_);
+    auto it = mem_->find(ikey);
+    if (it != mem_->end()) {
+      return it->second;
+    }
+    imm = imm_;
+    version = version_;
+  }
+
+  if (imm) {
+    auto it = imm->find(ikey);
+    if (it != imm->end()) {
+      return it->second;
+    }
+  }
+
+  for (const auto& table : version->levels_[0]) {
+    if (auto entry = table->Get(ikey)) {
+      return entry->value_;
+    }
+  }
+
+  for (size_t level = 1; level < kNumLevels; ++level) {
+    const auto& tables = version->levels_[level];
+    auto it = std::lower_bound(
+        tables.begin(), tables.end(), ikey,
+        [](const std::shared_ptr<SSTable>& t, const InternalKey& k) {
+          return t->Largest() < k;
+        });
+    if (it != tables.end()) {
+      if (auto entry = (*it)->Get(ikey)) {
+        return entry->value_;
+      }
+    }
+  }
+
+  return std::nullopt;
+}
+
+size_t LsmBackend::Size() const {
+  return static_cast<size_t>(
+      std::max<i64>(live_keys_.load(std::memory_order_relaxed), 0));
+}
+
+void LsmBackend::Scan(KeyID start, KeyID end, const ScanFn& fn) const {
+  constexpr KeyID kMax = std::numeric_limits<KeyID>::max();
+
+  // (start, end] on the ring becomes one or two linear runs
+  if (start == end) {
+    ScanSegment(0, kMax, fn);
+  }
+  else if (start < end) {
+    ScanSegment(start + 1, end, fn);
+  }
+  else {
+    if (start != kMax && !ScanSegment(start + 1, kMax, fn)) {
+      return;
+    }
+    ScanSegment(0, end, fn);
+  }
+}
+
+void LsmBackend::ScanAll(const ScanFn& fn) const {
+  ScanSegment(0, std::numeric_limits<KeyID>::max(), fn);
+}
+
+bool LsmBackend::ScanSegment(KeyID first, KeyID last,
+                             const ScanFn& fn) const {
+  SliceCursor::Slice slice;
+  std::shared_ptr<const Memtable> imm;
+  std::shared_ptr<const Version> version;
+  {
+    std::lock_guard lock(mutex_);
+    for (auto it = mem_->lower_bound(InternalKey{.id_ = first, .key_ = {}});
+         it != mem_->end() && it->first.id_ <= last; ++it) {
+      slice.emplace_back(it->first, it->second);
+    }
+    imm = imm_;
+    version = version_;
+  }
+
+  std::vector<std::unique_ptr<Cursor>> cursors;
+  cursors.push_back(std::make_unique<SliceCursor>(std::move(slice)));
+  if (imm) {
+    cursors.push_back(std::make_unique<MapCursor<Memtable>>(imm, first));
+  }
+  for (const auto& table : version->levels_[0]) {
+    if (table->Overlaps(first, last)) {
+      cursors.push_back(std::make_unique<TableCursor>(table, first));
+    }
+  }
+  for (size_t level = 1; level < kNumLevels; ++level) {
+    TableList overlapping;
+    for (const auto& table : version->levels_[level]) {
+      if (table->Overlaps(first, last)) {
+        overlapping.push_back(table);
+      }
+    }
+    if (!overlapping.empty()) {
+      cursors.push_back(
+          std::make_unique<LevelCursor>(std::move(overlapping), first));
+    }
+  }
+
+  MergingCursor merged{std::move(cursors)};
+  for (; merged.Valid() && merged.Key().id_ <= last; merged.Next()) {
+    if (merged.Value() && !fn(merged.Key().key_, *merged.Value())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void LsmBackend::Clear() {
+  std::lock_guard lock(mutex_);
+  mem_ = std::make_unique<Memtable>();
+  mem_bytes_ = 0;
+  imm_.reset();
+  for (const auto& level : version_->levels_) {
+    for (const auto& table : level) {
+      table->MarkObsolete();
+    }
+  }
+  version_ = std::make_shared<const Version>();
+  live_keys_.store(0, std::memory_order_relaxed);
+  ++generation_;
+  write_cv_.notify_all();
+}
+
+// -------------------------------------------
+// background work
+// -------------------------------------------
+
+void LsmBackend::BackgroundLoop(const std::stop_token& stop) {
+  while (!stop.stop_requested()) {
+    bool flush = false;
+    std::optional<Compaction> compaction;
+    {
+      std::unique_lock lock(mutex_);
+      background_cv_.wait(lock, stop, [this] {
+        return imm_ != nullptr || PickCompaction().has_value();
+      });
+      if (stop.stop_requested()) {
+        return;
+      }
+      flush = imm_ != nullptr;
+      if (!flush) {
+        compaction = PickCompaction();
+      }
+    }
+
+    try {
+      if (flush) {
+        FlushImmutable();
+      }
+      else if (compaction) {
+        RunCompaction(*compaction);
+      }
+    }
+    catch (const std::exception& e) {
+      // most likely a full disk, back off instead of spinning on it
+      std::cerr << "[LSM] background work failed: " << e.what() << "\n";
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+  }
+}
+
+void LsmBackend::FlushImmutable() {
+  std::shared_ptr<const Memtable> imm;
+  u64 generation = 0;
+  {
+    std::lock_guard lock(mutex_);
+    imm = imm_;
+    generation = generation_;
+  }
+
+  std::vector<std::unique_ptr<Cursor>> cursors;
+  cursors.push_back(std::make_unique<MapCursor<Memtable>>(imm, 0));
+  MergingCursor input{std::move(cursors)};
+
+  // deeper levels may still hold older versions, so tombstones stay
+  auto tables = WriteTables(input, false);
+
+  std::lock_guard lock(mutex_);
+  if (generation != generation_) {
+    for (const auto& table : tables) {
+      table->MarkObsolete();
+    }
+    return;
+  }
+
+  auto version = std::make_shared<Version>(*version_);
+  auto& level0 = version->levels_[0];
+  level0.insert(level0.begin(), tables.begin(), tables.end());
+  version_ = std::move(version);
+  imm_.reset();
+  write_cv_.notify_all();
+}
+
+std::optional<LsmBackend::Compaction> LsmBackend::PickCompaction() const {
+  const auto& levels = version_->levels_;
+
+  auto overlapping = [](const TableList& tables, KeyID first, KeyID last) {
+    TableList result;
+    for (const auto& table : tables) {
+      if (table->Overlaps(first, last)) {
+        result.push_back(table);
+      }
+    }
+    return result;
+  };
+
+  if (levels[0].size() >= config_.l0_compaction_trigger) {
+    Compaction compaction{.level_ = 0, .inputs_ = levels[0], .next_inputs_ = {}};
+    KeyID first = std::numeric_limits<KeyID>::max();
+    KeyID last = 0;
+    for (const auto& table : levels[0]) {
+      first = std::min(first, table->Smallest().id_);
+      last = std::max(last, table->Largest().id_);
+    }
+    compaction.next_inputs_ = overlapping(levels[1], first, last);
+    return compaction;
+  }
+
+  for (size_t level = 1; level + 1 < kNumLevels; ++level) {
+    const auto& tables = levels[level];
+    if (tables.empty() || LevelBytes(tables) <= MaxBytesForLevel(level)) {
+      continue;
+    }
+    const auto& table = tables[compact_pointer_[level] % tables.size()];
+    return Compaction{
+      .level_ = level,
+      .inputs_ = {table},
+      .next_inputs_ = overlapping(levels[level + 1], table->Smallest().id_,
+                                  table->Largest().id_),
+    };
+  }
+
+  return std::nullopt;
+}
+
+void LsmBackend::RunCompaction(const Compaction& compaction) {
+  size_t output_level = compaction.level_ + 1;
+
+  std::shared_ptr<const Version> base;
+  u64 generation = 0;
+  {
+    std::lock_guard lock(mutex_);
+    base = version_;
+    generation = generation_;
+  }
+
+  auto install = [&](const TableList& outputs) {
+    std::lock_guard lock(mutex_);
+    if (generation != generation_) {
+      for (const auto& table : outputs) {
+        table->MarkObsolete();
+      }
+      return;
+    }
+
+    auto version = std::make_shared<Version>(*version_);
+    auto remove_inputs = [](TableList& level, const TableList& inputs) {
+      std::erase_if(level, [&inputs](const std::shared_ptr<SSTable>& t) {
+        return std::ranges::find(inputs, t) != inputs.end();
+      });
+    };
+    remove_inputs(version->levels_[compaction.level_], compaction.inputs_);
+    remove_inputs(version->levels_[output_level], compaction.next_inputs_);
+
+    auto& out = version->levels_[output_level];
+    out.insert(out.end(), outputs.begin(), outputs.end());
+    std::ranges::sort(out, [](const auto& a, const auto& b) {
+      return a->Smallest() < b->Smallest();
+    });
+
+    // a moved table is still live, only rewritten inputs go away
+    for (const auto* inputs : {&compaction.inputs_, &compaction.next_inputs_}) {
+      for (const auto& table : *inputs) {
+        if (std::ranges::find(outputs, table) == outputs.end()) {
+          table->MarkObsolete();
+        }
+      }
+    }
+
+    ++compact_pointer_[compaction.level_];
+    version_ = std::move(version);
+    write_cv_.notify_all();
+  };
+
+  // nothing to merge with below, just move the table down a level
+  if (compaction.level_ > 0 && compaction.inputs_.size() == 1 &&
+      compaction.next_inputs_.empty()) {
+    install(compaction.inputs_);
+    return;
+  }
+
+  KeyID first = std::numeric_limits<KeyID>::max();
+  KeyID last = 0;
+  for (const auto* inputs : {&compaction.inputs_, &compaction.next_inputs_}) {
+    for (const auto& table : *inputs) {
+      first = std::min(first, table->Smallest().id_);
+      last = std::max(last, table->Largest().id_);
+    }
+  }
+
+  // tombstones only matter while a deeper level might hold the key
+  bool drop_tombstones = true;
+  for (size_t level = output_level + 1; level < kNumLevels; ++level) {
+    for (const auto& table : base->levels_[level]) {
+      if (table->Overlaps(first, last)) {
+        drop_tombstones = false;
+      }
+    }
+  }
+
+  std::vector<std::unique_ptr<Cursor>> cursors;
+  for (const auto& table : compaction.inputs_) {
+    cursors.push_back(std::make_unique<TableCursor>(table, 0));
+  }
+  if (!compaction.next_inputs_.empty()) {
+    cursors.push_back(
+        std::make_unique<LevelCursor>(compaction.next_inputs_, 0));
+  }
+  MergingCursor input{std::move(cursors)};
+
+  install(WriteTables(input, drop_tombstones));
+}
+
+LsmBackend::TableList LsmBackend::WriteTables(MergingCursor& input,
+                                              bool drop_tombstones) {
+  TableList tables;
+  std::unique_ptr<SSTableWriter> writer;
+  u64 number = 0;
+  KeyID last_id = 0;
+
+  auto finish = [&] {
+    if (!writer) {
+      return;
+    }
+    auto table = writer->Finish(number);
+    writer.reset();
+    if (!table) {
+      throw std::runtime_error("failed to write " + TablePath(number));
+    }
+    tables.push_back(std::move(table));
+  };
+
+  for (; input.Valid(); input.Next()) {
+    if (drop_tombstones && !input.Value()) {
+      continue;
+    }
+
+    // never split one id across tables so levels stay disjoint by id
+    if (writer && writer->FileSize() >= config_.target_file_bytes &&
+        input.Key().id_ != last_id) {
+      finish();
+    }
+
+    if (!writer) {
+      number = next_file_number_++;
+      writer = std::make_unique<SSTableWriter>(TablePath(number));
+    }
+    writer->Add(input.Key(), input.Value());
+    last_id = input.Key().id_;
+  }
+  finish();
+
+  return tables;
+}
+
+void LsmBackend::CollectMetrics(util::ModuleMetrics& out) const {
+  std::shared_ptr<const Version> version;
+  {
+    std::lock_guard lock(mutex_);
+    out.counters.emplace_back("memtable_bytes", mem_bytes_);
+    version = version_;
+  }
+
+  u64 tables = 0;
+  u64 disk_bytes = 0;
+  for (const auto& level : version->levels_) {
+    tables += level.size();
+    disk_bytes += LevelBytes(level);
+  }
+  out.counters.emplace_back("tables", tables);
+  out.counters.emplace_back("disk_bytes", disk_bytes);
+}
+
+std::string LsmBackend::TablePath(u64 number) const {
+  return config_.dir + "/" + std::to_string(number) + ".sst";
+}
+
+u64 LsmBackend::LevelBytes(const TableList& tables) {
+  u64 total = 0;
+  for (const auto& table : tables) {
+    total += table->FileSize();
+  }
+  return total;
+}
+
+u64 LsmBackend::MaxBytesForLevel(size_t level) const {
+  u64 bytes = config_.level1_bytes;
+  for (size_t i = 1; i < level; ++i) {
+    bytes *= 10;
+  }
+  return bytes;
+}
+} // namespace tsc::node::backend
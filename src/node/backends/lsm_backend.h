@@ -0,0 +1,121 @@
+#ifndef LSM_BACKEND_H
+#define LSM_BACKEND_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "node/backends/sstable.h"
+#include "node/backends/storage_backend.h"
+
+namespace tsc::node::backend {
+class MergingCursor;
+
+// log structured merge tree for stores that do not fit in memory.
+//
+// writes go to a sorted memtable. once it is full it is frozen and a background
+// thread flushes it to a level 0 sstable. level 0 tables may overlap, every
+// deeper level is a set of non-overlapping tables with ten times the budget of
+// the level above, kept in shape by leveled compaction on the same thread.
+//
+// everything is ordered by (KeyID, key), so a ring range is a sequential scan
+// over each level. the engine is a cache of what the ring owns rather than a
+// database, there is no write ahead log and the directory is wiped on start.
+class LsmBackend : public IStorageBackend {
+public:
+  struct Config {
+    std::string dir;
+    size_t memtable_bytes{4 << 20};
+    size_t target_file_bytes{8 << 20};
+    size_t level1_bytes{64 << 20};
+    size_t l0_compaction_trigger{4};
+    size_t l0_stop_trigger{12};
+  };
+
+  explicit LsmBackend(Config config);
+  ~LsmBackend() override;
+
+  bool Put(KeyID id, std::string_view key, std::string value) override;
+
+  std::optional<std::string> Get(KeyID id,
+                                 std::string_view key) const override;
+
+  bool Remove(KeyID id, std::string_view key) override;
+
+  // counted as keys come and go, the directory starts out empty
+  size_t Size() const override;
+
+  void Scan(KeyID start, KeyID end, const ScanFn& fn) const override;
+
+  void ScanAll(const ScanFn& fn) const override;
+
+  void Clear() override;
+
+  std::string Name() const override { return "lsm"; }
+
+  void CollectMetrics(util::ModuleMetrics& out) const override;
+
+  static constexpr size_t kNumLevels = 7;
+
+private:
+  using Memtable = std::map<InternalKey, std::optional<std::string>>;
+  using TableList = std::vector<std::shared_ptr<SSTable>>;
+
+  // immutable snapshot of the table layout, swapped wholesale on change.
+  // level 0 is newest first, deeper levels are sorted by smallest key.
+  struct Version {
+    std::array<TableList, kNumLevels> levels_;
+  };
+
+  struct Compaction {
+    size_t level_;  // inputs come from level_ and level_ + 1
+    TableList inputs_;
+    TableList next_inputs_;
+  };
+
+  void Write(KeyID id, std::string_view key,
+             std::optional<std::string> value);
+
+  // scans the linear id range [first, last]
+  bool ScanSegment(KeyID first, KeyID last, const ScanFn& fn) const;
+
+  void BackgroundLoop(const std::stop_token& stop);
+  void FlushImmutable();
+  std::optional<Compaction> PickCompaction() const;
+  void RunCompaction(const Compaction& compaction);
+
+  // drains the cursor into tables of roughly target_file_bytes each
+  TableList WriteTables(MergingCursor& input, bool drop_tombstones);
+
+  std::string TablePath(u64 number) const;
+
+  static u64 LevelBytes(const TableList& tables);
+  u64 MaxBytesForLevel(size_t level) const;
+
+  Config config_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable_any background_cv_;
+  std::condition_variable write_cv_;
+
+  std::unique_ptr<Memtable> mem_;
+  size_t mem_bytes_{0};
+  std::shared_ptr<const Memtable> imm_;
+  std::shared_ptr<const Version> version_;
+
+  // bumped by Clear so in flight background work is thrown away
+  u64 generation_{0};
+  // signed, a Remove racing Clear can take it below zero for a moment
+  std::atomic<i64> live_keys_{0};
+  std::atomic<u64> next_file_number_{1};
+  std::array<size_t, kNumLevels> compact_pointer_{};
+
+  std::jthread background_thread_;
+};
+} // namespace tsc::node::backend
+
+#endif // LSM_BACKEND_H
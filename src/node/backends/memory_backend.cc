@@ -0,0 +1,188 @@
+#include "node/backends/memory_backend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+namespace tsc::node::backend {
+namespace {
+u32 NowStamp() {
+  // wraps every ~49 days, ages are compared with unsigned subtraction
+  return static_cast<u32>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+// what malloc really takes for a request of n bytes: a size word in front,
+// 16 byte granules and a minimum chunk. that is glibc, the others are close
+size_t HeapBytes(size_t n) {
+  return std::max<size_t>(32, (n + sizeof(size_t) + 15) & ~size_t{15});
+}
+
+// short strings live inside the object and cost nothing extra
+size_t StringHeap(size_t capacity) {
+  static const size_t kInline = std::string{}.capacity();
+  return capacity > kInline ? HeapBytes(capacity + 1) : 0;
+}
+} // namespace
+
+size_t MemoryBackend::Charge(size_t key_size, size_t value_capacity) {
+  // map node (key, hash, entry, next) plus its bucket slot, and the cell
+  // with the control block make_shared puts in front of it
+  constexpr size_t kNode = sizeof(std::string) + sizeof(size_t) +
+                           sizeof(Entry) + sizeof(void*);
+  constexpr size_t kSharedCell = sizeof(Cell) + 2 * sizeof(void*);
+  return HeapBytes(kNode) + sizeof(void*) + HeapBytes(kSharedCell) +
+         StringHeap(key_size) + StringHeap(value_capacity);
+}
+
+bool MemoryBackend::Put(KeyID id, std::string_view key, std::string value) {
+  // the key copy in the map is exact, the value keeps whatever spare the
+  // caller reserved
+  size_t charge = Charge(key.size(), value.capacity());
+  if (config_.max_bytes != 0 && charge > config_.max_bytes) {
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  auto cell = std::make_shared<Cell>(std::move(value));
+  Touch(*cell);
+  const std::string* after = &cell->value_;
+
+  auto previous = data_.Exchange(std::string{key}, Entry{
+    .id = id,
+    .cell = std::move(cell),
+    .charge = charge,
+  });
+
+  used_bytes_.fetch_add(charge, std::memory_order_relaxed);
+  if (previous) {
+    used_bytes_.fetch_sub(previous->charge, std::memory_order_relaxed);
+  }
+  // the exchange hands back exactly what this write replaced, so listeners
+  // stay right however writers to the same key interleave
+  NotifyChange(id, key, previous ? &previous->cell->value_ : nullptr, after);
+
+  if (config_.max_bytes != 0 && UsedBytes() > config_.max_bytes) {
+    EvictToBudget(key);
+  }
+  return true;
+}
+
+std::optional<std::string> MemoryBackend::Get(KeyID id,
+                                              std::string_view key) const {
+  auto value = GetShared(id, key);
+  if (!value) {
+    return std::nullopt;
+  }
+  return *value;
+}
+
+ValueRef MemoryBackend::GetShared(KeyID /*id*/, std::string_view key) const {
+  auto entry = data_.Find(key);
+  if (!entry) {
+    return nullptr;
+  }
+  const auto& cell = entry->cell;
+  Touch(*cell);
+  return ValueRef(cell, &cell->value_);
+}
+
+bool MemoryBackend::Remove(KeyID id, std::string_view key) {
+  auto removed = data_.Extract(key);
+  if (!removed) {
+    return false;
+  }
+  used_bytes_.fetch_sub(removed->charge, std::memory_order_relaxed);
+  NotifyChange(id, key, &removed->cell->value_, nullptr);
+  return true;
+}
+
+size_t MemoryBackend::Size() const {
+  return data_.Size();
+}
+
+void MemoryBackend::Scan(KeyID start, KeyID end, const ScanFn& fn) const {
+  data_.ForEach([&](const std::string& key, const Entry& entry) {
+    if (InRangeExclusiveInclusive(entry.id, start, end)) {
+      return fn(key, entry.cell->value_);
+    }
+    return true;
+  });
+}
+
+void MemoryBackend::ScanAll(const ScanFn& fn) const {
+  data_.ForEach([&](const std::string& key, const Entry& entry) {
+    return fn(key, entry.cell->value_);
+  });
+}
+
+void MemoryBackend::Clear() {
+  std::lock_guard lock(evict_mutex_);
+  data_.Clear();
+  used_bytes_.store(0, std::memory_order_relaxed);
+}
+
+void MemoryBackend::CollectMetrics(util::ModuleMetrics& out) const {
+  out.counters.emplace_back("used_bytes", UsedBytes());
+  out.counters.emplace_back("limit_bytes", config_.max_bytes);
+  out.counters.emplace_back("evicted", evicted_.load(std::memory_order_relaxed));
+  out.counters.emplace_back("evicted_bytes",
+                            evicted_bytes_.load(std::memory_order_relaxed));
+  out.counters.emplace_back("rejected",
+                            rejected_.load(std::memory_order_relaxed));
+}
+
+void MemoryBackend::Touch(const Cell& cell) const {
+  if (config_.max_bytes == 0) {
+    return;
+  }
+  // skip the store when the stamp is already current, keeps hot keys from
+  // bouncing their cache line between readers
+  u32 now = NowStamp();
+  if (cell.last_access_.load(std::memory_order_relaxed) != now) {
+    cell.last_access_.store(now, std::memory_order_relaxed);
+  }
+}
+
+void MemoryBackend::EvictToBudget(std::string_view keep) {
+  // one evictor at a time. whoever queued behind usually finds the budget
+  // already met and leaves straight away
+  std::lock_guard lock(evict_mutex_);
+
+  thread_local std::mt19937_64 rng{std::random_device{}()};
+
+  while (UsedBytes() > config_.max_bytes && data_.Size() > 0) {
+    u32 now = NowStamp();
+    std::optional<std::string> victim;
+    u32 oldest_age = 0;
+    size_t seen = 0;
+
+    data_.SampleFrom(rng(), [&](const std::string& key, const Entry& entry) {
+      if (key == keep) {
+        return true;
+      }
+      u32 age = now - entry.cell->last_access_.load(std::memory_order_relaxed);
+      if (!victim || age > oldest_age) {
+        victim = key;
+        oldest_age = age;
+      }
+      return ++seen < config_.eviction_samples;
+    });
+
+    // only keep is left. it fits on its own, so whatever is still over
+    // belongs to writes that will evict for themselves
+    if (!victim) {
+      break;
+    }
+
+    auto removed = data_.Extract(*victim);
+    if (removed) {
+      used_bytes_.fetch_sub(removed->charge, std::memory_order_relaxed);
+      evicted_.fetch_add(1, std::memory_order_relaxed);
+      evicted_bytes_.fetch_add(removed->charge, std::memory_order_relaxed);
+      NotifyChange(removed->id, *victim, &removed->cell->value_, nullptr);
+    }
+  }
+}
+} // namespace tsc::node::backend
@@ -0,0 +1,93 @@
+#ifndef MEMORY_BACKEND_H
+#define MEMORY_BACKEND_H
+
+#include <atomic>
+#include <mutex>
+
+#include "node/backends/storage_backend.h"
+#include "util/concurrent_map.h"
+
+namespace tsc::node::backend {
+// everything lives in RAM. reads are lock free, see util::ConcurrentHashMap.
+//
+// with a byte budget the backend behaves as a cache: every entry is charged
+// for the heap blocks behind it (key, value buffer with its spare capacity,
+// map node and shared cell, each rounded up the way malloc rounds), and once
+// the total goes over the budget a write evicts approximately least recently
+// used entries until it fits again. a value that could never fit is refused. recency comes from sampling a handful of
+// entries and dropping the oldest (the redis approach), so reads only pay for
+// one relaxed store and there is no list to keep in order.
+class MemoryBackend : public IStorageBackend {
+public:
+  struct Config {
+    // 0 is unbounded
+    size_t max_bytes{0};
+    size_t eviction_samples{5};
+  };
+
+  MemoryBackend() : MemoryBackend(Config{}) {}
+  explicit MemoryBackend(const Config& config) : config_(config) {}
+
+  bool Put(KeyID id, std::string_view key, std::string value) override;
+
+  std::optional<std::string> Get(KeyID id,
+                                 std::string_view key) const override;
+
+  ValueRef GetShared(KeyID id, std::string_view key) const override;
+
+  bool Remove(KeyID id, std::string_view key) override;
+
+  size_t Size() const override;
+
+  void Scan(KeyID start, KeyID end, const ScanFn& fn) const override;
+
+  void ScanAll(const ScanFn& fn) const override;
+
+  void Clear() override;
+
+  std::string Name() const override { return "memory"; }
+
+  void CollectMetrics(util::ModuleMetrics& out) const override;
+
+  [[nodiscard]] size_t UsedBytes() const {
+    return used_bytes_.load(std::memory_order_relaxed);
+  }
+
+  // what one entry costs against the budget
+  static size_t Charge(size_t key_size, size_t value_capacity);
+
+private:
+  // the value and its access stamp share one allocation. readers get a
+  // ValueRef aliasing value_, so the stamp never leaks out.
+  struct Cell {
+    explicit Cell(std::string value) : value_(std::move(value)) {}
+
+    const std::string value_;
+    mutable std::atomic<u32> last_access_{0};
+  };
+
+  struct Entry {
+    KeyID id;
+    std::shared_ptr<const Cell> cell;
+    size_t charge;
+  };
+
+  void Touch(const Cell& cell) const;
+
+  // never picks keep, the entry whose write brought us over
+  void EvictToBudget(std::string_view keep);
+
+  Config config_;
+
+  // the key id is cached so range scans do not rehash every key
+  util::ConcurrentHashMap<Entry> data_;
+
+  std::atomic<size_t> used_bytes_{0};
+  std::atomic<u64> evicted_{0};
+  std::atomic<u64> evicted_bytes_{0};
+  std::atomic<u64> rejected_{0};
+  std::mutex evict_mutex_;
+};
+} // namespace tsc::node::backend
+
+#endif // MEMORY_BACKEND_H
@@ -0,0 +1,340 @@
+#include "node/backends/sstable.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace tsc::node::backend {
+namespace {
+constexpr size_t kFooterSize = 6 * sizeof(u64);
+
+// sstables never leave the machine that wrote them, so host byte order is fine
+template <typename T>
+void Append(std::vector<u8>& buff, T value) {
+  const auto* bytes = reinterpret_cast<const u8*>(&value);
+  buff.insert(buff.end(), bytes, bytes + sizeof(T));
+}
+
+void AppendBytes(std::vector<u8>& buff, const std::string& value) {
+  Append<u32>(buff, static_cast<u32>(value.size()));
+  buff.insert(buff.end(), value.begin(), value.end());
+}
+
+void AppendKey(std::vector<u8>& buff, const InternalKey& key) {
+  Append<KeyID>(buff, key.id_);
+  AppendBytes(buff, key.key_);
+}
+
+// bounds checked reader over a byte buffer, throws on truncated input
+class Reader {
+public:
+  Reader(const u8* data, size_t size) : ptr_(data), end_(data + size) {}
+
+  template <typename T>
+  T Read() {
+    Need(sizeof(T));
+    T value;
+    std::memcpy(&value, ptr_, sizeof(T));
+    ptr_ += sizeof(T);
+    return value;
+  }
+
+  std::string ReadBytes() {
+    auto len = Read<u32>();
+    Need(len);
+    std::string result{reinterpret_cast<const char*>(ptr_), len};
+    ptr_ += len;
+    return result;
+  }
+
+  InternalKey ReadKey() {
+    InternalKey key;
+    key.id_ = Read<KeyID>();
+    key.key_ = ReadBytes();
+    return key;
+  }
+
+  [[nodiscard]] bool AtEnd() const { return ptr_ >= end_; }
+
+private:
+  void Need(size_t n) const {
+    if (static_cast<size_t>(end_ - ptr_) < n) {
+      throw std::runtime_error("sstable: truncated data");
+    }
+  }
+
+  const u8* ptr_;
+  const u8* end_;
+};
+
+bool ReadAt(int fd, std::vector<u8>& buff, u64 offset) {
+  size_t done = 0;
+  while (done < buff.size()) {
+    ssize_t n = pread(fd, buff.data() + done, buff.size() - done,
+                      static_cast<off_t>(offset + done));
+    if (n <= 0) {
+      return false;
+    }
+    done += static_cast<size_t>(n);
+  }
+  return true;
+}
+} // namespace
+
+// -------------------------------------------
+// SSTableWriter
+// -------------------------------------------
+
+SSTableWriter::SSTableWriter(std::string path)
+  : path_(std::move(path))
+  , out_(path_, std::ios::binary | std::ios::trunc) {
+  block_.reserve(SSTable::kBlockSize * 2);
+}
+
+void SSTableWriter::Add(const InternalKey& key,
+                        const std::optional<std::string>& value) {
+  if (!block_first_) {
+    block_first_ = key;
+  }
+
+  AppendKey(block_, key);
+  block_.push_back(value ? 1 : 0);
+  if (value) {
+    AppendBytes(block_, *value);
+  }
+
+  last_ = key;
+  key_hashes_.push_back(util::BloomFilter::Hash(key.key_));
+  ++entries_;
+
+  if (block_.size() >= SSTable::kBlockSize) {
+    FlushBlock();
+  }
+}
+
+void SSTableWriter::FlushBlock() {
+  if (block_.empty()) {
+    return;
+  }
+  out_.write(reinterpret_cast<const char*>(block_.data()),
+             static_cast<std::streamsize>(block_.size()));
+  index_.push_back({
+    .first_ = std::move(*block_first_),
+    .offset_ = offset_,
+    .size_ = static_cast<u32>(block_.size()),
+  });
+  offset_ += block_.size();
+  block_.clear();
+  block_first_.reset();
+}
+
+std::shared_ptr<SSTable> SSTableWriter::Finish(u64 number) {
+  FlushBlock();
+
+  std::vector<u8> index;
+  Append<u32>(index, static_cast<u32>(index_.size()));
+  for (const auto& entry : index_) {
+    AppendKey(index, entry.first_);
+    Append<u64>(index, entry.offset_);
+    Append<u32>(index, entry.size_);
+  }
+  AppendKey(index, last_);
+
+  util::BloomFilter filter(key_hashes_.size());
+  for (u64 h : key_hashes_) {
+    filter.AddHash(h);
+  }
+  std::vector<u8> bloom;
+  Append<u32>(bloom, static_cast<u32>(filter.NumHashes()));
+  bloom.insert(bloom.end(), filter.Bits().begin(), filter.Bits().end());
+
+  std::vector<u8> footer;
+  Append<u64>(footer, offset_);
+  Append<u64>(footer, index.size());
+  Append<u64>(footer, offset_ + index.size());
+  Append<u64>(footer, bloom.size());
+  Append<u64>(footer, entries_);
+  Append<u64>(footer, SSTable::kMagic);
+
+  for (const auto* section : {&index, &bloom, &footer}) {
+    out_.write(reinterpret_cast<const char*>(section->data()),
+               static_cast<std::streamsize>(section->size()));
+  }
+  out_.flush();
+  bool ok = out_.good();
+  out_.close();
+
+  if (!ok) {
+    std::error_code ec;
+    std::filesystem::remove(path_, ec);
+    return nullptr;
+  }
+  return SSTable::Open(path_, number);
+}
+
+// -------------------------------------------
+// SSTable
+// -------------------------------------------
+
+std::shared_ptr<SSTable> SSTable::Open(const std::string& path, u64 number) {
+  std::shared_ptr<SSTable> table{new SSTable()};
+  table->path_ = path;
+  table->number_ = number;
+  table->fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (table->fd_ < 0) {
+    return nullptr;
+  }
+
+  try {
+    table->file_size_ = std::filesystem::file_size(path);
+    if (table->file_size_ < kFooterSize) {
+      return nullptr;
+    }
+
+    std::vector<u8> footer(kFooterSize);
+    if (!ReadAt(table->fd_, footer, table->file_size_ - kFooterSize)) {
+      return nullptr;
+    }
+    Reader footer_reader{footer.data(), footer.size()};
+    auto index_off = footer_reader.Read<u64>();
+    auto index_size = footer_reader.Read<u64>();
+    auto bloom_off = footer_reader.Read<u64>();
+    auto bloom_size = footer_reader.Read<u64>();
+    table->entries_ = footer_reader.Read<u64>();
+    if (footer_reader.Read<u64>() != kMagic) {
+      return nullptr;
+    }
+
+    std::vector<u8> index(index_size);
+    if (!ReadAt(table->fd_, index, index_off)) {
+      return nullptr;
+    }
+    Reader index_reader{index.data(), index.size()};
+    auto count = index_reader.Read<u32>();
+    table->index_.reserve(count);
+    for (u32 i{}; i < count; ++i) {
+      IndexEntry entry;
+      entry.first_ = index_reader.ReadKey();
+      entry.offset_ = index_reader.Read<u64>();
+      entry.size_ = index_reader.Read<u32>();
+      table->index_.push_back(std::move(entry));
+    }
+    table->largest_ = index_reader.ReadKey();
+    if (!table->index_.empty()) {
+      table->smallest_ = table->index_.front().first_;
+    }
+
+    std::vector<u8> bloom(bloom_size);
+    if (!ReadAt(table->fd_, bloom, bloom_off)) {
+      return nullptr;
+    }
+    Reader bloom_reader{bloom.data(), bloom.size()};
+    auto num_hashes = static_cast<int>(bloom_reader.Read<u32>());
+    table->bloom_ = util::BloomFilter(
+        std::vector<u8>(bloom.begin() + sizeof(u32), bloom.end()), num_hashes);
+  }
+  catch (const std::exception&) {
+    return nullptr;
+  }
+
+  return table;
+}
+
+SSTable::~SSTable() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+  if (obsolete_) {
+    std::error_code ec;
+    std::filesystem::remove(path_, ec);
+  }
+}
+
+size_t SSTable::FindBlock(const InternalKey& key) const {
+  // first block whose first key is > key, the one before it may hold the key
+  auto it = std::upper_bound(
+      index_.begin(), index_.end(), key,
+      [](const InternalKey& k, const IndexEntry& e) { return k < e.first_; });
+  if (it == index_.begin()) {
+    return std::string::npos;
+  }
+  return static_cast<size_t>(std::distance(index_.begin(), it)) - 1;
+}
+
+std::vector<Entry> SSTable::ReadBlock(size_t block) const {
+  const auto& meta = index_[block];
+  std::vector<u8> data(meta.size_);
+  if (!ReadAt(fd_, data, meta.offset_)) {
+    throw std::runtime_error("sstable: failed to read block");
+  }
+
+  std::vector<Entry> entries;
+  Reader reader{data.data(), data.size()};
+  while (!reader.AtEnd()) {
+    Entry entry;
+    entry.key_ = reader.ReadKey();
+    if (reader.Read<u8>() != 0) {
+      entry.value_ = reader.ReadBytes();
+    }
+    entries.push_back(std::move(entry));
+  }
+  return entries;
+}
+
+std::optional<Entry> SSTable::Get(const InternalKey& key) const {
+  if (key < smallest_ || largest_ < key) {
+    return std::nullopt;
+  }
+  if (!bloom_.MayContain(key.key_)) {
+    return std::nullopt;
+  }
+
+  size_t block = FindBlock(key);
+  if (block == std::string::npos) {
+    return std::nullopt;
+  }
+
+  for (auto& entry : ReadBlock(block)) {
+    if (entry.key_ == key) {
+      return std::move(entry);
+    }
+  }
+  return std::nullopt;
+}
+
+// -------------------------------------------
+// SSTable::Iterator
+// -------------------------------------------
+
+SSTable::Iterator::Iterator(std::shared_ptr<const SSTable> table, KeyID from)
+  : table_(std::move(table)) {
+  size_t block = table_->FindBlock(InternalKey{.id_ = from, .key_ = {}});
+  LoadBlock(block == std::string::npos ? 0 : block);
+
+  while (Valid() && Current().key_.id_ < from) {
+    Next();
+  }
+}
+
+void SSTable::Iterator::LoadBlock(size_t block) {
+  block_ = block;
+  pos_ = 0;
+  entries_.clear();
+  if (block_ < table_->index_.size()) {
+    entries_ = table_->ReadBlock(block_);
+  }
+}
+
+void SSTable::Iterator::Next() {
+  if (++pos_ < entries_.size()) {
+    return;
+  }
+  if (block_ + 1 < table_->index_.size()) {
+    LoadBlock(block_ + 1);
+  }
+}
+} // namespace tsc::node::backend
@@ -0,0 +1,153 @@
+#ifndef SSTABLE_H
+#define SSTABLE_H
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "types/types.h"
+#include "util/bloom_filter.h"
+
+namespace tsc::node::backend {
+using namespace tsc::type;
+
+// entries are ordered by ring position first so that a ring range maps to a
+// contiguous run of blocks. the key itself only breaks ties on hash collisions.
+struct InternalKey {
+  auto operator<=>(const InternalKey& other) const = default;
+
+  KeyID id_;
+  std::string key_;
+};
+
+// a value of nullopt is a tombstone
+struct Entry {
+  InternalKey key_;
+  std::optional<std::string> value_;
+};
+
+class SSTable;
+
+// writes a sorted run of entries to disk. entries MUST be added in
+// increasing InternalKey order.
+//
+// layout:
+//   [data block]...      id | u32 klen | key | u8 live | u32 vlen | value
+//                        (id is TSC_ID_BITS wide)
+//   [index]              u32 count, per block: first key | u64 off | u32 size,
+//                        then the largest key in the table
+//   [bloom]              u32 num_hashes | bits
+//   [footer]             u64 index_off | u64 index_size | u64 bloom_off
+//                        | u64 bloom_size | u64 entries | u64 magic
+class SSTableWriter {
+public:
+  explicit SSTableWriter(std::string path);
+
+  void Add(const InternalKey& key, const std::optional<std::string>& value);
+
+  // flushes everything and opens the finished table for reading
+  std::shared_ptr<SSTable> Finish(u64 number);
+
+  [[nodiscard]] u64 FileSize() const { return offset_ + block_.size(); }
+  [[nodiscard]] u64 Entries() const { return entries_; }
+
+private:
+  struct IndexEntry {
+    InternalKey first_;
+    u64 offset_;
+    u32 size_;
+  };
+
+  void FlushBlock();
+
+  std::string path_;
+  std::ofstream out_;
+  std::vector<u8> block_;
+  std::optional<InternalKey> block_first_;
+  InternalKey last_;
+  std::vector<IndexEntry> index_;
+  std::vector<u64> key_hashes_;
+  u64 offset_{0};
+  u64 entries_{0};
+};
+
+class SSTable {
+public:
+  static constexpr size_t kBlockSize = 4096;
+  static constexpr u64 kMagic = 0x7473637373740001ULL;
+
+  // opens a table written by SSTableWriter, nullptr if the file is unreadable
+  static std::shared_ptr<SSTable> Open(const std::string& path, u64 number);
+
+  ~SSTable();
+
+  SSTable(const SSTable&) = delete;
+  SSTable& operator=(const SSTable&) = delete;
+
+  // nullopt when the table holds nothing for the key, otherwise the entry
+  // (which may be a tombstone)
+  [[nodiscard]] std::optional<Entry> Get(const InternalKey& key) const;
+
+  [[nodiscard]] const InternalKey& Smallest() const { return smallest_; }
+  [[nodiscard]] const InternalKey& Largest() const { return largest_; }
+  [[nodiscard]] u64 Number() const { return number_; }
+  [[nodiscard]] u64 FileSize() const { return file_size_; }
+  [[nodiscard]] u64 Entries() const { return entries_; }
+
+  [[nodiscard]] bool Overlaps(KeyID first, KeyID last) const {
+    return !(largest_.id_ < first || smallest_.id_ > last);
+  }
+
+  // the file is unlinked once the last reader lets go of the table
+  void MarkObsolete() { obsolete_ = true; }
+
+  // forward iterator over a table, reads one block at a time
+  class Iterator {
+  public:
+    // positions at the first entry with id >= from
+    Iterator(std::shared_ptr<const SSTable> table, KeyID from);
+
+    [[nodiscard]] bool Valid() const { return pos_ < entries_.size(); }
+    [[nodiscard]] const Entry& Current() const { return entries_[pos_]; }
+    void Next();
+
+  private:
+    void LoadBlock(size_t block);
+
+    std::shared_ptr<const SSTable> table_;
+    size_t block_{0};
+    std::vector<Entry> entries_;
+    size_t pos_{0};
+  };
+
+private:
+  struct IndexEntry {
+    InternalKey first_;
+    u64 offset_;
+    u32 size_;
+  };
+
+  SSTable() = default;
+
+  // index of the last block whose first key is <= key, or npos
+  [[nodiscard]] size_t FindBlock(const InternalKey& key) const;
+
+  [[nodiscard]] std::vector<Entry> ReadBlock(size_t block) const;
+
+  std::string path_;
+  u64 number_{0};
+  int fd_{-1};
+  u64 file_size_{0};
+  u64 entries_{0};
+  InternalKey smallest_;
+  InternalKey largest_;
+  std::vector<IndexEntry> index_;
+  util::BloomFilter bloom_;
+  std::atomic<bool> obsolete_{false};
+};
+} // namespace tsc::node::backend
+
+#endif // SSTABLE_H
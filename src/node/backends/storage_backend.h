@@ -0,0 +1,90 @@
+#ifndef STORAGE_BACKEND_H
+#define STORAGE_BACKEND_H
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "types/types.h"
+#include "util/metrics.h"
+
+namespace tsc::node::backend {
+using namespace tsc::type;
+
+// visitor for range scans, return false to stop the scan early
+using ScanFn =
+    std::function<bool(const std::string& key, const std::string& value)>;
+
+// told about every change an engine makes, including ones nobody asked for
+// such as evictions. before is the value replaced (nullptr for a new key),
+// after the value now stored (nullptr for a removal).
+using ChangeFn = std::function<void(KeyID id, std::string_view key,
+                                    const std::string* before,
+                                    const std::string* after)>;
+
+// virtual class for storage engines to inherit. every call carries the key's
+// ring position so an engine can keep its data ordered by KeyID.
+//
+// values are taken by value: callers move in the buffer they built and an
+// engine that keeps strings moves it again into place, so the bytes are
+// never copied on the way down. Put returns false when the engine refuses
+// the value, which leaves whatever was stored under the key before.
+class IStorageBackend {
+public:
+  virtual ~IStorageBackend() = default;
+
+  virtual bool Put(KeyID id, std::string_view key, std::string value) = 0;
+
+  virtual std::optional<std::string> Get(KeyID id,
+                                         std::string_view key) const = 0;
+
+  // nullptr when missing. engines that keep values in shared buffers hand
+  // them out directly, everything else pays for one copy here.
+  virtual ValueRef GetShared(KeyID id, std::string_view key) const {
+    auto value = Get(id, key);
+    if (!value) {
+      return nullptr;
+    }
+    return std::make_shared<const std::string>(std::move(*value));
+  }
+
+  virtual bool Remove(KeyID id, std::string_view key) = 0;
+
+  virtual size_t Size() const = 0;
+
+  // visits every entry whose id lies in the ring interval (start, end]
+  virtual void Scan(KeyID start, KeyID end, const ScanFn& fn) const = 0;
+
+  // visits every entry
+  virtual void ScanAll(const ScanFn& fn) const = 0;
+
+  virtual void Clear() = 0;
+
+  virtual std::string Name() const = 0;
+
+  // engine specific counters for DumpMetrics
+  virtual void CollectMetrics(util::ModuleMetrics& /*out*/) const {}
+
+  // set once, before the engine is shared between threads. Clear is not
+  // reported, whoever calls it knows.
+  void SetChangeListener(ChangeFn fn) { on_change_ = std::move(fn); }
+
+protected:
+  void NotifyChange(KeyID id, std::string_view key,
+                    const std::string* before,
+                    const std::string* after) const {
+    if (on_change_) {
+      on_change_(id, key, before, after);
+    }
+  }
+
+  bool HasChangeListener() const { return static_cast<bool>(on_change_); }
+
+private:
+  ChangeFn on_change_;
+};
+} // namespace tsc::node::backend
+
+#endif // STORAGE_BACKEND_H
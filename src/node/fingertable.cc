@@ -1,34 +1,110 @@
 #include "fingertable.h"
 
+#include "util/epoch.h"
+
+#include <algorithm>
 #include <iostream>
+#include <type_traits>
 #include <iomanip>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace tsc::node {
 using namespace tsc::type;
-FingerTable::FingerTable(NodeID owner_id) : owner_id_(owner_id) {
+namespace {
+static_assert(FingerTable::kSize % 4 == 0);
+
+// how many keys are below target, compared as signed. no branches, so the
+// cost is the same wherever target falls
+template <typename Key, size_t N>
+int CountBelow(const std::array<Key, N>& keys, Key target) {
+  using Signed = std::make_signed_t<Key>;
+#if defined(__SSE2__)
+  // sse2 has no 64 bit compare, wide ids take the loop below
+  if constexpr (sizeof(Key) == 4) {
+    const __m128i bound = _mm_set1_epi32(static_cast<int>(target));
+    __m128i below = _mm_setzero_si128();
+    for (size_t i = 0; i < N; i += 4) {
+      __m128i lane = _mm_load_si128(
+          reinterpret_cast<const __m128i*>(keys.data() + i));
+      // a lane that is below compares to all ones, i.e. -1
+      below = _mm_sub_epi32(below, _mm_cmplt_epi32(lane, bound));
+    }
+    below = _mm_add_epi32(below, _mm_shuffle_epi32(below, 0x4e));
+    below = _mm_add_epi32(below, _mm_shuffle_epi32(below, 0xb1));
+    return _mm_cvtsi128_si32(below);
+  }
+#endif
+  int below = 0;
+  for (Key key : keys) {
+    below += static_cast<Signed>(key) < static_cast<Signed>(target);
+  }
+  return below;
+}
+} // namespace
+
+FingerTable::FingerTable(NodeID owner_id, PeerTable& peers)
+    : owner_id_(owner_id), peers_(peers) {
   // all fingers start as empty
+  Fingers fingers;
+  fingers.fill(PeerTable::kNone);
+  snapshot_.store(Build(fingers));
+}
+
+FingerTable::~FingerTable() {
+  const Snapshot* snapshot = snapshot_.load();
+  for (u8 i = 0; i < snapshot->count_; i++) {
+    peers_.Release(snapshot->peers_[i]);
+  }
+  util::Epoch::Retire(snapshot);
 }
 
 std::optional<NodeInfo> FingerTable::Get(int index) const {
-  std::lock_guard lock(mutex_);
   if(index < 0 || index >= kSize) {
     return std::nullopt;
   }
-  return fingers_[index];
+  util::EpochGuard guard;
+  const Snapshot& snapshot = *snapshot_.load(std::memory_order_acquire);
+  u8 slot = snapshot.slot_[index];
+  if (slot == kEmpty) {
+    return std::nullopt;
+  }
+  return peers_.Resolve(snapshot.peers_[slot]);
 }
 
 void FingerTable::Set(int index, const NodeInfo& node) {
+  if(index < 0 || index >= kSize) {
+    return;
+  }
+  PeerHandle handle = peers_.Intern(node);
+  if (handle == PeerTable::kNone) {
+    // no room to keep node, an empty finger routes via the successor
+    Clear(index);
+    return;
+  }
   std::lock_guard lock(mutex_);
-  if(index >= 0 && index < kSize) {
-    fingers_[index] = node;
+  Fingers fingers = Expand(*snapshot_.load(std::memory_order_relaxed));
+  if (fingers[index] == handle) {
+    peers_.Release(handle);
+    return;
   }
+  fingers[index] = handle;
+  Publish(Build(fingers), handle);
 }
 
 void FingerTable::Clear(int index) {
+  if(index < 0 || index >= kSize) {
+    return;
+  }
   std::lock_guard lock(mutex_);
-  if(index >= 0 && index < kSize) {
-    fingers_[index] = std::nullopt;
+  Fingers fingers = Expand(*snapshot_.load(std::memory_order_relaxed));
+  if (fingers[index] == PeerTable::kNone) {
+    return;
   }
+  fingers[index] = PeerTable::kNone;
+  Publish(Build(fingers));
 }
 
 NodeID FingerTable::GetStart(int index) const {
@@ -36,36 +112,95 @@ NodeID FingerTable::GetStart(int index) const {
     return owner_id_;
   }
 
-  // calculate 2 ^ index (safely)
-  u64 power = 1ULL << index;
-  u64 start = (static_cast<u64>(owner_id_) + power) % (1ULL << kMBits);
-  return static_cast<NodeID>(start);
+  // ids are exactly kMBits wide, so unsigned wrap is the ring's modulus
+  return static_cast<NodeID>(owner_id_ + (NodeID{1} << index));
 }
 
 std::optional<NodeInfo> FingerTable::ClosestPrecedingNode(NodeID id) const {
+  util::EpochGuard guard;
+  const Snapshot& snapshot = *snapshot_.load(std::memory_order_acquire);
+
+  // keys are sorted, so the ones in (owner, id) are a prefix and the last
+  // of them is the closest to id
+  int below = CountBelow(snapshot.keys_, Key(id));
+  if (below == 0) {
+    return std::nullopt;
+  }
+  return peers_.Resolve(snapshot.peers_[below - 1]);
+}
+
+void FingerTable::InitialiseTo(const NodeInfo& node) {
+  PeerHandle handle = peers_.Intern(node);
+  Fingers fingers;
+  fingers.fill(handle);
+  const Snapshot* next = Build(fingers);
   std::lock_guard lock(mutex_);
+  Publish(next, handle);
+}
+
+FingerTable::Fingers FingerTable::Expand(const Snapshot& snapshot) const {
+  Fingers fingers;
+  for (int i = 0; i < kSize; i++) {
+    fingers[i] = snapshot.slot_[i] == kEmpty
+        ? PeerTable::kNone : snapshot.peers_[snapshot.slot_[i]];
+  }
+  return fingers;
+}
 
-  for(int i = kSize - 1; i >= 0; i--) {
-    if(fingers_[i].has_value()) {
-      NodeID finger_id = fingers_[i]->id_;
-      if(InRangeExclusive(finger_id, owner_id_, id)) {
-        return fingers_[i];
-      }
+const FingerTable::Snapshot* FingerTable::Build(const Fingers& fingers) const {
+  auto* snapshot = new Snapshot;
+  snapshot->keys_.fill(Key(owner_id_));
+  snapshot->slot_.fill(kEmpty);
+
+  size_t count = 0;
+  for (PeerHandle finger : fingers) {
+    if (finger != PeerTable::kNone &&
+        std::find(snapshot->peers_.begin(), snapshot->peers_.begin() + count,
+                  finger) == snapshot->peers_.begin() + count) {
+      snapshot->peers_[count++] = finger;
     }
   }
+  auto distance = [this](PeerHandle peer) {
+    return static_cast<NodeID>(peers_.Resolve(peer).id_ - owner_id_ - 1);
+  };
+  std::sort(snapshot->peers_.begin(), snapshot->peers_.begin() + count,
+            [&](PeerHandle a, PeerHandle b) {
+              return distance(a) < distance(b);
+            });
 
-  return std::nullopt;
+  for (size_t i = 0; i < count; i++) {
+    snapshot->keys_[i] = Key(peers_.Resolve(snapshot->peers_[i]).id_);
+  }
+  for (int i = 0; i < kSize; i++) {
+    if (fingers[i] != PeerTable::kNone) {
+      auto it = std::find(snapshot->peers_.begin(),
+                          snapshot->peers_.begin() + count, fingers[i]);
+      snapshot->slot_[i] = static_cast<u8>(it - snapshot->peers_.begin());
+    }
+  }
+  snapshot->count_ = static_cast<u8>(count);
+  return snapshot;
 }
 
-void FingerTable::InitialiseTo(const NodeInfo& node) {
-  std::lock_guard lock(mutex_);
-  for(size_t i{}; i < kSize; ++i) {
-    fingers_[i] = node;
+void FingerTable::Publish(const Snapshot* next, PeerHandle added) {
+  const Snapshot* previous =
+      snapshot_.exchange(next, std::memory_order_acq_rel);
+  auto next_end = next->peers_.begin() + next->count_;
+  for (u8 i = 0; i < previous->count_; i++) {
+    PeerHandle peer = previous->peers_[i];
+    if (peer == added ||
+        std::find(next->peers_.begin(), next_end, peer) == next_end) {
+      peers_.Release(peer);
+    }
   }
+  // readers of previous still resolve its handles, and a released slot is
+  // only reused once they are gone
+  util::Epoch::Retire(previous);
 }
 
 void FingerTable::Print() const {
-  std::lock_guard lock(mutex_);
+  util::EpochGuard guard;
+  Fingers fingers = Expand(*snapshot_.load(std::memory_order_acquire));
   std::cout << "Finger Table for node " << owner_id_ << ":\n";
   std::cout << std::setw(6) << "Index"
             << std::setw(12) << "Start"
@@ -76,9 +211,10 @@ void FingerTable::Print() const {
   for (int i = 0; i < kSize; i++) {
     std::cout << std::setw(6) << i
               << std::setw(12) << GetStart(i);
-    if (fingers_[i].has_value()) {
-      std::cout << std::setw(12) << fingers_[i]->id_
-                << std::setw(20) << fingers_[i]->address_.ToString();
+    if (fingers[i] != PeerTable::kNone) {
+      const NodeInfo& finger = peers_.Resolve(fingers[i]);
+      std::cout << std::setw(12) << finger.id_
+                << std::setw(20) << finger.address_.ToString();
     } else {
       std::cout << std::setw(12) << "(empty)" << std::setw(20) << "-";
     }
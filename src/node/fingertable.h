@@ -2,16 +2,32 @@
 #define FINGERTABLE_H
 
 #include <array>
+#include <atomic>
 #include <optional>
 #include <mutex>
 
+#include "node/peer_table.h"
 #include "types/types.h"
 
 namespace tsc::node {
 using namespace tsc::type;
+// fingers are read on every lookup and change a few times a second at
+// most, so readers get an immutable copy through an atomic pointer and
+// never wait. every change publishes a new copy and retires the old one
+// through Epoch.
+//
+// most fingers point at the same few nodes, so a copy keeps each distinct
+// node once, as a handle into the node's PeerTable. their ids sit in two
+// cache lines, sorted by distance from the owner, which turns
+// ClosestPrecedingNode into counting how many are closer than the target.
+// the published copy holds one PeerTable reference per distinct node.
 class FingerTable {
 public:
-  explicit FingerTable(NodeID owner_id);
+  FingerTable(NodeID owner_id, PeerTable& peers);
+  ~FingerTable();
+
+  FingerTable(const FingerTable&) = delete;
+  FingerTable& operator=(const FingerTable&) = delete;
 
   [[nodiscard]] std::optional<NodeInfo> Get(int index) const;
 
@@ -30,10 +46,43 @@ public:
   static constexpr int kSize = kMBits;
 
 private:
+  // peer handle per finger index, PeerTable::kNone if empty
+  using Fingers = std::array<PeerHandle, kSize>;
+
+  static constexpr u8 kEmpty = 0xff;
+
+  struct Snapshot {
+    // distance - 1 from the owner of each distinct node, ascending, with
+    // the sign bit flipped so a signed compare orders them. unused lanes
+    // hold the largest value, which nothing is below
+    alignas(64) std::array<NodeID, kSize> keys_;
+    // finger index to position in keys_ and peers_, or kEmpty
+    std::array<u8, kSize> slot_;
+    std::array<PeerHandle, kSize> peers_;
+    // distinct nodes, the used part of keys_ and peers_
+    u8 count_;
+  };
+
+  static constexpr NodeID kSignBit = NodeID{1} << (kMBits - 1);
+
+  // distance - 1 going clockwise from the owner, so the owner itself is last
+  [[nodiscard]] NodeID Key(NodeID id) const {
+    return static_cast<NodeID>(id - owner_id_ - 1) ^ kSignBit;
+  }
+
+  [[nodiscard]] Fingers Expand(const Snapshot& snapshot) const;
+  [[nodiscard]] const Snapshot* Build(const Fingers& fingers) const;
+
+  // with mutex_ held. releases the nodes next no longer holds, and added's
+  // fresh reference from Intern if the old copy held it already
+  void Publish(const Snapshot* next, PeerHandle added = PeerTable::kNone);
+
   NodeID owner_id_;
-  std::array<std::optional<NodeInfo>, kSize> fingers_;
+  PeerTable& peers_;
+  std::atomic<const Snapshot*> snapshot_;
+  // serialises writers only
   mutable std::mutex mutex_;
 };
 } // namespace tsc::node
 
-#endif
\ No newline at end of file
+#endif
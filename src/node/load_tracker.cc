@@ -0,0 +1,57 @@
+#include "node/load_tracker.h"
+
+namespace tsc::node {
+void LoadTracker::Record(KeyID key) {
+  count_.fetch_add(1, std::memory_order_relaxed);
+
+  std::lock_guard lock(mutex_);
+  if (samples_.size() < kSamples) {
+    samples_.push_back(key);
+    return;
+  }
+  samples_[next_] = key;
+  next_ = (next_ + 1) % kSamples;
+}
+
+void LoadTracker::Tick() {
+  auto now = std::chrono::steady_clock::now();
+  u64 count = count_.load(std::memory_order_relaxed);
+
+  std::lock_guard lock(mutex_);
+  double seconds = std::chrono::duration<double>(now - ticked_at_).count();
+  if (seconds <= 0.0) {
+    return;
+  }
+  double rate = static_cast<double>(count - ticked_count_) / seconds;
+  rate_ = kSmoothing * rate + (1.0 - kSmoothing) * rate_;
+  ticked_count_ = count;
+  ticked_at_ = now;
+}
+
+double LoadTracker::Rate() const {
+  std::lock_guard lock(mutex_);
+  return rate_;
+}
+
+std::vector<KeyID> LoadTracker::Samples(KeyID start, KeyID end) const {
+  std::lock_guard lock(mutex_);
+  std::vector<KeyID> in_range;
+  for (KeyID key : samples_) {
+    if (InRangeExclusiveInclusive(key, start, end)) {
+      in_range.push_back(key);
+    }
+  }
+  return in_range;
+}
+
+double LoadTracker::Fraction(KeyID start, KeyID end) const {
+  size_t total;
+  {
+    std::lock_guard lock(mutex_);
+    total = samples_.size();
+  }
+  return total == 0 ? 0.0
+      : static_cast<double>(Samples(start, end).size()) /
+        static_cast<double>(total);
+}
+} // namespace tsc::node
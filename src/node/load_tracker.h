@@ -0,0 +1,53 @@
+#ifndef LOAD_TRACKER_H
+#define LOAD_TRACKER_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "types/types.h"
+
+namespace tsc::node {
+using namespace tsc::type;
+
+// requests a node answers as owner, for load aware rebalancing.
+//
+// the rate is smoothed over stabilise rounds so one burst does not move
+// ranges about, and the key ids of the most recent requests are kept so a
+// node can tell which part of its arc they land on.
+class LoadTracker {
+public:
+  void Record(KeyID key);
+
+  // folds the requests since the last tick into the rate
+  void Tick();
+
+  // requests per second
+  [[nodiscard]] double Rate() const;
+
+  // the recent requests that fell in (start, end]
+  [[nodiscard]] std::vector<KeyID> Samples(KeyID start, KeyID end) const;
+
+  // share of the recent requests that fell in (start, end]
+  [[nodiscard]] double Fraction(KeyID start, KeyID end) const;
+
+private:
+  static constexpr size_t kSamples = 1024;
+  // weight of the newest round in the rate
+  static constexpr double kSmoothing = 0.3;
+
+  std::atomic<u64> count_{0};
+
+  mutable std::mutex mutex_;
+  // a ring buffer once it is full, next_ is the oldest
+  std::vector<KeyID> samples_;
+  size_t next_{0};
+  double rate_{0.0};
+  u64 ticked_count_{0};
+  std::chrono::steady_clock::time_point ticked_at_{
+      std::chrono::steady_clock::now()};
+};
+} // namespace tsc::node
+
+#endif // LOAD_TRACKER_H
@@ -0,0 +1,150 @@
+#include "node/location_cache.h"
+
+namespace tsc::node {
+namespace {
+// key in [start, end] going round the ring
+bool InArc(KeyID key, NodeID start, NodeID end) {
+  return static_cast<NodeID>(key - start) <= static_cast<NodeID>(end - start);
+}
+} // namespace
+
+LocationCache::~LocationCache() {
+  Clear();
+}
+
+std::optional<LocationCache::Hit> LocationCache::Find(KeyID key) {
+  if (capacity_ == 0) {
+    return std::nullopt;
+  }
+
+  std::lock_guard lock(mutex_);
+  // the first arc ending at or after key, wrapping past the top
+  auto it = arcs_.lower_bound(key);
+  if (it == arcs_.end()) {
+    it = arcs_.begin();
+  }
+  if (it == arcs_.end() || !InArc(key, it->second.start_, it->first)) {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+  }
+
+  it->second.last_used_ = ++clock_;
+  hits_.fetch_add(1, std::memory_order_relaxed);
+  hops_saved_.fetch_add(it->second.hops_, std::memory_order_relaxed);
+  return Hit{.owner_ = peers_.Resolve(it->second.owner_),
+             .hops_ = it->second.hops_};
+}
+
+void LocationCache::Insert(KeyID key, const NodeInfo& owner, u32 hops) {
+  if (capacity_ == 0) {
+    return;
+  }
+  // an owner more than half the ring past key is most likely one just
+  // before it, answering for a range its successor handed over (see
+  // Node::Config::rebalance). no arc ending at the owner describes that
+  if (static_cast<NodeID>(owner.id_ - key) > kHalfRing) {
+    return;
+  }
+
+  PeerHandle handle = peers_.Intern(owner, kPeerReserve);
+  if (handle == PeerTable::kNone) {
+    return;
+  }
+  std::lock_guard lock(mutex_);
+  // anything cached as owning a point in [key, owner) is out of date
+  for (auto it = arcs_.begin(); it != arcs_.end();) {
+    if (it->first != owner.id_ && InArc(it->first, key, owner.id_)) {
+      peers_.Release(it->second.owner_);
+      it = arcs_.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+
+  auto it = arcs_.find(owner.id_);
+  if (it != arcs_.end() && it->second.owner_ == handle) {
+    // the arc has its reference already
+    peers_.Release(handle);
+    // both keys resolved to owner, so the span from the farther one is
+    // free of nodes too
+    if (static_cast<NodeID>(owner.id_ - key) >
+        static_cast<NodeID>(owner.id_ - it->second.start_)) {
+      it->second.start_ = key;
+    }
+    it->second.hops_ = std::max(it->second.hops_, hops);
+    it->second.last_used_ = ++clock_;
+    return;
+  }
+
+  if (it == arcs_.end() && arcs_.size() >= capacity_) {
+    EvictOne();
+  }
+  if (it != arcs_.end()) {
+    // the same id at another address
+    peers_.Release(it->second.owner_);
+  }
+  arcs_.insert_or_assign(owner.id_, Arc{
+    .start_ = key,
+    .owner_ = handle,
+    .hops_ = hops,
+    .last_used_ = ++clock_,
+  });
+}
+
+void LocationCache::Invalidate(NodeID owner) {
+  std::lock_guard lock(mutex_);
+  auto it = arcs_.find(owner);
+  if (it != arcs_.end()) {
+    peers_.Release(it->second.owner_);
+    arcs_.erase(it);
+    stale_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void LocationCache::Clear() {
+  std::lock_guard lock(mutex_);
+  for (const auto& [owner, arc] : arcs_) {
+    peers_.Release(arc.owner_);
+  }
+  arcs_.clear();
+}
+
+util::ModuleMetrics LocationCache::Metrics() const {
+  size_t entries;
+  {
+    std::lock_guard lock(mutex_);
+    entries = arcs_.size();
+  }
+  u64 hits = hits_.load(std::memory_order_relaxed);
+  u64 misses = misses_.load(std::memory_order_relaxed);
+  return {
+    .module_name = "LocationCache",
+    .counters = {
+      {"capacity", capacity_},
+      {"entries", entries},
+      {"hits", hits},
+      {"misses", misses},
+      {"stale", stale_.load(std::memory_order_relaxed)},
+      {"hops_saved", hops_saved_.load(std::memory_order_relaxed)},
+    },
+    .gauges = {
+      {"hit_rate", hits + misses == 0 ? 0.0
+          : static_cast<double>(hits) / static_cast<double>(hits + misses)},
+    },
+  };
+}
+
+void LocationCache::EvictOne() {
+  auto victim = arcs_.begin();
+  for (auto it = arcs_.begin(); it != arcs_.end(); ++it) {
+    if (it->second.last_used_ < victim->second.last_used_) {
+      victim = it;
+    }
+  }
+  if (victim != arcs_.end()) {
+    peers_.Release(victim->second.owner_);
+    arcs_.erase(victim);
+  }
+}
+} // namespace tsc::node
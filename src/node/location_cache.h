@@ -0,0 +1,83 @@
+#ifndef LOCATION_CACHE_H
+#define LOCATION_CACHE_H
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <optional>
+
+#include "node/peer_table.h"
+#include "types/types.h"
+#include "util/metrics.h"
+
+namespace tsc::node {
+using namespace tsc::type;
+
+// which node owns which arc of the ring, as learnt from finished lookups.
+//
+// a lookup for key that ends at owner proves there is no node in
+// [key, owner), so every arc here is [start, owner] for the farthest key
+// that resolved to owner. arcs grow as lookups for neighbouring keys land
+// on the same owner and are dropped as soon as the owner refuses a key.
+//
+// each arc holds a PeerTable reference to its owner. they are unverified
+// and plentiful, so the cache stops taking new owners while the table is
+// close to full and leaves the rest to the finger tables.
+class LocationCache {
+public:
+  struct Hit {
+    NodeInfo owner_;
+    // hops the lookup that filled the entry took, i.e. what a hit saves
+    u32 hops_;
+  };
+
+  // 0 disables the cache
+  LocationCache(size_t capacity, PeerTable& peers)
+      : capacity_(capacity), peers_(peers) {}
+  ~LocationCache();
+
+  LocationCache(const LocationCache&) = delete;
+  LocationCache& operator=(const LocationCache&) = delete;
+
+  [[nodiscard]] std::optional<Hit> Find(KeyID key);
+
+  // owner is key's successor, found in hops hops
+  void Insert(KeyID key, const NodeInfo& owner, u32 hops);
+
+  // owner refused a key it was cached for, or is gone
+  void Invalidate(NodeID owner);
+
+  void Clear();
+
+  [[nodiscard]] util::ModuleMetrics Metrics() const;
+
+private:
+  struct Arc {
+    NodeID start_;
+    PeerHandle owner_;
+    u32 hops_;
+    u64 last_used_;
+  };
+
+  static constexpr NodeID kHalfRing = NodeID{1} << (kMBits - 1);
+  // PeerTable entries left for fingers
+  static constexpr size_t kPeerReserve = PeerTable::kCapacity / 16;
+
+  // least recently used arc goes, called with mutex_ held
+  void EvictOne();
+
+  size_t capacity_;
+  PeerTable& peers_;
+  mutable std::mutex mutex_;
+  // keyed by owner id, which is where the arc ends
+  std::map<NodeID, Arc> arcs_;
+  u64 clock_{0};
+
+  std::atomic<u64> hits_{0};
+  std::atomic<u64> misses_{0};
+  std::atomic<u64> stale_{0};
+  std::atomic<u64> hops_saved_{0};
+};
+} // namespace tsc::node
+
+#endif // LOCATION_CACHE_H
@@ -0,0 +1,159 @@
+#include "node/membership.h"
+
+#include <algorithm>
+
+namespace tsc::node {
+Membership::Membership(const NodeInfo& self, AdmitFn admit)
+    : self_(self), admit_(std::move(admit)) {
+  members_.push_back(self_);
+  Log(self_, true);
+}
+
+bool Membership::Add(const NodeInfo& node, bool direct) {
+  if (node.id_ == self_.id_) {
+    return false;
+  }
+  if (!admit_(node)) {
+    refused_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  std::lock_guard lock(mutex_);
+  if (auto it = dead_.find(node.id_); it != dead_.end()) {
+    if (!direct && std::chrono::steady_clock::now() - it->second < kDeadFor) {
+      return false;
+    }
+    dead_.erase(it);
+  }
+
+  auto it = LowerBound(node.id_);
+  if (it != members_.end() && it->id_ == node.id_) {
+    if (it->address_ == node.address_) {
+      return false;
+    }
+    members_[static_cast<size_t>(it - members_.begin())] = node;
+  }
+  else {
+    members_.insert(it, node);
+  }
+  Log(node, true);
+  joins_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool Membership::Remove(NodeID id) {
+  std::lock_guard lock(mutex_);
+  if (id == self_.id_) {
+    // whoever thinks we are dead is wrong, say so again
+    Log(self_, true);
+    refuted_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  std::erase_if(dead_, [now](const auto& entry) {
+    return now - entry.second >= kDeadFor;
+  });
+  dead_[id] = now;
+
+  auto it = LowerBound(id);
+  if (it == members_.end() || it->id_ != id) {
+    return false;
+  }
+  NodeInfo node = *it;
+  members_.erase(it);
+  Log(node, false);
+  leaves_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+std::optional<NodeInfo> Membership::SuccessorOf(KeyID id) const {
+  std::lock_guard lock(mutex_);
+  auto it = LowerBound(id);
+  if (it == members_.end()) {
+    it = members_.begin();
+  }
+  return *it;
+}
+
+std::optional<NodeInfo> Membership::PredecessorOf(NodeID id) const {
+  std::lock_guard lock(mutex_);
+  auto it = LowerBound(id);
+  if (it == members_.begin()) {
+    it = members_.end();
+  }
+  return *std::prev(it);
+}
+
+MembershipDelta Membership::Since(u64 cursor) const {
+  std::lock_guard lock(mutex_);
+  u64 current = first_seq_ + log_.size() - 1;
+  MembershipDelta delta{.cursor_ = current, .full_ = false, .events_ = {}};
+  if (cursor == current) {
+    return delta;
+  }
+
+  if (cursor == 0 || cursor > current || cursor + 1 < first_seq_) {
+    // from before the log starts, or from before we restarted
+    delta.full_ = true;
+    delta.events_.reserve(members_.size());
+    for (const auto& member : members_) {
+      delta.events_.push_back({.node_ = member, .joined_ = true});
+    }
+    snapshots_sent_.fetch_add(1, std::memory_order_relaxed);
+    return delta;
+  }
+
+  auto from = static_cast<std::ptrdiff_t>(cursor + 1 - first_seq_);
+  delta.events_.assign(log_.begin() + from, log_.end());
+  return delta;
+}
+
+size_t Membership::Apply(const MembershipDelta& delta) {
+  size_t changes = 0;
+  for (const auto& event : delta.events_) {
+    changes += event.joined_ ? Add(event.node_) : Remove(event.node_.id_);
+  }
+  return changes;
+}
+
+size_t Membership::Size() const {
+  std::lock_guard lock(mutex_);
+  return members_.size();
+}
+
+util::ModuleMetrics Membership::Metrics() const {
+  size_t members;
+  size_t dead;
+  {
+    std::lock_guard lock(mutex_);
+    members = members_.size();
+    dead = dead_.size();
+  }
+  return {
+    .module_name = "Membership",
+    .counters = {
+      {"members", members},
+      {"dead", dead},
+      {"joins", joins_.load(std::memory_order_relaxed)},
+      {"leaves", leaves_.load(std::memory_order_relaxed)},
+      {"refuted", refuted_.load(std::memory_order_relaxed)},
+      {"refused", refused_.load(std::memory_order_relaxed)},
+      {"snapshots_sent", snapshots_sent_.load(std::memory_order_relaxed)},
+    },
+    .gauges = {},
+  };
+}
+
+void Membership::Log(const NodeInfo& node, bool joined) {
+  log_.push_back({.node_ = node, .joined_ = joined});
+  if (log_.size() > kLogSize) {
+    log_.pop_front();
+    ++first_seq_;
+  }
+}
+
+std::vector<NodeInfo>::const_iterator Membership::LowerBound(NodeID id) const {
+  return std::ranges::lower_bound(members_, id, {}, &NodeInfo::id_);
+}
+} // namespace tsc::node
@@ -0,0 +1,85 @@
+#ifndef MEMBERSHIP_H
+#define MEMBERSHIP_H
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "types/types.h"
+#include "util/metrics.h"
+
+namespace tsc::node {
+using namespace tsc::type;
+
+// every node in the ring, sorted by id, for one hop routing.
+//
+// changes are numbered in a local event log so peers can pull just what
+// they have not seen yet, and events learnt from a peer are logged again
+// here so they keep spreading. a node that died is remembered for a while
+// so gossip that is behind cannot bring it back, unless it turns up itself.
+//
+// lookups through the table skip validation, so only nodes admit lets in
+// get in, however they were learnt.
+class Membership {
+public:
+  using AdmitFn = std::function<bool(const NodeInfo&)>;
+
+  Membership(const NodeInfo& self, AdmitFn admit);
+
+  // direct means the node itself was in touch, which beats a recent death.
+  // true if this was news, false too if admit turned it away
+  bool Add(const NodeInfo& node, bool direct = false);
+
+  bool Remove(NodeID id);
+
+  // first member at or after id, i.e. who owns id as far as we know
+  [[nodiscard]] std::optional<NodeInfo> SuccessorOf(KeyID id) const;
+
+  // last member strictly before id
+  [[nodiscard]] std::optional<NodeInfo> PredecessorOf(NodeID id) const;
+
+  // what changed after cursor, or everything if the log no longer reaches
+  // back that far
+  [[nodiscard]] MembershipDelta Since(u64 cursor) const;
+
+  // folds in a delta pulled from a peer, returns the changes it made
+  size_t Apply(const MembershipDelta& delta);
+
+  [[nodiscard]] size_t Size() const;
+
+  [[nodiscard]] util::ModuleMetrics Metrics() const;
+
+private:
+  // events kept for incremental pulls, a peer further behind gets a snapshot
+  static constexpr size_t kLogSize = 4096;
+  // how long a dead node stays dead to gossip
+  static constexpr auto kDeadFor = std::chrono::seconds(30);
+
+  // with mutex_ held
+  void Log(const NodeInfo& node, bool joined);
+  std::vector<NodeInfo>::const_iterator LowerBound(NodeID id) const;
+
+  NodeInfo self_;
+  AdmitFn admit_;
+
+  mutable std::mutex mutex_;
+  std::vector<NodeInfo> members_;
+  // event i has number first_seq_ + i
+  std::deque<MembershipEvent> log_;
+  u64 first_seq_{1};
+  std::unordered_map<NodeID, std::chrono::steady_clock::time_point> dead_;
+
+  std::atomic<u64> joins_{0};
+  std::atomic<u64> leaves_{0};
+  std::atomic<u64> refuted_{0};
+  std::atomic<u64> refused_{0};
+  mutable std::atomic<u64> snapshots_sent_{0};
+};
+} // namespace tsc::node
+
+#endif // MEMBERSHIP_H
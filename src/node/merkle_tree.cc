@@ -0,0 +1,130 @@
+#include "node/merkle_tree.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace tsc::node {
+namespace {
+constexpr size_t kSlots = size_t{2} << MerkleTree::kDepth;
+
+u64 Fnv1a(std::string_view data, u64 seed) {
+  u64 h = seed;
+  for (unsigned char c : data) {
+    h ^= c;
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+// splitmix64 finaliser so sums of digests do not cancel in obvious ways
+u64 Mix(u64 x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+} // namespace
+
+MerkleTree::MerkleTree()
+    : nodes_(new std::atomic<u64>[kSlots])
+    , counts_(new std::atomic<i64>[kLeaves]) {
+  Clear();
+}
+
+void MerkleTree::Update(KeyID id, std::string_view key,
+                        const std::string_view* before,
+                        const std::string_view* after) {
+  if (!before != !after) {
+    counts_[LeafFor(id)].fetch_add(after ? 1 : -1, std::memory_order_relaxed);
+  }
+
+  u64 delta = 0;
+  if (after) {
+    delta += Digest(key, *after);
+  }
+  if (before) {
+    delta -= Digest(key, *before);
+  }
+  if (delta == 0) {
+    return;
+  }
+
+  for (size_t slot = Slot(kDepth, LeafFor(id)); slot != 0; slot >>= 1) {
+    nodes_[slot].fetch_add(delta, std::memory_order_relaxed);
+  }
+}
+
+u64 MerkleTree::Hash(int level, u32 index) const {
+  return nodes_[Slot(level, index)].load(std::memory_order_relaxed);
+}
+
+double MerkleTree::Count(KeyID start, KeyID end) const {
+  constexpr KeyID kMax = std::numeric_limits<KeyID>::max();
+
+  // (start, end] on the ring becomes one or two linear runs
+  if (start == end) {
+    return CountLinear(0, kMax);
+  }
+  if (start < end) {
+    return CountLinear(start + 1, end);
+  }
+  return (start != kMax ? CountLinear(start + 1, kMax) : 0.0) +
+         CountLinear(0, end);
+}
+
+double MerkleTree::CountLinear(KeyID first, KeyID last) const {
+  auto count = [this](u32 leaf) {
+    return static_cast<double>(
+        std::max<i64>(counts_[leaf].load(std::memory_order_relaxed), 0));
+  };
+  // the share of a leaf's arc [from, to] takes up
+  auto share = [](KeyID from, KeyID to) {
+    constexpr double kLeafWidth =
+        static_cast<double>(KeyID{1} << (kMBits - kDepth));
+    return (static_cast<double>(to - from) + 1.0) / kLeafWidth;
+  };
+
+  u32 first_leaf = LeafFor(first);
+  u32 last_leaf = LeafFor(last);
+  if (first_leaf == last_leaf) {
+    return count(first_leaf) * share(first, last);
+  }
+  double total = count(first_leaf) * share(first, Last(kDepth, first_leaf)) +
+                 count(last_leaf) * share(First(kDepth, last_leaf), last);
+  for (u32 leaf = first_leaf + 1; leaf < last_leaf; ++leaf) {
+    total += count(leaf);
+  }
+  return total;
+}
+
+void MerkleTree::Clear() {
+  for (size_t i{}; i < kSlots; ++i) {
+    nodes_[i].store(0, std::memory_order_relaxed);
+  }
+  for (u32 i{}; i < kLeaves; ++i) {
+    counts_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+KeyID MerkleTree::First(int level, u32 index) {
+  if (level == 0) {
+    return 0;
+  }
+  return KeyID{index} << (kMBits - level);
+}
+
+KeyID MerkleTree::Last(int level, u32 index) {
+  if (level == 0) {
+    return static_cast<KeyID>(kMaxID);
+  }
+  return First(level, index) + ((KeyID{1} << (kMBits - level)) - 1);
+}
+
+u64 MerkleTree::Digest(std::string_view key, std::string_view value) {
+  u64 h = Fnv1a(key, 0xcbf29ce484222325ULL);
+  h = Fnv1a(std::string_view{"\0", 1}, h);
+  return Mix(Fnv1a(value, h));
+}
+} // namespace tsc::node
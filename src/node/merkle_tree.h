@@ -0,0 +1,70 @@
+#ifndef MERKLE_TREE_H
+#define MERKLE_TREE_H
+
+#include <atomic>
+#include <memory>
+#include <string_view>
+
+#include "types/types.h"
+
+namespace tsc::node {
+using namespace tsc::type;
+
+// hash tree over the whole KeyID space for anti-entropy.
+//
+// the ring is cut into kLeaves equal arcs. a node's digest is the sum of the
+// digests of every key below it, so a write only adds a delta along one
+// root to leaf path, lock free, and two trees holding the same keys and
+// values agree node for node regardless of insertion order. comparing two
+// trees top down and only descending where they differ finds the changed
+// arcs with work proportional to the differences.
+//
+// each leaf also keeps the number of keys under it, so counting the keys in
+// an arc never has to look at them.
+class MerkleTree {
+public:
+  static constexpr int kDepth = 12;
+  static constexpr u32 kLeaves = 1U << kDepth;
+
+  MerkleTree();
+
+  // before/after are the stored values, nullptr when absent
+  void Update(KeyID id, std::string_view key, const std::string_view* before,
+              const std::string_view* after);
+
+  // level 0 is the root, level kDepth the leaves
+  [[nodiscard]] u64 Hash(int level, u32 index) const;
+
+  // keys in (start, end]: exact for the leaves it covers whole, pro rata in
+  // the two it cuts
+  [[nodiscard]] double Count(KeyID start, KeyID end) const;
+
+  void Clear();
+
+  // the first and last id under a node, both inclusive
+  static KeyID First(int level, u32 index);
+  static KeyID Last(int level, u32 index);
+
+  static u32 LeafFor(KeyID id) {
+    return static_cast<u32>(id >> (kMBits - kDepth));
+  }
+
+  static u64 Digest(std::string_view key, std::string_view value);
+
+private:
+  static size_t Slot(int level, u32 index) {
+    return (size_t{1} << level) + index;
+  }
+
+  // first <= last, both inclusive
+  [[nodiscard]] double CountLinear(KeyID first, KeyID last) const;
+
+  // implicit binary heap, slot 1 is the root
+  std::unique_ptr<std::atomic<u64>[]> nodes_;
+  // keys per leaf. signed, a removal can land before the insert it undoes
+  // on another thread
+  std::unique_ptr<std::atomic<i64>[]> counts_;
+};
+} // namespace tsc::node
+
+#endif // MERKLE_TREE_H
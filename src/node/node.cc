@@ -8,7 +8,10 @@
 #include "security/modules/peer_age_preference.h"
 #include "security/modules/lookup_validator.h"
 #include "security/modules/rate_limiter.h"
+#include "util/epoch.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <random>
 
@@ -17,20 +20,108 @@ using namespace tsc::tcp;
 using namespace tsc::hsh;
 using namespace tsc::sec;
 
-Node::Node(const Config& config)
-    : config_(config), address_{.ip_ = config.ip_, .port_ = config.port_} {
+namespace {
+Storage::Config StorageConfigFor(const Node::Config& config) {
+  Storage::Config storage_config;
+  storage_config.max_bytes = config.storage_max_bytes;
+  if (!config.lsm_dir.empty()) {
+    storage_config.backend = Storage::Config::Backend::kLsm;
+    // nodes started with the same flags must not share sstables
+    storage_config.data_dir =
+        config.lsm_dir + "/" + std::to_string(config.port_);
+  }
+  return storage_config;
+}
+} // namespace
+
+Node::Node(const Config& config) : Node(config, nullptr, 0) {}
+
+Node::Node(const Config& config, Node* host, u8 vnode)
+    : config_(config)
+    , address_{.ip_ = config.ip_, .port_ = config.port_, .vnode_ = vnode}
+    , host_(host)
+    , storage_(host ? host->storage_
+                    : std::make_shared<Storage>(StorageConfigFor(config)))
+    , codec_(host ? host->codec_
+                  : std::make_shared<ValueCodec>(config.compress_min_bytes))
+    , peers_(host ? host->peers_ : std::make_shared<PeerTable>())
+    , location_cache_(config.location_cache_size, *peers_) {
+  ring_view_.store(new RingView{});
   if (config_.spoof_id) {
-    std::mt19937 rng(std::random_device{}());
+    std::mt19937_64 rng(std::random_device{}());
     id_ = static_cast<NodeID>(rng());
   } else {
     id_ = Hash::HashNode(address_);
   }
-  finger_table_ = std::make_unique<FingerTable>(id_);
-  server_ = std::make_unique<TcpServer>(config_.port_, this);
+  finger_table_ = std::make_unique<FingerTable>(id_, *peers_);
+  if (config_.one_hop) {
+    // whatever the policy would not route through stays out of one hop
+    // routing too
+    membership_ = std::make_unique<Membership>(
+        Info(), [this](const NodeInfo& node) {
+          return security_policy_.AllowNode(node);
+        });
+  }
+  if (!host_) {
+    server_ = std::make_unique<TcpServer>(config_.port_, this);
+  }
+
+  config_.replication_factor = std::max(config_.replication_factor, 1);
+  config_.write_quorum =
+      std::clamp(config_.write_quorum, 1, config_.replication_factor);
+  config_.read_quorum =
+      std::clamp(config_.read_quorum, 1, config_.replication_factor);
+  if (config_.replication_factor > 1 && !host_) {
+    replica_pool_ = std::make_unique<util::ThreadPool>(kReplicaWorkers);
+  }
+  if ((config_.replication_factor > 1 || config_.rebalance) && !host_) {
+    transfer_pool_ = std::make_unique<util::ThreadPool>(kTransferWorkers);
+  }
+
+  config_.lookup_parallelism =
+      std::clamp(config_.lookup_parallelism, 1, kMaxLookupParallelism);
+
+  config_.virtual_nodes =
+      std::clamp(config_.virtual_nodes, 1, kMaxVirtualNodes);
+  if (!host_) {
+    for (int i = 1; i < config_.virtual_nodes; ++i) {
+      vnodes_.push_back(
+          std::unique_ptr<Node>(new Node(config_, this, static_cast<u8>(i))));
+    }
+  }
+
+  scheduler_ = util::Scheduler::Shared();
+  auto routine = [this](auto min, auto max, void (Node::*round)()) {
+    return std::make_unique<util::Routine>(scheduler_, min, max, [this, round] {
+      u64 sent = TcpClient::RequestsSent();
+      (this->*round)();
+      CountMaintenanceRpcs(TcpClient::RequestsSent() - sent);
+    });
+  };
+  stabilise_routine_ = routine(Config::stabilise_interval_min,
+                               Config::stabilise_interval_max,
+                               &Node::Stabilise);
+  fix_fingers_routine_ = routine(Config::fix_fingers_interval_min,
+                                 Config::fix_fingers_interval_max,
+                                 &Node::FixFingers);
+  check_predecessor_routine_ = routine(Config::check_predecessor_interval_min,
+                                       Config::check_predecessor_interval_max,
+                                       &Node::CheckPredecessor);
+}
+
+Node* Node::VirtualNode(u8 index) {
+  if (index == 0) {
+    return this;
+  }
+  return index <= vnodes_.size() ? vnodes_[index - 1].get() : nullptr;
 }
 
 Node::~Node() {
   Shutdown();
+  // queued batches find running_ cleared and return, one under way still
+  // has the routines it tightens
+  transfer_pool_.reset();
+  util::Epoch::Retire(ring_view_.load());
 }
 
 void Node::InitialiseSecurity(){
@@ -74,24 +165,52 @@ void Node::InitialiseSecurity(){
 }
 
 bool Node::Create() {
-  {
-    std::lock_guard lock(ring_mutex_);
-    predecessor_ = std::nullopt;
-    successor_ = Info();
+  // the new ring is just our own positions. they are linked up in order
+  // here, joining them one by one through a node that is still its own
+  // successor leaves the ring backwards and stabilise takes a round per
+  // position to turn it round
+  std::vector<Node*> positions{this};
+  for (auto& vnode : vnodes_) {
+    positions.push_back(vnode.get());
+  }
+  std::ranges::sort(positions, {}, &Node::ID);
+  for (size_t i{}; i < positions.size(); ++i) {
+    Node* node = positions[i];
+    std::vector<NodeInfo> following;
+    for (size_t j = 1; j < positions.size() &&
+                       j <= Config::successor_list_size; ++j) {
+      following.push_back(positions[(i + j) % positions.size()]->Info());
+    }
+    {
+      RingUpdate update(*node);
+      if (following.empty()) {
+        node->predecessor_ = std::nullopt;
+        node->successor_ = Info();
+      }
+      else {
+        node->predecessor_ =
+            positions[(i + positions.size() - 1) % positions.size()]->Info();
+        node->successor_ = following.front();
+      }
+      node->successor_list_ = following;
+    }
+    node->finger_table_->InitialiseTo(*node->GetSuccessor());
   }
-
-  finger_table_->InitialiseTo(Info());
 
   if(!server_->Start()) {
     return false;
   }
 
   InitialiseSecurity();
+  for (auto& vnode : vnodes_) {
+    vnode->InitialiseSecurity();
+  }
 
   running_ = true;
-  stabilise_thread_ = std::jthread(&Node::StabilisationLoop, this);
-  fix_fingers_thread_ = std::jthread(&Node::FixFingersLoop, this);
-  check_predecessor_thread_ = std::jthread(&Node::CheckPredecessorLoop, this);
+  StartMaintenance();
+  for (auto& vnode : vnodes_) {
+    vnode->StartMaintenance();
+  }
 
   return true;
 }
@@ -101,310 +220,2326 @@ bool Node::Join(const NodeAddress& known_node) {
     return false;
   }
 
-  auto successor = TcpClient::FindSuccessor(known_node, id_);
-  if(!successor) {
+  if (!EnterRing(known_node)) {
     server_->Stop();
     return false;
   }
+  for (auto& vnode : vnodes_) {
+    if (!vnode->EnterRing(known_node)) {
+      server_->Stop();
+      return false;
+    }
+  }
+
+  running_ = true;
+  StartMaintenance();
+  for (auto& vnode : vnodes_) {
+    vnode->StartMaintenance();
+  }
+
+  std::cerr << "Joined Ring: " << successor_->address_.ToString() << "\n";
+  TakeOverArc();
+  for (auto& vnode : vnodes_) {
+    vnode->TakeOverArc();
+  }
+  return true;
+}
+
+bool Node::EnterRing(const NodeAddress& known) {
+  auto successor = TcpClient::FindSuccessor(known, id_);
+  if(!successor) {
+    return false;
+  }
 
   {
-    std::lock_guard lock(ring_mutex_);
+    RingUpdate update(*this);
     predecessor_ = std::nullopt;
     successor_ = successor;
+    successor_list_ = {*successor};
   }
 
   finger_table_->InitialiseTo(*successor);
 
   InitialiseSecurity();
-
-  running_ = true;
-  stabilise_thread_ = std::jthread(&Node::StabilisationLoop, this);
-  fix_fingers_thread_ = std::jthread(&Node::FixFingersLoop, this);
-  check_predecessor_thread_ = std::jthread(&Node::CheckPredecessorLoop, this);
-
-  std::cerr << "Joined Ring: " << successor_->address_.ToString() << "\n";
   return true;
 }
 
 void Node::Leave() {
-  std::lock_guard lock(ring_mutex_);
-  if (successor_ && successor_->id_ != id_) {
-    auto keys = storage_.Keys();
-    for (const auto& key : keys) {
-      auto value = storage_.Get(key);
-      if (value) {
-        TcpClient::Put(successor_->address_, key, *value);
-      }
-    }
+  // nothing to maintain any more, and rounds would only compete with the
+  // handoff for the ring locks
+  StopMaintenance();
+  for (auto& vnode : vnodes_) {
+    vnode->StopMaintenance();
+  }
+
+  // top down from a position whose successor is remote, so each goes
+  // before its predecessor and the heir of a run of ours ends up linked to
+  // whoever stays in front of it
+  std::vector<Node*> positions{this};
+  for (auto& vnode : vnodes_) {
+    positions.push_back(vnode.get());
+  }
+  std::ranges::sort(positions, std::ranges::greater{}, &Node::ID);
+  auto first = std::ranges::find_if(positions, [](Node* node) {
+    auto successor = node->GetSuccessor();
+    return successor && !node->IsLocal(*successor);
+  });
+  if (first != positions.end()) {
+    std::ranges::rotate(positions, first);
+  }
+  for (Node* node : positions) {
+    node->HandOffKeys();
   }
 
   Shutdown();
 }
 
-void Node::Shutdown() {
-  running_ = false;
-
-  if (stabilise_thread_.joinable()) { stabilise_thread_.join(); }
-  if (fix_fingers_thread_.joinable()) { fix_fingers_thread_.join(); }
-  if (check_predecessor_thread_.joinable()) { check_predecessor_thread_.join(); }
-
-  server_->Stop();
-}
+void Node::TakeOverArc() {
+  auto donor = GetSuccessor();
+  if (!donor || IsLocal(*donor)) {
+    return;
+  }
+  // a ring of one owns everything, (donor, us] is what we take from it
+  auto from = TcpClient::GetPredecessor(donor->address_).value_or(*donor);
+  if (from.id_ == id_ || InRangeExclusive(from.id_, id_, donor->id_)) {
+    // someone joined between us, stabilise will sort out who is next
+    return;
+  }
 
-std::optional<NodeInfo> Node::FindSuccessor(NodeID node_id, bool validate) {
-  NodeAddress target;
   {
-    std::lock_guard lock(ring_mutex_);
-
-    if (!successor_) {
-      return std::nullopt;
-    }
-
-    if (InRangeExclusiveInclusive(node_id, id_, successor_->id_)) {
-      return successor_;
+    RingUpdate update(*this);
+    if (!predecessor_ && security_policy_.AllowNode(from)) {
+      predecessor_ = from;
+      TopologyChanged();
     }
-
-    auto closest = ClosestPrecedingNode(node_id);
-
-    if (!closest || closest->id_ == id_ || !security_policy_.AllowNode(*closest)) {
-      return successor_;
-    }
-
-    target = closest->address_;
+    handoff_ = Delegation{.start_ = from.id_, .end_ = id_, .peer_ = *donor};
   }
+  // from here on the donor refuses the arc and requests for it come to us
+  TcpClient::Notify(donor->address_, Info());
 
-  auto result = TcpClient::FindSuccessor(target, node_id);
+  // the donor stays one of our replicas if there are any, so it keeps
+  // its copies
+  size_t pulled = config_.replication_factor > 1
+      ? SyncRange(donor->address_, from.id_, id_).value_or(0)
+      : PullArc(donor->address_, from.id_, id_);
 
-  if (validate && result && !security_policy_.ValidateLookup(node_id, *result)) {
-    return std::nullopt;
+  {
+    RingUpdate update(*this);
+    handoff_.reset();
   }
-
-  return result;
+  join_keys_.fetch_add(pulled, std::memory_order_relaxed);
+  std::cerr << "Join: took (" << from.id_ << ", " << id_ << "] from "
+            << donor->id_ << ", " << pulled << " keys\n";
 }
 
-std::optional<NodeInfo> Node::ClosestPrecedingNode(NodeID node_id) {
-  if (auto finger_result = finger_table_->ClosestPrecedingNode(node_id)) {
-    return finger_result;
-  }
-
-  if (successor_ && InRangeExclusive(successor_->id_, id_, node_id)) {
-    return successor_;
+size_t Node::PullArc(const NodeAddress& donor, KeyID start, KeyID end) {
+  size_t pulled = 0;
+  while (auto batch = TcpClient::TransferKeys(donor, start, end, Info(),
+                                              kHandoffBatch)) {
+    size_t size = batch->size();
+    pulled += size;
+    storage_->ImportMissing(std::move(*batch));
+    if (size < kHandoffBatch) {
+      break;
+    }
   }
-
-  return std::nullopt;
+  return pulled;
 }
 
-void Node::Notify(const NodeInfo& node) {
+std::optional<size_t> Node::PeerLeaving(
+    const NodeInfo& node, const std::optional<NodeInfo>& predecessor,
+    const NodeInfo& successor, KeyID start, bool heir) {
   if (!security_policy_.AllowNode(node)) {
-    return;
+    return std::nullopt;
   }
 
-  std::lock_guard lock(ring_mutex_);
-
-  if (!predecessor_ || InRangeExclusive(node.id_, predecessor_->id_, id_)) {
-    if (predecessor_ && security_policy_.PreferOver(*predecessor_, node)) {
-      return;
+  // only a neighbour can leave from next to us, and only as we know it
+  auto same = [&node](const std::optional<NodeInfo>& neighbour) {
+    return neighbour && neighbour->id_ == node.id_ &&
+           neighbour->address_ == node.address_;
+  };
+  bool was_predecessor = false;
+  bool was_successor = false;
+  {
+    RingUpdate update(*this);
+    if (same(predecessor_)) {
+      std::cerr << "Predecessor " << node.id_ << " left\n";
+      predecessor_.reset();
+      if (predecessor && predecessor->id_ != id_ &&
+          security_policy_.AllowNode(*predecessor)) {
+        predecessor_ = predecessor;
+      }
+      was_predecessor = true;
+    }
+    if (same(successor_)) {
+      was_successor = true;
+      // one we would not take is left to the failover below
+      if (successor.id_ == id_ || security_policy_.AllowNode(successor)) {
+        std::cerr << "Successor " << node.id_ << " left, linking to "
+          << successor.id_ << "\n";
+        successor_ = successor.id_ == id_ ? Info() : successor;
+      }
+    }
+    // its keys are ours only if it was in front of us
+    heir = heir && was_predecessor;
+    if (heir) {
+      handoff_ = Delegation{.start_ = start, .end_ = node.id_, .peer_ = node};
     }
-    std::cerr << "Update predecessor to " << node.id_ << " at " << node.address_.ToString() << "\n";
-    predecessor_ = node;
   }
-}
+  if (!was_predecessor && !was_successor) {
+    return std::nullopt;
+  }
+  // fingers, caches and the successor list forget it as they would a
+  // failure, just without waiting for one
+  HandleDeadPeer(node);
+  if (was_successor) {
+    finger_table_->Set(0, *GetSuccessor());
+  }
+  if (!heir) {
+    return 0;
+  }
 
-std::optional<NodeInfo> Node::GetPredecessor() const {
-  std::lock_guard lock(ring_mutex_);
-  return predecessor_;
+  size_t pulled = PullArc(node.address_, start, node.id_);
+  {
+    RingUpdate update(*this);
+    handoff_.reset();
+  }
+  leave_keys_.fetch_add(pulled, std::memory_order_relaxed);
+  std::cerr << "Leave: took (" << start << ", " << node.id_ << "] from "
+            << node.id_ << ", " << pulled << " keys\n";
+  return pulled;
 }
 
-std::optional<NodeInfo> Node::GetSuccessor() const {
-  std::lock_guard lock(ring_mutex_);
-  return successor_;
+std::optional<NodeInfo> Node::HandoffPeerOf(KeyID key_id) const {
+  const Node& host = host_ ? *host_ : *this;
+  auto other_side = [key_id](const Node& node) -> std::optional<NodeInfo> {
+    util::EpochGuard guard;
+    const RingView& view = node.View();
+    if (view.InHandoff(key_id)) {
+      return view.handoff_->peer_;
+    }
+    if (view.InHanded(key_id)) {
+      return view.handed_->peer_;
+    }
+    return std::nullopt;
+  };
+  if (auto peer = other_side(host)) {
+    return peer;
+  }
+  for (const auto& vnode : host.vnodes_) {
+    if (auto peer = other_side(*vnode)) {
+      return peer;
+    }
+  }
+  return std::nullopt;
 }
 
-bool Node::Put(const std::string& key, const std::string& value) {
-  KeyID key_id = hsh::Hash::HashKey(key);
+void Node::HandOffKeys() {
+  // our own virtual nodes are leaving too
+  std::optional<NodeInfo> heir;
+  // (id, id] is the whole ring. with virtual nodes each hands off only its
+  // own arc of the shared storage
+  NodeID from = id_;
+  std::optional<NodeInfo> predecessor;
   {
     std::lock_guard lock(ring_mutex_);
-    if (!predecessor_ ||
-        InRangeExclusiveInclusive(key_id, predecessor_->id_, id_)) {
-      LocalPut(key, value);
-      return true;
+    predecessor = predecessor_;
+    if (successor_ && !IsLocal(*successor_)) {
+      heir = successor_;
+    }
+    else {
+      auto it = std::ranges::find_if(successor_list_, [this](const NodeInfo& node) {
+        return !IsLocal(node);
+      });
+      if (it != successor_list_.end()) {
+        heir = *it;
+      }
+    }
+    if (config_.virtual_nodes > 1 && predecessor_) {
+      from = predecessor_->id_;
     }
   }
-  auto successor = FindSuccessor(key_id, true);   // true = call ValidateLookup
-  if (!successor) return false;
-  if (successor->id_ == id_) { LocalPut(key, value); return true; }
-  return TcpClient::Put(successor->address_, key, value);
-}
 
+  if (!heir) {
+    return;
+  }
 
-std::optional<std::string> Node::Get(const std::string& key) {
-  KeyID key_id = hsh::Hash::HashKey(key);
   {
-    std::lock_guard lock(ring_mutex_);
-    if (!predecessor_ ||
-        InRangeExclusiveInclusive(key_id, predecessor_->id_, id_)) {
-      return LocalGet(key);
+    RingUpdate update(*this);
+    leaving_.store(true, std::memory_order_release);
+    handoff_ = Delegation{.start_ = from, .end_ = id_, .peer_ = *heir};
+  }
+  // both neighbours link past us now rather than when stabilise notices.
+  // one of ours in front is leaving too and does its own
+  if (predecessor && !IsLocal(*predecessor) && predecessor->id_ != heir->id_) {
+    TcpClient::Leave(predecessor->address_, Info(), predecessor, *heir, from,
+                     false);
+  }
+  auto pulled = TcpClient::Leave(heir->address_, Info(), predecessor, *heir,
+                                 from, true, kLeaveTimeout);
+
+  // whatever the heir did not take, because it could not or the record was
+  // written since, goes one by one. stored as is, a plain put would have
+  // the heir, which may not own these keys yet, route them straight back
+  size_t pushed = 0;
+  u64 now = Record::NowMs();
+  for (const auto& [key, blob] : storage_->ExportRange(from, id_)) {
+    auto record = Record::Decode(blob);
+    if (!record) {
+      continue;
+    }
+    std::chrono::milliseconds ttl{};
+    if (record->expires_at_ms_) {
+      if (record->ExpiredAt(now)) {
+        continue;
+      }
+      ttl = std::chrono::milliseconds(*record->expires_at_ms_ - now);
     }
+    EncodedValue value{
+      .bytes_ = std::string{record->payload_},
+      .compressed_ = record->Compressed(),
+    };
+    TcpClient::PutReplica(heir->address_, key, value, ttl);
+    ++pushed;
   }
-  auto successor = FindSuccessor(key_id, true);   // true = call ValidateLookup
-  if (!successor) return std::nullopt;
-  if (successor->id_ == id_) return LocalGet(key);  // single-node fallback
-  return TcpClient::Get(successor->address_, key);
+  std::cerr << "Leave: handed " << pulled.value_or(0) << " keys in batches and "
+            << pushed << " one by one to " << heir->id_ << "\n";
 }
 
+void Node::Shutdown() {
+  running_ = false;
+  StopMaintenance();
+  for (auto& vnode : vnodes_) {
+    vnode->StopMaintenance();
+  }
 
-bool Node::Remove(const std::string& key) {
-  return storage_.Remove(key);
-}
-
-void Node::LocalPut(const std::string& key, const std::string& value) {
-  storage_.Put(key, value);
+  if (server_) {
+    server_->Stop();
+  }
 }
 
-std::optional<std::string> Node::LocalGet(const std::string& key) const {
-  return storage_.Get(key);
+std::optional<NodeInfo> Node::FindSuccessor(NodeID node_id, bool validate) {
+  size_t hops = 0;
+  return FindSuccessor(node_id, validate, hops);
 }
 
-std::vector<std::pair<std::string, std::string>> Node::GetKeysInRange(
-    NodeID start, NodeID end) {
-  return storage_.GetRange(start, end);
-}
+std::optional<NodeInfo> Node::FindSuccessor(NodeID node_id, bool validate,
+                                            size_t& hops) {
+  auto start = std::chrono::steady_clock::now();
+  auto result = Route(node_id, validate, hops);
 
-void Node::Stabilise() {
-  std::optional<NodeInfo> successor_copy;
-  {
-    std::lock_guard lock(ring_mutex_);
-    successor_copy = successor_;
+  lookups_.fetch_add(1, std::memory_order_relaxed);
+  lookup_hops_.fetch_add(hops, std::memory_order_relaxed);
+  if (!result) {
+    lookup_failed_.fetch_add(1, std::memory_order_relaxed);
   }
-
-  if (!successor_copy) {
-    return;
+  else {
+    lookup_latency_.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start));
   }
+  return result;
+}
 
-  auto predecessor = TcpClient::GetPredecessor(successor_copy->address_);
+std::optional<NodeInfo> Node::Route(NodeID node_id, bool validate,
+                                    size_t& hops) {
+  size_t more = static_cast<size_t>(config_.lookup_parallelism) - 1;
+  for (int attempt{}; attempt < kLookupAttempts; ++attempt) {
+    auto hop = NextHop(node_id, more);
+    if (!hop) {
+      return std::nullopt;
+    }
+    if (hop->final_) {
+      return hop->node_;
+    }
 
-  if (predecessor) {
-    if (!security_policy_.AllowNode(*predecessor)) {
-      // just do nothing
+    NodeInfo next = hop->node_;
+    std::optional<NodeInfo> result;
+    if (config_.lookup_parallelism > 1) {
+      result = ParallelLookup(node_id, *hop, next, hops);
+    }
+    else if (config_.iterative_lookup) {
+      result = IterativeLookup(node_id, next, hops);
     }
     else {
-      std::lock_guard lock(ring_mutex_);
+      // a recursive lookup only sees its own first hop
+      ++hops;
+      result = TcpClient::FindSuccessor(next.address_, node_id);
+    }
 
-      if (InRangeExclusive(predecessor->id_, id_, successor_->id_)) {
-        std::cerr << "Stabilise: updating successor from " << successor_->id_
-          << " to " << predecessor->id_ << "\n";
-        successor_ = predecessor;
-        finger_table_->Set(0, *predecessor);
+    if (!result) {
+      // a live hop that could not answer is not worth routing around
+      if (IsAlive(next.address_)) {
+        return std::nullopt;
       }
+      HandleDeadPeer(next);
+      lookup_retries_.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+
+    if (validate && !security_policy_.ValidateLookup(node_id, *result)) {
+      return std::nullopt;
     }
+
+    return result;
   }
 
-  {
-    std::lock_guard lock(ring_mutex_);
-    successor_copy = successor_;
+  return std::nullopt;
+}
+
+std::optional<LookupHop> Node::NextHop(NodeID node_id, size_t more) {
+  util::EpochGuard guard;
+  const RingView& view = View();
+
+  if (!view.successor_) {
+    return std::nullopt;
   }
 
-  if (successor_copy && successor_copy->id_ != id_) {
-    TcpClient::Notify(successor_copy->address_, Info());
+  // ranges moved by rebalancing end with the node that now answers for them
+  if (view.InAdoptedRange(node_id)) {
+    return LookupHop{.node_ = Info(), .final_ = true, .more_ = {}};
+  }
+  if (view.InDelegatedRange(node_id)) {
+    return LookupHop{.node_ = view.delegated_->peer_, .final_ = true, .more_ = {}};
   }
 
-  security_policy_.Tick();
-}
+  if (InRangeExclusiveInclusive(node_id, id_, view.successor_->id_)) {
+    return LookupHop{.node_ = *view.successor_, .final_ = true, .more_ = {}};
+  }
 
-std::vector<NodeInfo> Node::AlternativeNodes() const {
-  std::vector<NodeInfo> alternatives;
+  // the successor list knows who owns the arc after the successor too, so
+  // the lookup ends here instead of going through a node that might stall
+  NodeID from = view.successor_->id_;
+  for (const auto& entry : view.successor_list_) {
+    if (entry.id_ == id_) {
+      break;
+    }
+    if (entry.id_ == from) {
+      continue;
+    }
+    if (InRangeExclusiveInclusive(node_id, from, entry.id_)) {
+      return LookupHop{.node_ = entry, .final_ = true, .more_ = {}};
+    }
+    from = entry.id_;
+  }
 
-  for (int i{}; i < FingerTable::kSize; i += 4) {
-    auto entry = finger_table_->Get(i);
-    if (entry && entry->id_ != id_) {
-      bool duplicate = false;
-      for (const auto& alt : alternatives) {
-        if (alt.id_ == entry->id_) {
-          duplicate = true;
-          break;
-        }
-      }
-      if (!duplicate) {
-        alternatives.push_back(*entry);
-      }
+  auto closest = ClosestPrecedingNode(view, node_id);
+
+  if (membership_) {
+    // the full membership usually knows a node closer than any finger. self
+    // is a member, so anything else it returns is in (id_, node_id)
+    auto member = membership_->PredecessorOf(node_id);
+    if (member && member->id_ != id_ &&
+        (!closest || closest->id_ == id_ ||
+         static_cast<NodeID>(node_id - member->id_) <
+             static_cast<NodeID>(node_id - closest->id_))) {
+      closest = member;
     }
   }
 
-  return alternatives;
-}
+  if (!closest || closest->id_ == id_ || !security_policy_.AllowNode(*closest)) {
+    return LookupHop{.node_ = *view.successor_, .final_ = true, .more_ = {}};
+  }
 
-void Node::DumpMetrics() const{
-  if (security_policy_.Empty()) {
-    std::cout << "METRICS:{\"modules\":[]}" << std::endl;
-    return;
+  LookupHop hop{.node_ = *closest, .final_ = false, .more_ = {}};
+  if (more > 0) {
+    for (auto& node : PrecedingNodes(view, node_id, more + 1)) {
+      if (node.id_ != closest->id_ && hop.more_.size() < more) {
+        hop.more_.push_back(std::move(node));
+      }
+    }
   }
-  std::cout << "METRICS:" << security_policy_.MetricsToJSON() << std::endl;
+  return hop;
 }
 
-void Node::FixFingers() {
-  next_finger_ = (next_finger_ + 1) % FingerTable::kSize;
+std::vector<NodeInfo> Node::PrecedingNodes(const RingView& view,
+                                           NodeID node_id, size_t count) {
+  std::vector<NodeInfo> nodes;
+  auto consider = [&](const NodeInfo& node) {
+    if (node.id_ == id_ || !InRangeExclusive(node.id_, id_, node_id) ||
+        std::ranges::any_of(nodes, [&node](const NodeInfo& known) {
+          return known.id_ == node.id_;
+        }) ||
+        !security_policy_.AllowNode(node)) {
+      return;
+    }
+    nodes.push_back(node);
+  };
 
-  NodeID finger_id = finger_table_->GetStart(next_finger_);
-  auto successor = FindSuccessor(finger_id);
+  for (int i{}; i < FingerTable::kSize; ++i) {
+    if (auto finger = finger_table_->Get(i)) {
+      consider(*finger);
+    }
+  }
+  for (const auto& entry : view.successor_list_) {
+    consider(entry);
+  }
+  if (view.successor_) {
+    consider(*view.successor_);
+  }
 
-  if (successor && security_policy_.AllowNode(*successor)) {
-    finger_table_->Set(next_finger_, *successor);
+  // unsigned distance still to go, wraps the same way the ring does
+  std::ranges::sort(nodes, {}, [node_id](const NodeInfo& node) {
+    return static_cast<NodeID>(node_id - node.id_);
+  });
+  if (nodes.size() > count) {
+    nodes.resize(count);
   }
+  return nodes;
 }
 
+std::optional<NodeInfo> Node::ParallelLookup(NodeID node_id,
+                                             const LookupHop& first,
+                                             NodeInfo& hop, size_t& hops) {
+  auto distance = [node_id](NodeID id) {
+    return static_cast<NodeID>(node_id - id);
+  };
+
+  // not asked yet, closest to node_id first
+  std::vector<NodeInfo> candidates;
+  std::vector<NodeID> seen;
+  auto offer = [&](const NodeInfo& node) {
+    if (std::ranges::find(seen, node.id_) != seen.end()) {
+      return;
+    }
+    seen.push_back(node.id_);
+    auto at = std::ranges::upper_bound(candidates, distance(node.id_), {},
+                                       [&](const NodeInfo& candidate) {
+                                         return distance(candidate.id_);
+                                       });
+    candidates.insert(at, node);
+  };
+  offer(first.node_);
+  for (const auto& node : first.more_) {
+    offer(node);
+  }
 
-void Node::CheckPredecessor() {
-  std::lock_guard lock(ring_mutex_);
+  auto alpha = static_cast<size_t>(config_.lookup_parallelism);
+  auto more = static_cast<u8>(alpha - 1);
+  // a request's tag is its index here
+  std::vector<NodeInfo> asked;
+  std::vector<NodeInfo> failed;
+  RequestSet requests;
+
+  while (true) {
+    while (requests.InFlight() < alpha && !candidates.empty() &&
+           asked.size() < static_cast<size_t>(kMaxLookupHops)) {
+      asked.push_back(candidates.front());
+      candidates.erase(candidates.begin());
+      ++hops;
+      if (!requests.Start(asked.size() - 1, asked.back().address_,
+                          TcpClient::EncodeNextHop(node_id, more),
+                          kParallelHopTimeout)) {
+        failed.push_back(asked.back());
+      }
+    }
+    if (requests.InFlight() == 0) {
+      break;
+    }
 
-  if (predecessor_) {
-    if (!IsAlive(predecessor_->address_)) {
-      std::cerr << "Predecessor " << predecessor_->id_ << " has failed" << "\n";
-      predecessor_ = std::nullopt;
+    for (auto& done : requests.Poll(kParallelHopTimeout)) {
+      const NodeInfo& from = asked[done.tag_];
+      auto answer = done.response_
+          ? TcpClient::DecodeNextHop(std::move(*done.response_))
+          : std::nullopt;
+      if (!answer) {
+        failed.push_back(from);
+        continue;
+      }
+      if (answer->final_) {
+        // whatever is still out is closed unanswered with the set
+        lookup_stragglers_.fetch_add(requests.InFlight(),
+                                     std::memory_order_relaxed);
+        return answer->node_;
+      }
+      // only candidates that close in on node_id, the walk never goes
+      // backwards whatever a hop answers
+      auto closer = [&](const NodeInfo& node) {
+        return InRangeExclusive(node.id_, from.id_, node_id);
+      };
+      if (closer(answer->node_)) {
+        offer(answer->node_);
+      }
+      for (const auto& node : answer->more_) {
+        if (closer(node)) {
+          offer(node);
+        }
+      }
     }
   }
-}
 
-bool Node::IsAlive(const NodeAddress& address) {
-  return TcpClient::Ping(address);
+  hop = failed.empty() ? first.node_ : failed.front();
+  return std::nullopt;
 }
 
-void Node::StabilisationLoop() {
-  while (running_) {
-    std::this_thread::sleep_for(
-      std::chrono::milliseconds(Config::stabilise_interval)
-    );
-
-    if (running_) {
-      Stabilise();
+std::vector<std::optional<NodeInfo>> Node::ConcurrentLookups(
+    const std::vector<NodeID>& ids) {
+  std::vector<std::optional<NodeInfo>> owners(ids.size());
+  // the hop each walk is waiting on, a request's tag is its walk's index
+  std::vector<NodeInfo> at(ids.size());
+  std::vector<size_t> hops(ids.size(), 0);
+  std::vector<bool> broken(ids.size(), false);
+  RequestSet requests;
+
+  auto ask = [&](size_t k, const NodeInfo& hop) {
+    at[k] = hop;
+    if (++hops[k] > static_cast<size_t>(kMaxLookupHops) ||
+        !requests.Start(k, hop.address_, TcpClient::EncodeNextHop(ids[k], 0),
+                        kParallelHopTimeout)) {
+      broken[k] = true;
+    }
+  };
+  for (size_t k{}; k < ids.size(); ++k) {
+    auto hop = NextHop(ids[k]);
+    if (!hop) {
+      broken[k] = true;
+    }
+    else if (hop->final_) {
+      owners[k] = hop->node_;
+    }
+    else {
+      ask(k, hop->node_);
     }
   }
-}
 
-void Node::FixFingersLoop() {
-  while (running_) {
-    std::this_thread::sleep_for(
-      std::chrono::milliseconds(Config::fix_fingers_interval)
-    );
+  while (requests.InFlight() > 0) {
+    for (auto& done : requests.Poll(kParallelHopTimeout)) {
+      size_t k = done.tag_;
+      auto answer = done.response_
+          ? TcpClient::DecodeNextHop(std::move(*done.response_))
+          : std::nullopt;
+      if (!answer) {
+        broken[k] = true;
+      }
+      else if (answer->final_) {
+        owners[k] = answer->node_;
+      }
+      else if (!InRangeExclusive(answer->node_.id_, at[k].id_, ids[k])) {
+        // a hop that does not close in on the id is not to be followed
+        broken[k] = true;
+      }
+      else {
+        ask(k, answer->node_);
+      }
+    }
+  }
 
-    if (running_) {
-      FixFingers();
+  for (size_t k{}; k < ids.size(); ++k) {
+    if (broken[k]) {
+      // the usual lookup, which routes around a dead hop
+      owners[k] = FindSuccessor(ids[k]);
+      continue;
     }
+    lookups_.fetch_add(1, std::memory_order_relaxed);
+    lookup_hops_.fetch_add(hops[k], std::memory_order_relaxed);
   }
+  return owners;
 }
 
-void Node::CheckPredecessorLoop() {
-  while (running_) {
-    std::this_thread::sleep_for(
-      std::chrono::milliseconds(Config::check_predecessor_interval)
-    );
+std::optional<NodeInfo> Node::IterativeLookup(NodeID node_id, NodeInfo& hop,
+                                              size_t& hops) {
+  std::optional<NodeInfo> previous;
+  for (int step{}; step < kMaxLookupHops; ++step) {
+    ++hops;
+    auto answer = TcpClient::NextHop(hop.address_, node_id);
+    if (!answer) {
+      // the node that pointed us here is the one holding the stale entry.
+      // handing it the rest of the lookup makes it route around the dead
+      // hop and drop it from its own tables on the way
+      if (previous && !IsAlive(hop.address_)) {
+        lookup_retries_.fetch_add(1, std::memory_order_relaxed);
+        hop = *previous;
+        ++hops;
+        return TcpClient::FindSuccessor(hop.address_, node_id);
+      }
+      return std::nullopt;
+    }
 
-    if (running_) {
-      CheckPredecessor();
+    if (answer->final_) {
+      return answer->node_;
+    }
+    // every step has to close in on node_id, anything else is a loop
+    if (!InRangeExclusive(answer->node_.id_, hop.id_, node_id)) {
+      return std::nullopt;
     }
+    previous = hop;
+    hop = answer->node_;
+  }
+  return std::nullopt;
+}
+
+std::optional<NodeInfo> Node::ClosestPrecedingNode(const RingView& view,
+                                                   NodeID node_id) {
+  auto closest = finger_table_->ClosestPrecedingNode(node_id);
+
+  // the successor list covers the arc right after us, which is where
+  // fingers are thinnest and where dead ones were just cleared
+  for (const auto& entry : view.successor_list_) {
+    if (InRangeExclusive(entry.id_, closest ? closest->id_ : id_, node_id)) {
+      closest = entry;
+    }
+  }
+  if (closest) {
+    return closest;
+  }
+
+  if (view.successor_ && InRangeExclusive(view.successor_->id_, id_, node_id)) {
+    return view.successor_;
+  }
+
+  return std::nullopt;
+}
+
+void Node::Notify(const NodeInfo& node) {
+  if (!security_policy_.AllowNode(node)) {
+    return;
+  }
+
+  if (membership_) {
+    membership_->Add(node, true);
+  }
+
+  RingUpdate update(*this);
+  if (!predecessor_ || predecessor_->id_ != node.id_) {
+    TopologyChanged();
+  }
+
+  if (!predecessor_ || InRangeExclusive(node.id_, predecessor_->id_, id_)) {
+    if (predecessor_ && security_policy_.PreferOver(*predecessor_, node)) {
+      return;
+    }
+    std::cerr << "Update predecessor to " << node.id_ << " at " << node.address_.ToString() << "\n";
+    predecessor_ = node;
+  }
+}
+
+std::optional<NodeInfo> Node::GetPredecessor() const {
+  util::EpochGuard guard;
+  return View().predecessor_;
+}
+
+std::optional<NodeInfo> Node::GetSuccessor() const {
+  util::EpochGuard guard;
+  return View().successor_;
+}
+
+std::vector<NodeInfo> Node::SuccessorList() const {
+  util::EpochGuard guard;
+  return View().successor_list_;
+}
+
+bool Node::Put(std::string_view key, std::string value,
+               std::chrono::milliseconds ttl) {
+  return PutEncoded(key, codec_->Encode(std::move(value)), ttl);
+}
+
+bool Node::PutEncoded(std::string_view key, EncodedValue value,
+                      std::chrono::milliseconds ttl) {
+  KeyID key_id = hsh::Hash::HashKey(key);
+  if (config_.replication_factor > 1) {
+    return QuorumPut(key, key_id, std::move(value), ttl);
+  }
+  if (auto guess = GuessOwner(key_id)) {
+    if (auto stored = TcpClient::PutOwned(guess->address_, key, value, ttl)) {
+      return *stored;
+    }
+    OwnerGuessFailed(*guess);
+  }
+  auto owner = OwnerOf(key_id);
+  if (!owner) return false;
+  if (IsLocal(*owner)) return storage_->PutEncoded(key, std::move(value), ttl);
+  return TcpClient::Put(owner->address_, key, std::move(value), ttl);
+}
+
+
+std::optional<std::string> Node::Get(std::string_view key) {
+  return codec_->Decode(GetShared(key));
+}
+
+ValueSlice Node::GetShared(std::string_view key) {
+  KeyID key_id = hsh::Hash::HashKey(key);
+  if (config_.replication_factor > 1) {
+    return QuorumGet(key, key_id);
+  }
+  std::optional<EncodedValue> value;
+  auto guess = GuessOwner(key_id);
+  if (guess) {
+    auto owned = TcpClient::GetOwned(guess->address_, key);
+    if (!owned) {
+      OwnerGuessFailed(*guess);
+      guess.reset();
+    }
+    else {
+      value = std::move(*owned);
+    }
+  }
+  if (!guess) {
+    auto owner = OwnerOf(key_id);
+    if (!owner) return {};
+    if (IsLocal(*owner)) return LocalGetShared(key);
+    value = TcpClient::Get(owner->address_, key);
+  }
+  if (!value) return {};
+  return ValueSlice{std::make_shared<const std::string>(std::move(value->bytes_)),
+                    value->compressed_};
+}
+
+
+bool Node::Remove(std::string_view key) {
+  KeyID key_id = hsh::Hash::HashKey(key);
+  if (config_.replication_factor > 1) {
+    return QuorumRemove(key, key_id);
+  }
+  if (auto guess = GuessOwner(key_id)) {
+    if (auto removed = TcpClient::DeleteOwned(guess->address_, key)) {
+      return *removed;
+    }
+    OwnerGuessFailed(*guess);
+  }
+  auto owner = OwnerOf(key_id);
+  if (!owner) return false;
+  if (IsLocal(*owner)) return LocalRemove(key);
+  return TcpClient::Delete(owner->address_, key);
+}
+
+bool Node::Owns(std::string_view key) const {
+  return OwnsId(hsh::Hash::HashKey(key));
+}
+
+bool Node::OwnsId(KeyID key_id) const {
+  util::EpochGuard guard;
+  const RingView& view = View();
+  if (view.InAdoptedRange(key_id)) {
+    return true;
+  }
+  return !view.predecessor_ ||
+         (InRangeExclusiveInclusive(key_id, view.predecessor_->id_, id_) &&
+          !view.InDelegatedRange(key_id));
+}
+
+bool Node::InHandedRange(const std::optional<Delegation>& range,
+                         const std::optional<NodeInfo>& neighbour,
+                         KeyID key_id) {
+  return range && neighbour && neighbour->id_ == range->peer_.id_ &&
+         InRangeExclusiveInclusive(key_id, range->start_, range->end_);
+}
+
+bool Node::InAdoptedRange(KeyID key_id) const {
+  return InHandedRange(adopted_, successor_, key_id);
+}
+
+bool Node::InDelegatedRange(KeyID key_id) const {
+  return InHandedRange(delegated_, predecessor_, key_id);
+}
+
+void Node::PublishRingView() {
+  util::Epoch::Retire(ring_view_.exchange(new RingView{
+    .predecessor_ = predecessor_,
+    .successor_ = successor_,
+    .successor_list_ = successor_list_,
+    .delegated_ = delegated_,
+    .adopted_ = adopted_,
+    .handoff_ = handoff_,
+    .handed_ = handed_,
+  }, std::memory_order_acq_rel));
+}
+
+bool Node::LocalPut(std::string_view key, std::string value,
+                    std::chrono::milliseconds ttl) {
+  return storage_->Put(key, std::move(value), ttl);
+}
+
+std::optional<std::string> Node::LocalGet(std::string_view key) const {
+  return storage_->Get(key);
+}
+
+ValueSlice Node::LocalGetShared(std::string_view key, bool forward) const {
+  auto value = storage_->GetShared(key);
+  if (value || !forward) {
+    return value;
+  }
+  auto peer = HandoffPeerOf(hsh::Hash::HashKey(key));
+  if (!peer) {
+    return value;
+  }
+  handoff_forwards_.fetch_add(1, std::memory_order_relaxed);
+  auto there = TcpClient::GetReplica(peer->address_, key, true);
+  if (!there || !*there) {
+    return value;
+  }
+  return ValueSlice{std::make_shared<const std::string>(std::move((*there)->bytes_)),
+                    (*there)->compressed_};
+}
+
+bool Node::LocalRemove(std::string_view key, bool forward) {
+  bool removed = storage_->Remove(key);
+  if (!forward) {
+    return removed;
+  }
+  // or the next batch from the donor would bring it back
+  if (auto peer = HandoffPeerOf(hsh::Hash::HashKey(key))) {
+    handoff_forwards_.fetch_add(1, std::memory_order_relaxed);
+    auto there = TcpClient::DeleteReplica(peer->address_, key, true);
+    removed = removed || (there && *there);
+  }
+  return removed;
+}
+
+bool Node::StoreReplica(std::string_view key, EncodedValue value,
+                        std::chrono::milliseconds ttl) {
+  return storage_->PutEncoded(key, std::move(value), ttl);
+}
+
+std::optional<NodeInfo> Node::GuessOwner(KeyID key_id) {
+  if (LocalOwnerOf(key_id)) {
+    return std::nullopt;
+  }
+  if (membership_) {
+    auto owner = membership_->SuccessorOf(key_id);
+    if (owner && owner->id_ != id_) {
+      one_hop_sent_.fetch_add(1, std::memory_order_relaxed);
+      return owner;
+    }
+  }
+  if (auto hit = location_cache_.Find(key_id)) {
+    return hit->owner_;
+  }
+  return std::nullopt;
+}
+
+void Node::OwnerGuessFailed(const NodeInfo& owner) {
+  location_cache_.Invalidate(owner.id_);
+  if (membership_) {
+    one_hop_refused_.fetch_add(1, std::memory_order_relaxed);
+    // a live node that refused is only missing a newer neighbour, which the
+    // lookup that follows will find
+    if (!IsAlive(owner.address_)) {
+      HandleDeadPeer(owner);
+    }
+  }
+}
+
+Node* Node::LocalOwnerOf(KeyID key_id) {
+  Node& host = host_ ? *host_ : *this;
+  if (host.OwnsId(key_id)) {
+    return &host;
+  }
+  for (const auto& vnode : host.vnodes_) {
+    if (vnode->OwnsId(key_id)) {
+      return vnode.get();
+    }
+  }
+  return nullptr;
+}
+
+std::optional<NodeInfo> Node::DelegateOf(KeyID key_id) {
+  Node& host = host_ ? *host_ : *this;
+  auto delegate = [key_id](const Node& node) -> std::optional<NodeInfo> {
+    util::EpochGuard guard;
+    const RingView& view = node.View();
+    if (view.InDelegatedRange(key_id)) {
+      return view.delegated_->peer_;
+    }
+    return std::nullopt;
+  };
+  if (auto peer = delegate(host)) {
+    return peer;
+  }
+  for (const auto& vnode : host.vnodes_) {
+    if (auto peer = delegate(*vnode)) {
+      return peer;
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<NodeInfo> Node::OwnerOf(KeyID key_id) {
+  if (Node* local = LocalOwnerOf(key_id)) {
+    if (config_.rebalance) {
+      local->load_.Record(key_id);
+    }
+    return local->Info();
+  }
+  // a lookup could still end at the virtual node that gave the key away
+  if (auto delegate = DelegateOf(key_id)) {
+    return delegate;
+  }
+  size_t hops = 0;
+  auto owner = FindSuccessor(key_id, true, hops);   // true = call ValidateLookup
+  if (owner && owner->id_ != id_) {
+    location_cache_.Insert(key_id, *owner, static_cast<u32>(hops));
+    if (membership_) {
+      membership_->Add(*owner);
+    }
+  }
+  return owner;
+}
+
+std::optional<MembershipDelta> Node::MembershipSince(u64 cursor) const {
+  if (!membership_) {
+    return std::nullopt;
+  }
+  return membership_->Since(cursor);
+}
+
+void Node::PullMembership(const NodeInfo& peer) {
+  if (peer.id_ == id_) {
+    return;
+  }
+  auto& cursor = membership_cursors_[peer.id_];
+  auto delta = TcpClient::PullMembership(peer.address_, cursor);
+  if (!delta) {
+    return;
+  }
+  membership_->Apply(*delta);
+  cursor = delta->cursor_;
+}
+
+std::vector<NodeInfo> Node::ReplicasFor(KeyID key_id) {
+  auto owner = OwnerOf(key_id);
+  if (!owner) {
+    return {};
+  }
+
+  std::vector<NodeInfo> replicas{*owner};
+  auto following = owner->id_ == id_
+      ? SuccessorList()
+      : TcpClient::GetSuccessorList(owner->address_).value_or(
+            std::vector<NodeInfo>{});
+  for (const auto& node : following) {
+    // a ring smaller than the replication factor wraps back to the owner
+    if (replicas.size() >= static_cast<size_t>(config_.replication_factor) ||
+        node.id_ == owner->id_) {
+      break;
+    }
+    // copies on two virtual nodes of one process are one copy
+    if (std::ranges::none_of(replicas, [&node](const NodeInfo& replica) {
+          return replica.address_.SameHost(node.address_);
+        })) {
+      replicas.push_back(node);
+    }
+  }
+  return replicas;
+}
+
+size_t Node::FanOut(const std::vector<NodeInfo>& replicas, size_t needed,
+                    std::function<bool(const NodeInfo&)> op) {
+  struct State {
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t succeeded{0};
+    size_t answered{0};
+  };
+  auto state = std::make_shared<State>();
+  auto shared_op =
+      std::make_shared<std::function<bool(const NodeInfo&)>>(std::move(op));
+  auto record = [state](bool ok) {
+    {
+      std::lock_guard lock(state->mutex);
+      state->succeeded += ok ? 1 : 0;
+      ++state->answered;
+    }
+    state->cv.notify_all();
+  };
+
+  const NodeInfo* local = nullptr;
+  for (const auto& replica : replicas) {
+    if (IsLocal(replica)) {
+      local = &replica;
+      continue;
+    }
+    (host_ ? host_ : this)->replica_pool_->Submit([shared_op, replica, record] {
+      record((*shared_op)(replica));
+    });
+  }
+  if (local) {
+    record((*shared_op)(*local));
+  }
+
+  std::unique_lock lock(state->mutex);
+  state->cv.wait(lock, [&] {
+    return state->succeeded >= needed || state->answered == replicas.size();
+  });
+  return state->succeeded;
+}
+
+bool Node::QuorumPut(std::string_view key, KeyID key_id, EncodedValue value,
+                     std::chrono::milliseconds ttl) {
+  auto start = std::chrono::steady_clock::now();
+  quorum_writes_.fetch_add(1, std::memory_order_relaxed);
+
+  auto replicas = ReplicasFor(key_id);
+  // a ring smaller than the replication factor has fewer copies to offer
+  size_t needed = std::min<size_t>(config_.write_quorum, replicas.size());
+  size_t acks = 0;
+  if (!replicas.empty()) {
+    auto shared = std::make_shared<const EncodedValue>(std::move(value));
+    acks = FanOut(replicas, needed,
+                  [this, key = std::string{key}, shared, ttl](const NodeInfo& replica) {
+                    if (IsLocal(replica)) {
+                      return storage_->PutEncoded(key, *shared, ttl);
+                    }
+                    return TcpClient::PutReplica(replica.address_, key,
+                                                 *shared, ttl);
+                  });
+  }
+
+  write_us_.fetch_add(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start).count(),
+      std::memory_order_relaxed);
+  if (replicas.empty() || acks < needed) {
+    write_quorum_failed_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+ValueSlice Node::QuorumGet(std::string_view key, KeyID key_id) {
+  auto start = std::chrono::steady_clock::now();
+  quorum_reads_.fetch_add(1, std::memory_order_relaxed);
+
+  auto replicas = ReplicasFor(key_id);
+  size_t needed = std::min<size_t>(config_.read_quorum, replicas.size());
+
+  // the local copy is free, the rest start at a random replica so a hot
+  // key's reads spread over all of its copies
+  if (replicas.size() > 1) {
+    thread_local std::mt19937 rng{std::random_device{}()};
+    std::rotate(replicas.begin(),
+                replicas.begin() + static_cast<long>(rng() % replicas.size()),
+                replicas.end());
+    auto self = std::ranges::find_if(replicas, [this](const NodeInfo& replica) {
+      return IsLocal(replica);
+    });
+    if (self != replicas.end()) {
+      std::iter_swap(replicas.begin(), self);
+    }
+  }
+
+  // answers are tallied by value and the first value to collect needed
+  // votes wins. a replica that just joined the set has nothing yet, so a
+  // missing key only counts once every replica has been asked
+  struct Votes {
+    std::mutex mutex;
+    std::vector<std::pair<ValueSlice, size_t>> tally;
+    std::optional<ValueSlice> winner;
+  };
+  auto votes = std::make_shared<Votes>();
+  auto same = [](const ValueSlice& a, const ValueSlice& b) {
+    if (!a || !b) {
+      return !a && !b;
+    }
+    return a.compressed_ == b.compressed_ && a.view_ == b.view_;
+  };
+  auto op = [this, key = std::string{key}, votes, needed,
+             same](const NodeInfo& replica) {
+    ValueSlice answer;
+    if (IsLocal(replica)) {
+      answer = storage_->GetShared(key);
+    }
+    else {
+      auto remote = TcpClient::GetReplica(replica.address_, key);
+      if (!remote) {
+        // unreachable replicas get no vote
+        return false;
+      }
+      if (*remote) {
+        answer = ValueSlice{
+            std::make_shared<const std::string>(std::move((*remote)->bytes_)),
+            (*remote)->compressed_};
+      }
+    }
+
+    std::lock_guard lock(votes->mutex);
+    if (votes->winner) {
+      return true;
+    }
+    auto it = std::ranges::find_if(votes->tally, [&](const auto& entry) {
+      return same(entry.first, answer);
+    });
+    if (it == votes->tally.end()) {
+      votes->tally.emplace_back(std::move(answer), 0);
+      it = std::prev(votes->tally.end());
+    }
+    if (++it->second >= needed && it->first) {
+      votes->winner = it->first;
+    }
+    return votes->winner.has_value();
+  };
+
+  // ask just enough replicas for a quorum, and the rest only if they
+  // disagree or do not answer
+  if (!replicas.empty()) {
+    std::vector<NodeInfo> first(replicas.begin(), replicas.begin() + needed);
+    bool decided = FanOut(first, 1, op) > 0;
+    if (!decided && replicas.size() > needed) {
+      read_second_waves_.fetch_add(1, std::memory_order_relaxed);
+      std::vector<NodeInfo> rest(replicas.begin() + needed, replicas.end());
+      FanOut(rest, 1, op);
+    }
+  }
+
+  read_us_.fetch_add(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start).count(),
+      std::memory_order_relaxed);
+
+  std::lock_guard lock(votes->mutex);
+  if (votes->winner) {
+    return *votes->winner;
+  }
+  auto missing = std::ranges::find_if(votes->tally, [](const auto& entry) {
+    return !entry.first;
+  });
+  if (missing == votes->tally.end() || missing->second < needed) {
+    read_quorum_failed_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return {};
+}
+
+bool Node::QuorumRemove(std::string_view key, KeyID key_id) {
+  auto replicas = ReplicasFor(key_id);
+  if (replicas.empty()) {
+    return false;
+  }
+  size_t needed = std::min<size_t>(config_.write_quorum, replicas.size());
+
+  auto removed = std::make_shared<std::atomic<bool>>(false);
+  size_t acks = FanOut(replicas, needed,
+                       [this, key = std::string{key}, removed](const NodeInfo& replica) {
+                         if (IsLocal(replica)) {
+                           if (storage_->Remove(key)) {
+                             removed->store(true);
+                           }
+                           return true;
+                         }
+                         auto result = TcpClient::DeleteReplica(replica.address_, key);
+                         if (!result) {
+                           return false;
+                         }
+                         if (*result) {
+                           removed->store(true);
+                         }
+                         return true;
+                       });
+  return acks >= needed && removed->load();
+}
+
+void Node::MaintainReplicas() {
+  if (config_.replication_factor <= 1) {
+    return;
+  }
+
+  std::optional<NodeInfo> predecessor;
+  std::vector<NodeInfo> targets;
+  {
+    std::lock_guard lock(ring_mutex_);
+    predecessor = predecessor_;
+    for (const auto& node : successor_list_) {
+      if (targets.size() + 1 >= static_cast<size_t>(config_.replication_factor)) {
+        break;
+      }
+      if (!IsLocal(node) &&
+          std::ranges::none_of(targets, [&node](const NodeInfo& target) {
+            return target.address_.SameHost(node.address_);
+          })) {
+        targets.push_back(node);
+      }
+    }
+  }
+  if (!predecessor) {
+    return;
+  }
+
+  bool refresh = ++replica_rounds_ % kReplicaRefreshRounds == 0;
+  std::vector<NodeID> pushed;
+  for (const auto& target : targets) {
+    bool current = replicated_from_ == predecessor->id_ &&
+                   std::ranges::find(replicated_to_, target.id_) !=
+                       replicated_to_.end();
+    if (current && !refresh) {
+      pushed.push_back(target.id_);
+      continue;
+    }
+    replica_syncs_.fetch_add(1, std::memory_order_relaxed);
+    if (TcpClient::Replicate(target.address_, predecessor->id_, id_, Info())) {
+      pushed.push_back(target.id_);
+    }
+    else {
+      replica_sync_failed_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  replicated_from_ = predecessor->id_;
+  replicated_to_ = std::move(pushed);
+}
+
+std::vector<std::pair<std::string, std::string>> Node::GetKeysInRange(
+    NodeID start, NodeID end) {
+  return storage_->ExportRange(start, end);
+}
+
+std::vector<std::pair<std::string, std::string>> Node::HandOverRange(
+    const NodeInfo& mover, KeyID start, KeyID end, u32 limit) {
+  auto same = [&mover](const std::optional<NodeInfo>& neighbour) {
+    return neighbour && neighbour->id_ == mover.id_ &&
+           neighbour->address_ == mover.address_;
+  };
+  {
+    RingUpdate update(*this);
+    if (leaving_.load(std::memory_order_acquire)) {
+      // our own arc, to the heir
+      if (!same(successor_) || end != id_) {
+        return {};
+      }
+    }
+    else {
+      // the arc up to a new predecessor's id, without ours. with replicas
+      // the joiner copies its arc instead, and a move could take copies we
+      // hold for others
+      if (!same(predecessor_) || end != mover.id_ ||
+          InRangeExclusiveInclusive(id_, start, end) ||
+          config_.replication_factor > 1) {
+        return {};
+      }
+      handed_ = Delegation{.start_ = start, .end_ = end, .peer_ = mover};
+    }
+  }
+  auto moved = storage_->ExtractRange(start, end, limit);
+  keys_handed_over_.fetch_add(moved.size(), std::memory_order_relaxed);
+  return moved;
+}
+
+Result<std::vector<u64>> Node::MerkleHashes(
+    u8 level, const std::vector<u32>& indices) const {
+  if (level > MerkleTree::kDepth) {
+    return std::unexpected("merkle level out of range");
+  }
+  std::vector<u64> hashes;
+  hashes.reserve(indices.size());
+  for (u32 index : indices) {
+    if (index >= (u64{1} << level)) {
+      return std::unexpected("merkle index out of range");
+    }
+    hashes.push_back(storage_->MerkleHash(level, index));
+  }
+  return hashes;
+}
+
+std::optional<size_t> Node::SyncRange(const NodeAddress& peer, KeyID start,
+                                      KeyID end) {
+  // does the tree node cover any id in (start, end]
+  auto overlaps = [start, end](int level, u32 index) {
+    KeyID first = MerkleTree::First(level, index);
+    KeyID last = MerkleTree::Last(level, index);
+    return InRangeExclusiveInclusive(first, start, end) ||
+           InRangeExclusiveInclusive(last, start, end) ||
+           (first <= end && end <= last);
+  };
+
+  sync_runs_.fetch_add(1, std::memory_order_relaxed);
+
+  std::vector<u32> frontier{0};
+  std::vector<u32> leaves;
+  for (int level = 0; level <= MerkleTree::kDepth && !frontier.empty();
+       ++level) {
+    auto remote = TcpClient::MerkleHashes(peer, static_cast<u8>(level),
+                                          frontier);
+    if (!remote) {
+      return std::nullopt;
+    }
+    sync_digests_.fetch_add(frontier.size(), std::memory_order_relaxed);
+
+    std::vector<u32> next;
+    for (size_t i{}; i < frontier.size(); ++i) {
+      if ((*remote)[i] == storage_->MerkleHash(level, frontier[i])) {
+        continue;
+      }
+      if (level == MerkleTree::kDepth) {
+        leaves.push_back(frontier[i]);
+        continue;
+      }
+      for (u32 child : {frontier[i] * 2, frontier[i] * 2 + 1}) {
+        if (overlaps(level + 1, child)) {
+          next.push_back(child);
+        }
+      }
+    }
+    frontier = std::move(next);
+  }
+  sync_leaves_.fetch_add(leaves.size(), std::memory_order_relaxed);
+
+  // fetch runs of neighbouring leaves in one transfer each
+  size_t pulled = 0;
+  for (size_t i{}; i < leaves.size();) {
+    size_t j = i;
+    while (j + 1 < leaves.size() && leaves[j + 1] == leaves[j] + 1) {
+      ++j;
+    }
+    KeyID first = MerkleTree::First(MerkleTree::kDepth, leaves[i]);
+    KeyID last = MerkleTree::Last(MerkleTree::kDepth, leaves[j]);
+    i = j + 1;
+
+    auto records = TcpClient::TransferKeys(peer, first - 1, last);
+    if (!records) {
+      return std::nullopt;
+    }
+    std::erase_if(*records, [start, end](const auto& record) {
+      return !InRangeExclusiveInclusive(Hash::HashKey(record.first), start,
+                                        end);
+    });
+    pulled += records->size();
+    storage_->ImportAll(std::move(*records));
+  }
+
+  sync_records_.fetch_add(pulled, std::memory_order_relaxed);
+  return pulled;
+}
+
+void Node::Stabilise() {
+  std::optional<NodeInfo> successor_copy;
+  {
+    std::lock_guard lock(ring_mutex_);
+    successor_copy = successor_;
+  }
+
+  if (!successor_copy) {
+    return;
+  }
+
+  if (successor_copy->id_ != id_) {
+    // doubles as the liveness check. a successor that does not answer is
+    // replaced from the list now rather than after the ring heals around it
+    auto theirs = TcpClient::GetSuccessorList(successor_copy->address_);
+    if (theirs) {
+      UpdateSuccessorList(*successor_copy, *theirs);
+      if (membership_) {
+        membership_->Add(*successor_copy, true);
+        for (const auto& entry : *theirs) {
+          membership_->Add(entry);
+        }
+      }
+    }
+    else {
+      HandleDeadPeer(*successor_copy);
+      std::lock_guard lock(ring_mutex_);
+      successor_copy = successor_;
+    }
+  }
+
+  auto predecessor = TcpClient::GetPredecessor(successor_copy->address_);
+
+  if (predecessor) {
+    if (!security_policy_.AllowNode(*predecessor)) {
+      // just do nothing
+    }
+    else {
+      RingUpdate update(*this);
+
+      if (InRangeExclusive(predecessor->id_, id_, successor_->id_)) {
+        std::cerr << "Stabilise: updating successor from " << successor_->id_
+          << " to " << predecessor->id_ << "\n";
+        TopologyChanged();
+        successor_ = predecessor;
+        finger_table_->Set(0, *predecessor);
+        // the old list still holds, one further along
+        successor_list_.insert(successor_list_.begin(), *predecessor);
+        if (successor_list_.size() > Config::successor_list_size) {
+          successor_list_.resize(Config::successor_list_size);
+        }
+      }
+    }
+  }
+
+  {
+    std::lock_guard lock(ring_mutex_);
+    successor_copy = successor_;
+  }
+
+  if (successor_copy && successor_copy->id_ != id_) {
+    TcpClient::Notify(successor_copy->address_, Info());
+  }
+
+  if (membership_ && successor_copy) {
+    PullMembership(*successor_copy);
+    // plus one other finger a round, so news spreads in O(log n) rounds
+    // rather than the n it takes going from successor to successor
+    for (int i{}; i < FingerTable::kSize; ++i) {
+      membership_finger_ = (membership_finger_ + 1) % FingerTable::kSize;
+      auto finger = finger_table_->Get(membership_finger_);
+      if (finger && finger->id_ != id_ && finger->id_ != successor_copy->id_) {
+        PullMembership(*finger);
+        break;
+      }
+    }
+  }
+
+  StartTransfers();
+
+  security_policy_.Tick();
+}
+
+void Node::StartTransfers() {
+  Node& host = host_ ? *host_ : *this;
+  if (!host.transfer_pool_ ||
+      transfers_running_.exchange(true, std::memory_order_acq_rel)) {
+    return;
+  }
+  host.transfer_pool_->Submit([this, &host] {
+    if (host.running_) {
+      u64 sent = TcpClient::RequestsSent();
+      MaintainReplicas();
+      if (config_.rebalance && config_.replication_factor == 1) {
+        Rebalance();
+      }
+      CountMaintenanceRpcs(TcpClient::RequestsSent() - sent);
+    }
+    transfers_running_.store(false, std::memory_order_release);
+  });
+}
+
+LoadSummary Node::PeerLoad(const NodeInfo& sender, const LoadSummary& load) {
+  std::lock_guard lock(ring_mutex_);
+  if (predecessor_ && predecessor_->id_ == sender.id_) {
+    predecessor_load_ = {sender.id_, load};
+  }
+  return load_summary_;
+}
+
+std::optional<size_t> Node::AdoptRange(const NodeInfo& source, KeyID start,
+                                       KeyID end) {
+  std::optional<Delegation> adopted;
+  std::optional<Delegation> delegated;
+  {
+    RingUpdate update(*this);
+    if (!config_.rebalance) {
+      return std::nullopt;
+    }
+    adopted = adopted_;
+    delegated = delegated_;
+    if (successor_ && successor_->id_ == source.id_ && start == id_) {
+      // the bottom of our successor's arc
+      adopted_ = Delegation{.start_ = start, .end_ = end, .peer_ = source};
+    }
+    else if (predecessor_ && predecessor_->id_ == source.id_ &&
+             InDelegatedRange(end) && end == delegated_->end_ &&
+             (start == delegated_->start_ || InDelegatedRange(start))) {
+      // the top of what we gave our predecessor, coming back
+      if (start == delegated_->start_) {
+        delegated_.reset();
+      }
+      else {
+        delegated_->end_ = start;
+      }
+    }
+    else {
+      return std::nullopt;
+    }
+  }
+
+  // source stopped answering for the range before asking, so what it holds
+  // is the latest. most of it came over in an earlier pull already
+  auto pulled = SyncRange(source.address_, start, end);
+  if (!pulled) {
+    RingUpdate update(*this);
+    adopted_ = adopted;
+    delegated_ = delegated;
+    return std::nullopt;
+  }
+  adoptions_.fetch_add(1, std::memory_order_relaxed);
+  // who answers for what moved, the next round may have more to move
+  TopologyChanged();
+  std::cerr << "Rebalance: answering for (" << start << ", " << end
+    << "] from " << source.id_ << "\n";
+  return pulled;
+}
+
+void Node::Rebalance() {
+  std::optional<NodeInfo> successor;
+  std::optional<NodeInfo> predecessor;
+  std::optional<Delegation> delegated;
+  {
+    RingUpdate update(*this);
+    successor = successor_;
+    predecessor = predecessor_;
+    // our successor changed, so whoever is there now decides who answers
+    if (adopted_ && (!successor_ || successor_->id_ != adopted_->peer_.id_)) {
+      adopted_.reset();
+    }
+    delegated = delegated_;
+  }
+
+  // the node we gave a range to is no longer our predecessor, so the range
+  // is ours again and so are its keys
+  if (delegated && (!predecessor || predecessor->id_ != delegated->peer_.id_)) {
+    SyncRange(delegated->peer_.address_, delegated->start_, delegated->end_);
+    RingUpdate update(*this);
+    delegated_.reset();
+    reclaims_.fetch_add(1, std::memory_order_relaxed);
+    TopologyChanged();
+  }
+
+  LoadSummary ours = MeasureLoad();
+  {
+    std::lock_guard lock(ring_mutex_);
+    load_summary_ = ours;
+  }
+  std::optional<LoadSummary> successor_load;
+  if (successor && successor->id_ != id_) {
+    successor_load =
+        TcpClient::ExchangeLoad(successor->address_, Info(), ours);
+  }
+
+  if (shed_cooldown_ > 0) {
+    --shed_cooldown_;
+    return;
+  }
+  if (ours.keys_ < kMinShedLoad && ours.requests_ < kMinShedLoad) {
+    return;
+  }
+  std::optional<LoadSummary> predecessor_load;
+  {
+    std::lock_guard lock(ring_mutex_);
+    if (predecessor_load_ && predecessor_ &&
+        predecessor_load_->first == predecessor_->id_) {
+      predecessor_load = predecessor_load_->second;
+    }
+  }
+
+  // shedding to our own virtual node would not move anything off this host
+  if ((predecessor && predecessor_load && !IsLocal(*predecessor) &&
+       ShedToPredecessor(ours, *predecessor, *predecessor_load)) ||
+      (successor && successor_load &&
+       ReturnToSuccessor(ours, *successor, *successor_load))) {
+    shed_cooldown_ = kShedCooldown;
+  }
+}
+
+std::optional<std::pair<double, bool>> Node::Imbalance(
+    const LoadSummary& ours, const LoadSummary& theirs) {
+  // whichever of keys and requests is further out of balance decides. a
+  // blend of the two would happily move every hot key to even out storage
+  auto share_of = [](u64 mine, u64 other) {
+    return mine + other == 0 ? 0.0
+        : static_cast<double>(mine) / static_cast<double>(mine + other);
+  };
+  double key_share = share_of(ours.keys_, theirs.keys_);
+  double request_share = share_of(ours.requests_, theirs.requests_);
+  double share = std::max(key_share, request_share);
+  if (share < kShedShare) {
+    return std::nullopt;
+  }
+  // moving this much of ours leaves the two of us even
+  return std::pair{(share - 0.5) / share, request_share > key_share};
+}
+
+bool Node::ShedToPredecessor(const LoadSummary& ours,
+                             const NodeInfo& predecessor,
+                             const LoadSummary& theirs) {
+  auto imbalance = Imbalance(ours, theirs);
+  if (!imbalance) {
+    return false;
+  }
+
+  KeyID start = predecessor.id_;
+  KeyID end = id_;
+  {
+    std::lock_guard lock(ring_mutex_);
+    if (delegated_ && delegated_->peer_.id_ == predecessor.id_) {
+      start = delegated_->end_;
+    }
+    if (adopted_ && InAdoptedRange(adopted_->end_)) {
+      end = adopted_->end_;
+    }
+  }
+  // everything we answer for counts towards the load, but only our own arc
+  // can go to the predecessor, lowest first
+  auto points = LoadPoints(start, end, imbalance->second);
+  auto needed = static_cast<size_t>(
+      std::ceil(imbalance->first * static_cast<double>(points.size())));
+  if (needed == 0 || needed > points.size() ||
+      !InRangeExclusiveInclusive(points[needed - 1], start, id_)) {
+    // the load is in what we adopted, past us
+    return false;
+  }
+  // our own id stays with us, whatever hashes to it
+  KeyID split = points[needed - 1] == id_ ? id_ - 1 : points[needed - 1];
+  if (split == start || !MoveKeepsBalance(ours, theirs, start, split)) {
+    return false;
+  }
+
+  // copied while the range is still ours, so the handover itself only has
+  // to move what changed in between
+  if (!TcpClient::Replicate(predecessor.address_, start, split, Info())) {
+    return true;
+  }
+  std::optional<Delegation> before;
+  {
+    RingUpdate update(*this);
+    if (!predecessor_ || predecessor_->id_ != predecessor.id_) {
+      return true;
+    }
+    before = delegated_;
+    delegated_ = Delegation{
+      .start_ = predecessor.id_,
+      .end_ = split,
+      .peer_ = predecessor,
+    };
+  }
+  if (!TcpClient::Replicate(predecessor.address_, predecessor.id_, split,
+                            Info(), true)) {
+    RingUpdate update(*this);
+    delegated_ = before;
+    return true;
+  }
+
+  auto moved = storage_->ExtractRange(start, split);
+  sheds_.fetch_add(1, std::memory_order_relaxed);
+  TopologyChanged();
+  keys_shed_.fetch_add(moved.size(), std::memory_order_relaxed);
+  std::cerr << "Rebalance: gave (" << start << ", " << split << "] to "
+    << predecessor.id_ << ", " << moved.size() << " keys\n";
+  return true;
+}
+
+bool Node::ReturnToSuccessor(const LoadSummary& ours,
+                             const NodeInfo& successor,
+                             const LoadSummary& theirs) {
+  std::optional<Delegation> adopted;
+  KeyID start = id_;
+  {
+    std::lock_guard lock(ring_mutex_);
+    if (!adopted_ || !InAdoptedRange(adopted_->end_) ||
+        adopted_->peer_.id_ != successor.id_) {
+      return false;
+    }
+    adopted = adopted_;
+    if (predecessor_) {
+      start = delegated_ && delegated_->peer_.id_ == predecessor_->id_
+          ? delegated_->end_ : predecessor_->id_;
+    }
+  }
+  auto imbalance = Imbalance(ours, theirs);
+  if (!imbalance) {
+    return false;
+  }
+
+  // only what we adopted can go back, highest first
+  auto points = LoadPoints(start, adopted->end_, imbalance->second);
+  auto needed = static_cast<size_t>(
+      std::ceil(imbalance->first * static_cast<double>(points.size())));
+  if (needed == 0 || needed > points.size()) {
+    return false;
+  }
+  KeyID split = id_;
+  if (needed < points.size() &&
+      InRangeExclusiveInclusive(points[points.size() - needed - 1], id_,
+                                adopted->end_)) {
+    split = points[points.size() - needed - 1];
+  }
+  if (split == adopted->end_ ||
+      !MoveKeepsBalance(ours, theirs, split, adopted->end_)) {
+    return false;
+  }
+
+  if (!TcpClient::Replicate(successor.address_, split, adopted->end_,
+                            Info())) {
+    return true;
+  }
+  {
+    RingUpdate update(*this);
+    if (!adopted_ || adopted_->end_ != adopted->end_) {
+      return true;
+    }
+    if (split == id_) {
+      adopted_.reset();
+    }
+    else {
+      adopted_->end_ = split;
+    }
+  }
+  if (!TcpClient::Replicate(successor.address_, split, adopted->end_, Info(),
+                            true)) {
+    RingUpdate update(*this);
+    adopted_ = adopted;
+    return true;
+  }
+
+  auto moved = storage_->ExtractRange(split, adopted->end_);
+  sheds_.fetch_add(1, std::memory_order_relaxed);
+  TopologyChanged();
+  keys_shed_.fetch_add(moved.size(), std::memory_order_relaxed);
+  std::cerr << "Rebalance: gave (" << split << ", " << adopted->end_
+    << "] back to " << successor.id_ << ", " << moved.size() << " keys\n";
+  return true;
+}
+
+bool Node::MoveKeepsBalance(const LoadSummary& ours,
+                            const LoadSummary& theirs, KeyID start,
+                            KeyID end) {
+  // balancing one count at the expense of the other only sends the range
+  // straight back on the next round
+  u64 keys = std::min<u64>(storage_->CountRange(start, end), ours.keys_);
+  auto requests = std::min<u64>(
+      std::llround(load_.Fraction(start, end) * ours.requests_),
+      ours.requests_);
+  LoadSummary receiver{
+    .keys_ = theirs.keys_ + keys,
+    .requests_ = static_cast<u32>(theirs.requests_ + requests),
+  };
+  LoadSummary left{
+    .keys_ = ours.keys_ - keys,
+    .requests_ = static_cast<u32>(ours.requests_ - requests),
+  };
+  return !Imbalance(receiver, left);
+}
+
+LoadSummary Node::MeasureLoad() {
+  load_.Tick();
+  // the arcs OwnsId answers for, counted in place rather than by hashing
+  // every key we hold
+  KeyID start = id_;
+  std::optional<Delegation> adopted;
+  {
+    util::EpochGuard guard;
+    const RingView& view = View();
+    // with no predecessor (id_, id_] is the whole ring
+    if (view.predecessor_) {
+      start = view.delegated_ && view.InDelegatedRange(view.delegated_->end_)
+          ? view.delegated_->end_ : view.predecessor_->id_;
+      if (view.adopted_ && view.InAdoptedRange(view.adopted_->end_)) {
+        adopted = view.adopted_;
+      }
+    }
+  }
+  u64 keys = storage_->CountRange(start, id_);
+  if (adopted) {
+    keys += storage_->CountRange(adopted->start_, adopted->end_);
+  }
+  return {
+    .keys_ = keys,
+    .requests_ = static_cast<u32>(std::lround(load_.Rate())),
+  };
+}
+
+std::vector<KeyID> Node::LoadPoints(KeyID start, KeyID end,
+                                    bool by_requests) {
+  std::vector<KeyID> points;
+  if (by_requests) {
+    points = load_.Samples(start, end);
+  }
+  else {
+    points = storage_->RangeIds(start, end);
+  }
+  std::ranges::sort(points, {}, [start](KeyID key_id) {
+    return static_cast<NodeID>(key_id - start);
+  });
+  return points;
+}
+
+std::vector<NodeInfo> Node::AlternativeNodes() const {
+  std::vector<NodeInfo> alternatives;
+
+  for (int i{}; i < FingerTable::kSize; i += 4) {
+    auto entry = finger_table_->Get(i);
+    if (entry && entry->id_ != id_) {
+      bool duplicate = false;
+      for (const auto& alt : alternatives) {
+        if (alt.id_ == entry->id_) {
+          duplicate = true;
+          break;
+        }
+      }
+      if (!duplicate) {
+        alternatives.push_back(*entry);
+      }
+    }
+  }
+
+  return alternatives;
+}
+
+void Node::DumpMetrics() const{
+  auto modules = security_policy_.GetAllMetrics();
+  modules.push_back(storage_->Metrics());
+  modules.push_back(codec_->Metrics());
+  modules.push_back({
+    .module_name = "Ring",
+    .counters = {
+      {"successor_list", SuccessorList().size()},
+      {"successor_failovers",
+       successor_failovers_.load(std::memory_order_relaxed)},
+      {"lookup_retries", lookup_retries_.load(std::memory_order_relaxed)},
+      {"proximity_swaps", proximity_swaps_.load(std::memory_order_relaxed)},
+      {"finger_passes", finger_passes_.load(std::memory_order_relaxed)},
+      {"finger_lookups", finger_lookups_.load(std::memory_order_relaxed)},
+      {"fingers_inferred", fingers_inferred_.load(std::memory_order_relaxed)},
+      {"join_keys", join_keys_.load(std::memory_order_relaxed)},
+      {"leave_keys", leave_keys_.load(std::memory_order_relaxed)},
+      {"keys_handed_over",
+       keys_handed_over_.load(std::memory_order_relaxed)},
+      {"handoff_forwards",
+       handoff_forwards_.load(std::memory_order_relaxed)},
+    },
+    .gauges = {},
+  });
+  double rpc_rate;
+  {
+    std::lock_guard lock(rpc_rate_mutex_);
+    rpc_rate = rpc_rate_;
+  }
+  modules.push_back({
+    .module_name = "Maintenance",
+    .counters = {
+      {"topology_changes", topology_changes_.load(std::memory_order_relaxed)},
+      {"rpcs", maintenance_rpcs_.load(std::memory_order_relaxed)},
+      {"timers", scheduler_->Pending()},
+    },
+    .gauges = {
+      {"stabilise_interval_ms",
+       static_cast<double>(stabilise_routine_->Current().count())},
+      {"fix_fingers_interval_ms",
+       static_cast<double>(fix_fingers_routine_->Current().count())},
+      {"check_predecessor_interval_ms",
+       static_cast<double>(check_predecessor_routine_->Current().count())},
+      {"rpc_rate", rpc_rate},
+    },
+  });
+  u64 lookups = lookups_.load(std::memory_order_relaxed);
+  modules.push_back({
+    .module_name = "Lookup",
+    .counters = {
+      {"alpha", static_cast<u64>(config_.lookup_parallelism)},
+      {"lookups", lookups},
+      {"failed", lookup_failed_.load(std::memory_order_relaxed)},
+      {"stragglers", lookup_stragglers_.load(std::memory_order_relaxed)},
+    },
+    .gauges = {
+      {"hops_avg", lookups == 0 ? 0.0
+          : static_cast<double>(lookup_hops_.load(std::memory_order_relaxed)) /
+            static_cast<double>(lookups)},
+      {"p50_ms", lookup_latency_.PercentileMs(50)},
+      {"p99_ms", lookup_latency_.PercentileMs(99)},
+    },
+  });
+  if (config_.replication_factor == 1) {
+    modules.push_back(location_cache_.Metrics());
+  }
+  modules.push_back(peers_->Metrics());
+  if (!vnodes_.empty()) {
+    // fraction of the id space each position owns, (predecessor, id]
+    auto arc = [](const Node& node) {
+      auto predecessor = node.GetPredecessor();
+      return predecessor
+          ? static_cast<double>(static_cast<NodeID>(node.ID() - predecessor->id_)) /
+                std::ldexp(1.0, kMBits)
+          : 0.0;
+    };
+    double share = arc(*this);
+    double largest = share;
+    for (const auto& vnode : vnodes_) {
+      double owned = arc(*vnode);
+      share += owned;
+      largest = std::max(largest, owned);
+    }
+    modules.push_back({
+      .module_name = "VirtualNodes",
+      .counters = {
+        {"vnodes", vnodes_.size() + 1},
+      },
+      .gauges = {
+        {"ring_share", share},
+        {"largest_arc", largest},
+      },
+    });
+  }
+  if (config_.rebalance) {
+    LoadSummary load;
+    {
+      std::lock_guard lock(ring_mutex_);
+      load = load_summary_;
+    }
+    modules.push_back({
+      .module_name = "Rebalance",
+      .counters = {
+        {"keys", load.keys_},
+        {"sheds", sheds_.load(std::memory_order_relaxed)},
+        {"keys_shed", keys_shed_.load(std::memory_order_relaxed)},
+        {"adoptions", adoptions_.load(std::memory_order_relaxed)},
+        {"reclaims", reclaims_.load(std::memory_order_relaxed)},
+      },
+      .gauges = {
+        {"request_rate", load_.Rate()},
+      },
+    });
+  }
+  if (membership_) {
+    auto module = membership_->Metrics();
+    module.counters.emplace_back(
+        "one_hop_sent", one_hop_sent_.load(std::memory_order_relaxed));
+    module.counters.emplace_back(
+        "one_hop_refused", one_hop_refused_.load(std::memory_order_relaxed));
+    modules.push_back(std::move(module));
+  }
+  if (config_.replication_factor > 1) {
+    auto avg_ms = [](u64 total_us, u64 count) {
+      return count == 0 ? 0.0 : static_cast<double>(total_us) / 1000.0 /
+                                    static_cast<double>(count);
+    };
+    u64 writes = quorum_writes_.load(std::memory_order_relaxed);
+    u64 reads = quorum_reads_.load(std::memory_order_relaxed);
+    modules.push_back({
+      .module_name = "Replication",
+      .counters = {
+        {"replication_factor", static_cast<u64>(config_.replication_factor)},
+        {"write_quorum", static_cast<u64>(config_.write_quorum)},
+        {"read_quorum", static_cast<u64>(config_.read_quorum)},
+        {"writes", writes},
+        {"write_quorum_failed",
+         write_quorum_failed_.load(std::memory_order_relaxed)},
+        {"reads", reads},
+        {"read_quorum_failed",
+         read_quorum_failed_.load(std::memory_order_relaxed)},
+        {"read_second_waves",
+         read_second_waves_.load(std::memory_order_relaxed)},
+        {"replica_syncs", replica_syncs_.load(std::memory_order_relaxed)},
+        {"replica_sync_failed",
+         replica_sync_failed_.load(std::memory_order_relaxed)},
+      },
+      .gauges = {
+        {"write_ms_avg",
+         avg_ms(write_us_.load(std::memory_order_relaxed), writes)},
+        {"read_ms_avg", avg_ms(read_us_.load(std::memory_order_relaxed), reads)},
+      },
+    });
+  }
+  modules.push_back({
+    .module_name = "AntiEntropy",
+    .counters = {
+      {"sync_runs", sync_runs_.load(std::memory_order_relaxed)},
+      {"digests_compared", sync_digests_.load(std::memory_order_relaxed)},
+      {"leaves_differing", sync_leaves_.load(std::memory_order_relaxed)},
+      {"records_pulled", sync_records_.load(std::memory_order_relaxed)},
+    },
+    .gauges = {},
+  });
+  std::cout << "METRICS:" << util::MetricsToJSON(modules) << std::endl;
+}
+
+void Node::FixFingers() {
+  finger_passes_.fetch_add(1, std::memory_order_relaxed);
+
+  // arcs (from, owner] with no node in them but owner, to begin with the
+  // ones the successor list spells out
+  std::vector<std::pair<NodeID, NodeInfo>> arcs;
+  {
+    std::lock_guard lock(ring_mutex_);
+    NodeID from = id_;
+    if (successor_ && successor_->id_ != id_) {
+      arcs.emplace_back(from, *successor_);
+      from = successor_->id_;
+    }
+    for (const auto& entry : successor_list_) {
+      if (entry.id_ == id_) {
+        break;
+      }
+      if (entry.id_ != from && InRangeExclusive(entry.id_, from, id_)) {
+        arcs.emplace_back(from, entry);
+        from = entry.id_;
+      }
+    }
+  }
+  auto known = [&arcs](NodeID start) -> std::optional<NodeInfo> {
+    for (const auto& [from, owner] : arcs) {
+      if (InRangeExclusiveInclusive(start, from, owner.id_)) {
+        return owner;
+      }
+    }
+    return std::nullopt;
+  };
+  // how far apart nodes are around here, lookups for starts closer
+  // together than that most likely end at the same node
+  NodeID spacing = arcs.empty() ? 0
+      : static_cast<NodeID>(arcs.back().second.id_ - id_) /
+            static_cast<NodeID>(arcs.size());
+
+  std::array<std::optional<NodeInfo>, FingerTable::kSize> found;
+  std::array<bool, FingerTable::kSize> asked{};
+  for (int wave{}; wave < kFingerPassWaves; ++wave) {
+    std::vector<int> indices;
+    std::vector<NodeID> starts;
+    std::optional<NodeInfo> last_old;
+    for (int i{}; i < FingerTable::kSize; ++i) {
+      if (found[i] || asked[i]) {
+        continue;
+      }
+      NodeID start = finger_table_->GetStart(i);
+      if (auto owner = known(start)) {
+        found[i] = owner;
+        fingers_inferred_.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+      // left for the next wave, by when the lookup for the finger before
+      // may well have covered it: the same node as that finger in the
+      // old table, as long as that node is not behind start...
+      auto old = finger_table_->Get(i);
+      bool same_as_last = old && last_old && old->id_ == last_old->id_ &&
+          static_cast<NodeID>(old->id_ - id_) >=
+              static_cast<NodeID>(start - id_);
+      last_old = old;
+      // ...or too close to the start looked up before it
+      bool too_close = !starts.empty() &&
+          static_cast<NodeID>(start - starts.back()) < spacing;
+      if (same_as_last || too_close) {
+        continue;
+      }
+      indices.push_back(i);
+      starts.push_back(start);
+    }
+    if (starts.empty()) {
+      break;
+    }
+
+    finger_lookups_.fetch_add(starts.size(), std::memory_order_relaxed);
+    auto owners = ConcurrentLookups(starts);
+    for (size_t k{}; k < starts.size(); ++k) {
+      asked[indices[k]] = true;
+      if (owners[k]) {
+        found[indices[k]] = owners[k];
+        // nothing between the start and where its lookup ended
+        arcs.emplace_back(starts[k] - 1, *owners[k]);
+      }
+    }
+  }
+
+  for (int i{}; i < FingerTable::kSize; ++i) {
+    if (found[i] && security_policy_.AllowNode(*found[i])) {
+      finger_table_->Set(i, config_.proximity_fingers
+          ? ClosestFingerCandidate(i, *found[i])
+          : *found[i]);
+    }
+  }
+}
+
+NodeInfo Node::ClosestFingerCandidate(int index, const NodeInfo& successor) {
+  // any node in [start(i), start(i+1)) keeps lookups at O(log n) hops
+  NodeID start = finger_table_->GetStart(index);
+  NodeID end = index + 1 < FingerTable::kSize
+      ? finger_table_->GetStart(index + 1)
+      : id_;
+  auto in_interval = [start, end, this](const NodeInfo& node) {
+    return node.id_ != id_ &&
+           static_cast<NodeID>(node.id_ - start) <
+               static_cast<NodeID>(end - start);
+  };
+  // an empty interval leaves the successor as the only choice
+  if (!in_interval(successor)) {
+    return successor;
+  }
+
+  std::vector<NodeInfo> candidates{successor};
+  if (successor.id_ != id_) {
+    auto theirs = TcpClient::GetSuccessorList(successor.address_);
+    for (const auto& node : theirs.value_or(std::vector<NodeInfo>{})) {
+      if (!in_interval(node)) {
+        break;
+      }
+      if (security_policy_.AllowNode(node)) {
+        candidates.push_back(node);
+      }
+    }
+  }
+  if (candidates.size() == 1) {
+    return successor;
+  }
+
+  const NodeInfo* best = nullptr;
+  double best_rtt = 0.0;
+  for (const auto& candidate : candidates) {
+    auto rtt = MeasureRtt(candidate);
+    if (rtt && (!best || *rtt < best_rtt)) {
+      best = &candidate;
+      best_rtt = *rtt;
+    }
+  }
+  if (!best) {
+    return successor;
+  }
+  if (best->id_ != successor.id_) {
+    proximity_swaps_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return *best;
+}
+
+std::optional<double> Node::MeasureRtt(const NodeInfo& node) {
+  auto start = std::chrono::steady_clock::now();
+  if (!IsAlive(node.address_)) {
+    std::lock_guard lock(rtt_mutex_);
+    rtt_ms_.erase(node.id_);
+    return std::nullopt;
+  }
+  double sample = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+
+  std::lock_guard lock(rtt_mutex_);
+  auto [it, fresh] = rtt_ms_.try_emplace(node.id_, sample);
+  if (!fresh) {
+    it->second += kRttSmoothing * (sample - it->second);
+  }
+  return it->second;
+}
+
+
+void Node::CheckPredecessor() {
+  std::optional<NodeInfo> predecessor;
+  {
+    std::lock_guard lock(ring_mutex_);
+    predecessor = predecessor_;
+  }
+
+  // pinged without the lock, a stalled predecessor would otherwise hold up
+  // every lookup through here for the whole timeout
+  if (!predecessor || IsAlive(predecessor->address_)) {
+    return;
+  }
+  TopologyChanged();
+
+  RingUpdate update(*this);
+  // a notify may have replaced it in the meantime
+  if (predecessor_ && predecessor_->id_ == predecessor->id_) {
+    std::cerr << "Predecessor " << predecessor_->id_ << " has failed" << "\n";
+    predecessor_ = std::nullopt;
+  }
+}
+
+bool Node::IsAlive(const NodeAddress& address) {
+  return TcpClient::Ping(address);
+}
+
+void Node::UpdateSuccessorList(const NodeInfo& successor,
+                               const std::vector<NodeInfo>& theirs) {
+  std::vector<NodeInfo> list{successor};
+  for (const auto& entry : theirs) {
+    if (list.size() >= Config::successor_list_size || entry.id_ == id_) {
+      break;
+    }
+    if (entry.id_ != list.back().id_) {
+      list.push_back(entry);
+    }
+  }
+
+  RingUpdate update(*this);
+  // the successor moved while we were asking, the answer is stale
+  if (successor_ && successor_->id_ == successor.id_) {
+    auto same_id = [](const NodeInfo& a, const NodeInfo& b) {
+      return a.id_ == b.id_;
+    };
+    if (!std::ranges::equal(list, successor_list_, same_id)) {
+      TopologyChanged();
+    }
+    successor_list_ = std::move(list);
+  }
+}
+
+void Node::HandleDeadPeer(const NodeInfo& peer) {
+  TopologyChanged();
+  {
+    std::lock_guard lock(rtt_mutex_);
+    rtt_ms_.erase(peer.id_);
+  }
+  location_cache_.Invalidate(peer.id_);
+  if (membership_) {
+    membership_->Remove(peer.id_);
+  }
+
+  for (int i{}; i < FingerTable::kSize; ++i) {
+    auto finger = finger_table_->Get(i);
+    if (finger && finger->id_ == peer.id_) {
+      finger_table_->Clear(i);
+    }
+  }
+
+  std::vector<NodeInfo> candidates;
+  {
+    RingUpdate update(*this);
+    std::erase_if(successor_list_,
+                  [&peer](const NodeInfo& entry) { return entry.id_ == peer.id_; });
+    if (!successor_ || successor_->id_ != peer.id_) {
+      return;
+    }
+    candidates = successor_list_;
+  }
+
+  // pinged without the lock, a dead candidate can take a while to refuse.
+  // with nobody left we are our own successor until stabilise finds one
+  NodeInfo next = Info();
+  for (const auto& candidate : candidates) {
+    if (candidate.id_ != id_ && IsAlive(candidate.address_)) {
+      next = candidate;
+      break;
+    }
+  }
+
+  {
+    RingUpdate update(*this);
+    if (!successor_ || successor_->id_ != peer.id_) {
+      return;
+    }
+    std::cerr << "Successor " << peer.id_ << " has failed, failing over to "
+      << next.id_ << "\n";
+    successor_ = next;
+    // whatever sat in front of next on the list did not answer either
+    auto it = std::find(successor_list_.begin(), successor_list_.end(), next);
+    successor_list_.erase(successor_list_.begin(), it);
+  }
+  finger_table_->Set(0, next);
+  successor_failovers_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Node::StartMaintenance() {
+  stabilise_routine_->Start();
+  fix_fingers_routine_->Start();
+  check_predecessor_routine_->Start();
+}
+
+void Node::StopMaintenance() {
+  stabilise_routine_->Stop();
+  fix_fingers_routine_->Stop();
+  check_predecessor_routine_->Stop();
+}
+
+void Node::TopologyChanged() {
+  Node& process = host_ ? *host_ : *this;
+  process.topology_changes_.fetch_add(1, std::memory_order_relaxed);
+  stabilise_routine_->Tighten();
+  fix_fingers_routine_->Tighten();
+  check_predecessor_routine_->Tighten();
+}
+
+void Node::CountMaintenanceRpcs(u64 rpcs) {
+  if (host_) {
+    host_->CountMaintenanceRpcs(rpcs);
+    return;
+  }
+  maintenance_rpcs_.fetch_add(rpcs, std::memory_order_relaxed);
+  std::lock_guard lock(rpc_rate_mutex_);
+  rpc_window_count_ += rpcs;
+  auto now = std::chrono::steady_clock::now();
+  std::chrono::duration<double> elapsed = now - rpc_window_start_;
+  if (elapsed >= kRpcRateWindow) {
+    rpc_rate_ = static_cast<double>(rpc_window_count_) / elapsed.count();
+    rpc_window_count_ = 0;
+    rpc_window_start_ = now;
   }
 }
 
 void Node::PrintState() const {
+  PrintRingState();
+  for (const auto& vnode : vnodes_) {
+    vnode->PrintRingState();
+  }
+}
+
+void Node::PrintRingState() const {
   std::lock_guard lock(ring_mutex_);
 
   std::cerr << "\n" << " === Node State === " << "\n";
@@ -427,7 +2562,23 @@ void Node::PrintState() const {
     std::cerr << "Successor: (none)" << "\n";
   }
 
-  std::cerr << "Stored Keys: " << storage_.Size() << "\n";
+  std::cerr << "Successor List:";
+  for (const auto& entry : successor_list_) {
+    std::cerr << " " << entry.id_;
+  }
+  std::cerr << "\n";
+
+  if (delegated_) {
+    std::cerr << "Delegated: (" << delegated_->start_ << ", "
+      << delegated_->end_ << "] to " << delegated_->peer_.id_ << "\n";
+  }
+  if (adopted_) {
+    std::cerr << "Adopted: (" << adopted_->start_ << ", "
+      << adopted_->end_ << "] from " << adopted_->peer_.id_ << "\n";
+  }
+
+  std::cerr << "Stored Keys: " << storage_->Size()
+    << " (" << storage_->BackendName() << ")" << "\n";
   std::cerr << "==================================" << "\n" << "\n";
 }
 
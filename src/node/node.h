@@ -3,16 +3,26 @@
 
 #include <atomic>
 #include <chrono>
+#include <functional>
 #include <mutex>
 #include <thread>
+#include <unordered_map>
 
 #include "types/types.h"
 #include "net/tcp_server.h"
 #include "net/tcp_client.h"
 #include "node/fingertable.h"
+#include "node/load_tracker.h"
+#include "node/location_cache.h"
+#include "node/membership.h"
+#include "node/peer_table.h"
 #include "node/storage.h"
+#include "node/value_codec.h"
 #include "security/security_module.h"
 #include "util/hash.h"
+#include "util/latency_histogram.h"
+#include "util/scheduler.h"
+#include "util/thread_pool.h"
 
 namespace tsc::sec::mod { class HoneypotMonitor; }
 
@@ -26,12 +36,62 @@ class Node {
     std::string ip_{"127.0.0.1"};
     u16 port_{8000};
 
-    static constexpr std::chrono::milliseconds stabilise_interval{1000};
-    static constexpr std::chrono::milliseconds fix_fingers_interval{500};
-    static constexpr std::chrono::milliseconds check_predecessor_interval{2000};
+    // each maintenance loop runs at its min interval while the ring is
+    // changing and backs off, doubling after every quiet round, to its max
+    static constexpr std::chrono::milliseconds stabilise_interval_min{250};
+    static constexpr std::chrono::milliseconds stabilise_interval_max{2000};
+    static constexpr std::chrono::milliseconds fix_fingers_interval_min{1000};
+    static constexpr std::chrono::milliseconds fix_fingers_interval_max{16000};
+    static constexpr std::chrono::milliseconds check_predecessor_interval_min{500};
+    static constexpr std::chrono::milliseconds check_predecessor_interval_max{4000};
 
     static constexpr int successor_list_size{3};
 
+    // storage, sstables go to <lsm_dir>/<port>. empty keeps everything in RAM
+    std::string lsm_dir{};
+    // in memory byte budget, 0 is unbounded
+    size_t storage_max_bytes{0};
+    // values at least this big are compressed when they enter the ring,
+    // 0 is off
+    size_t compress_min_bytes{0};
+
+    // every key lives on its owner and the replication_factor - 1 nodes
+    // after it. a put waits for write_quorum acks, a get for read_quorum
+    // identical answers. 1/1/1 is plain chord
+    int replication_factor{1};
+    int write_quorum{1};
+    int read_quorum{1};
+
+    // lookups started here walk the ring themselves, asking every hop for
+    // its next hop, instead of handing the lookup on to a hop that then
+    // waits on the one after it
+    bool iterative_lookup{false};
+    // alpha. above 1 lookups run iteratively with this many next hop
+    // requests in flight and take the first final answer. they all go out
+    // from the calling thread, so dropping the stragglers costs nothing
+    int lookup_parallelism{1};
+    // proximity neighbour selection. each finger is the lowest rtt node
+    // found in its interval rather than the first one
+    bool proximity_fingers{false};
+    // arcs of the ring whose owner a lookup already found, so gets, puts
+    // and deletes on nearby keys skip the lookup. 0 turns it off. only
+    // used without replication, quorum operations always look up
+    size_t location_cache_size{1024};
+    // every node keeps the whole membership, pulled from its successor and
+    // one finger per stabilise round, and sends gets, puts and deletes
+    // straight to the owner it finds in it. lookups still go through the
+    // finger table, with the membership only shortening their first hop
+    bool one_hop{false};
+    // ring positions per process. each virtual node has its own id, ring
+    // neighbours, fingers and maintenance routines, and they all share the
+    // storage and the server of the first
+    int virtual_nodes{1};
+    // neighbours swap load summaries every stabilise round and a node
+    // carrying too much of the load between it and its predecessor hands
+    // the bottom of its arc to that predecessor, which answers for it from
+    // then on. only without replication, like the location cache
+    bool rebalance{false};
+
     // security flags
     bool enable_id_verification{false};
     bool enable_subnet_diversity{false};
@@ -50,11 +110,16 @@ class Node {
     // used for the python test
     bool is_malicious{false};
     bool spoof_id{false};
+    // held before every request is handled, to emulate a distant node
+    int emulated_delay_ms{0};
   };
 
   explicit Node(const Config& config);
   ~Node();
 
+  // index 0 is this node, nullptr past the last
+  Node* VirtualNode(u8 index);
+
   // life-cycle
 
   bool Create();
@@ -69,30 +134,116 @@ class Node {
 
   std::optional<NodeInfo> FindSuccessor(NodeID node_id, bool validate = false);
 
+  // one step of a lookup from the local tables, no calls made. more asks
+  // for that many further candidates when the step is not final
+  std::optional<LookupHop> NextHop(NodeID node_id, size_t more = 0);
+
   void Notify(const NodeInfo& node);
 
   [[nodiscard]] std::optional<NodeInfo> GetPredecessor() const;
 
   [[nodiscard]] std::optional<NodeInfo> GetSuccessor() const;
 
+  // up to Config::successor_list_size nodes following this one, nearest
+  // first. refreshed from the successor's own list every stabilise round
+  [[nodiscard]] std::vector<NodeInfo> SuccessorList() const;
+
   // classic hash table operations
 
-  bool Put(const std::string& key, const std::string& value);
+  // a zero ttl never expires. this is where values enter the ring, so it is
+  // also where they get compressed. move the value in: it is handed down to
+  // storage or the network as is
+  bool Put(std::string_view key, std::string value,
+           std::chrono::milliseconds ttl = {});
+
+  // routed like Put, for values that already went through a ValueCodec
+  bool PutEncoded(std::string_view key, EncodedValue value,
+                  std::chrono::milliseconds ttl = {});
+
+  [[nodiscard]] std::optional<std::string> Get(std::string_view key);
+
+  // routed like Get, but a locally owned value comes back as the stored
+  // buffer so the server can send it without copying, and nothing is
+  // expanded. empty when missing.
+  [[nodiscard]] ValueSlice GetShared(std::string_view key);
+
+  ValueCodec& Codec() { return *codec_; }
+
+  bool Remove(std::string_view key);
 
-  [[nodiscard]] std::optional<std::string> Get(const std::string& key);
+  // key falls in (predecessor, us], or we have no predecessor yet
+  [[nodiscard]] bool Owns(std::string_view key) const;
 
-  bool Remove(const std::string& key);
+  // membership changes after cursor for a peer's pull, nullopt when one hop
+  // routing is off
+  [[nodiscard]] std::optional<MembershipDelta> MembershipSince(
+      u64 cursor) const;
+
+  // rebalancing
+
+  // sender's load as it reported it, kept if sender is our predecessor, and
+  // ours in return
+  LoadSummary PeerLoad(const NodeInfo& sender, const LoadSummary& load);
+
+  // takes (start, end] over from source, a busier neighbour: the bottom of
+  // its arc if it is our successor, start being our id, or the top of what
+  // we delegated to it if it is our predecessor. we answer for the range
+  // straight away and then pull it from source. returns the records pulled,
+  // nullopt if refused
+  std::optional<size_t> AdoptRange(const NodeInfo& source, KeyID start,
+                                   KeyID end);
 
   // local operations (YOU ARE THE NODE)
 
-  void LocalPut(const std::string& key, const std::string& value);
+  bool LocalPut(std::string_view key, std::string value,
+                std::chrono::milliseconds ttl = {});
 
   [[nodiscard]] std::optional<std::string> LocalGet(
-      const std::string& key) const;
+      std::string_view key) const;
+
+  // forward: a key in an arc changing hands is looked for at the other side
+  // too, see TakeOverArc
+  [[nodiscard]] ValueSlice LocalGetShared(std::string_view key,
+                                          bool forward = true) const;
+
+  bool LocalRemove(std::string_view key, bool forward = true);
 
+  // a copy sent by the coordinator of a replicated put
+  bool StoreReplica(std::string_view key, EncodedValue value,
+                    std::chrono::milliseconds ttl = {});
+
+  // encoded records, so ttls survive the transfer
   std::vector<std::pair<std::string, std::string>> GetKeysInRange(NodeID start,
                                                                   NodeID end);
 
+  // removes and returns up to limit records in (start, end] for mover. that
+  // is either our predecessor, as we know it, taking the arc up to its own
+  // id after joining in front of us, or our successor taking our arc while
+  // we leave. anyone else gets nothing
+  std::vector<std::pair<std::string, std::string>> HandOverRange(
+      const NodeInfo& mover, KeyID start, KeyID end, u32 limit);
+
+  // node, a neighbour of ours, is leaving, see LeaveRequest. relinks past
+  // it and as heir pulls its keys in (start, node], returning how many.
+  // nullopt if node is neither our predecessor nor our successor
+  std::optional<size_t> PeerLeaving(const NodeInfo& node,
+                                    const std::optional<NodeInfo>& predecessor,
+                                    const NodeInfo& successor, KeyID start,
+                                    bool heir);
+
+  // anti-entropy
+
+  // digests of merkle tree nodes on one level, see Storage::MerkleHash
+  Result<std::vector<u64>> MerkleHashes(u8 level,
+                                        const std::vector<u32>& indices) const;
+
+  // makes (start, end] here match what peer holds by walking both merkle
+  // trees top down and pulling only the arcs that differ. the peer wins any
+  // disagreement and nothing is deleted locally. returns the number of
+  // records pulled, nullopt if the peer stopped answering.
+  std::optional<size_t> SyncRange(const NodeAddress& peer, KeyID start,
+                                  KeyID end);
+
   // security
 
   SecurityPolicy& GetSecurityPolicy() { return security_policy_; }
@@ -110,58 +261,446 @@ class Node {
     return {.id_ = id_, .address_ = address_};
   }
 
+  // ours and then each virtual node's
   void PrintState() const;
   void PrintFingerTable() const;
 
   bool IsMalicious() const { return config_.is_malicious; };
 
+  std::chrono::milliseconds EmulatedDelay() const {
+    return std::chrono::milliseconds(config_.emulated_delay_ms);
+  }
+
  private:
+  // part of an arc answered for by a neighbour instead of its owner
+  struct Delegation {
+    KeyID start_;
+    KeyID end_;
+    NodeInfo peer_;
+  };
+
+  // key_id in range, which still counts only while neighbour is the peer it
+  // was handed to or taken from
+  static bool InHandedRange(const std::optional<Delegation>& range,
+                            const std::optional<NodeInfo>& neighbour,
+                            KeyID key_id);
+
+  // the ring fields as of the last change. lookups and ownership checks
+  // read this without ring_mutex_, see RingUpdate
+  struct RingView {
+    std::optional<NodeInfo> predecessor_;
+    std::optional<NodeInfo> successor_;
+    std::vector<NodeInfo> successor_list_;
+    std::optional<Delegation> delegated_;
+    std::optional<Delegation> adopted_;
+    std::optional<Delegation> handoff_;
+    std::optional<Delegation> handed_;
+
+    [[nodiscard]] bool InAdoptedRange(KeyID key_id) const {
+      return InHandedRange(adopted_, successor_, key_id);
+    }
+    [[nodiscard]] bool InDelegatedRange(KeyID key_id) const {
+      return InHandedRange(delegated_, predecessor_, key_id);
+    }
+    // no neighbour check, whoever sets handoff_ clears it once the move
+    // is over
+    [[nodiscard]] bool InHandoff(KeyID key_id) const {
+      return handoff_ &&
+             InRangeExclusiveInclusive(key_id, handoff_->start_, handoff_->end_);
+    }
+    [[nodiscard]] bool InHanded(KeyID key_id) const {
+      return InHandedRange(handed_, predecessor_, key_id);
+    }
+  };
+
+  // ring_mutex_ held for a change to the ring fields. a fresh RingView is
+  // published before the lock goes
+  class RingUpdate {
+  public:
+    explicit RingUpdate(Node& node) : node_(node), lock_(node.ring_mutex_) {}
+    ~RingUpdate() { node_.PublishRingView(); }
+
+    RingUpdate(const RingUpdate&) = delete;
+    RingUpdate& operator=(const RingUpdate&) = delete;
+
+  private:
+    Node& node_;
+    std::lock_guard<std::mutex> lock_;
+  };
+
+  // with ring_mutex_ held
+  void PublishRingView();
+
+  // only valid inside an EpochGuard
+  [[nodiscard]] const RingView& View() const {
+    return *ring_view_.load(std::memory_order_acquire);
+  }
+
+  void PrintRingState() const;
+
+  // virtual node index of host, sharing its storage and server
+  Node(const Config& config, Node* host, u8 vnode);
+
   void InitialiseSecurity();
 
+  // finds our place through known and takes it. no server or threads
+  bool EnterRing(const NodeAddress& known);
+
+  // gives the keys we hold to the first node after us in another process
+  void HandOffKeys();
+
+  // just joined, so (predecessor, id_] is ours but its keys are still with
+  // our successor. pulls them over, answering from the successor for
+  // whatever has not arrived yet
+  void TakeOverArc();
+
+  // moves (start, end] over from donor, which has given it up, a batch of
+  // records at a time. returns how many came
+  size_t PullArc(const NodeAddress& donor, KeyID start, KeyID end);
+
+  // the other side of an arc key_id is moving across: the neighbour we are
+  // pulling it from or handing it to, or the predecessor we gave it to
+  std::optional<NodeInfo> HandoffPeerOf(KeyID key_id) const;
+
+  // node lives in this process, so its keys are in our storage
+  [[nodiscard]] bool IsLocal(const NodeInfo& node) const {
+    return node.address_.SameHost(address_);
+  }
+
+  // the one of our process's virtual nodes that owns key_id, if any
+  Node* LocalOwnerOf(KeyID key_id);
+
+  // who one of our process's virtual nodes handed key_id to, if any
+  std::optional<NodeInfo> DelegateOf(KeyID key_id);
+
   // heartbeat
 
   void Stabilise();
 
+  // one pass over the whole table per round. fingers are resolved in
+  // increasing order and any whose start falls in an arc already known to
+  // end at some node, from the successor list or an earlier answer in the
+  // pass, take that node without a lookup. the lookups that are left go
+  // out together
   void FixFingers();
 
   void CheckPredecessor();
 
-  void StabilisationLoop();
-  void FixFingersLoop();
-  void CheckPredecessorLoop();
+  // the three routines above on the process's scheduler
+  void StartMaintenance();
+  void StopMaintenance();
 
   // helpers
 
-  std::optional<NodeInfo> ClosestPrecedingNode(NodeID id);
+  // lookups give up after this many unreachable hops
+  static constexpr int kLookupAttempts = 3;
+  // an iterative walk longer than this is going in circles
+  static constexpr int kMaxLookupHops = 2 * kMBits;
+  // a parallel lookup does not wait on a slow hop, the others overtake it
+  static constexpr auto kParallelHopTimeout = std::chrono::milliseconds(1000);
+  static constexpr int kMaxLookupParallelism = 16;
+  static constexpr int kMaxVirtualNodes = 64;
+  // rounds of lookups in a pass, fingers still open after that wait for
+  // the next one
+  static constexpr int kFingerPassWaves = 4;
+
+  std::optional<NodeInfo> ClosestPrecedingNode(const RingView& view,
+                                               NodeID id);
+
+  // FindSuccessor that also says how many hops the lookup took
+  std::optional<NodeInfo> FindSuccessor(NodeID node_id, bool validate,
+                                        size_t& hops);
+
+  // FindSuccessor minus the bookkeeping. hops counts the requests sent
+  std::optional<NodeInfo> Route(NodeID node_id, bool validate, size_t& hops);
+
+  // walks from hop to the successor of node_id. on failure hop is left at
+  // the node that did not answer
+  std::optional<NodeInfo> IterativeLookup(NodeID node_id, NodeInfo& hop,
+                                          size_t& hops);
+
+  // iterative with up to lookup_parallelism requests in flight, starting
+  // from first and its candidates. on failure hop is a node that did not
+  // answer, or first when every one of them did
+  std::optional<NodeInfo> ParallelLookup(NodeID node_id, const LookupHop& first,
+                                         NodeInfo& hop, size_t& hops);
+
+  // something moved in the ring, our maintenance routines all drop back
+  // to their shortest interval
+  void TopologyChanged();
+
+  // rpcs one maintenance round sent, for the rate in the first node's
+  // metrics
+  void CountMaintenanceRpcs(u64 rpcs);
+  // the rate is over windows this long
+  static constexpr auto kRpcRateWindow = std::chrono::seconds(10);
+
+  // successors of every id in ids, walked iteratively side by side. a walk
+  // that breaks is retried with FindSuccessor, nullopt if that fails too
+  std::vector<std::optional<NodeInfo>> ConcurrentLookups(
+      const std::vector<NodeID>& ids);
+
+  // local candidates in (id_, node_id), closest to node_id first
+  std::vector<NodeInfo> PrecedingNodes(const RingView& view, NodeID node_id,
+                                       size_t count);
+
+  // lowest rtt node in finger index's interval, starting from successor
+  // (the plain chord choice) and the nodes on its successor list
+  NodeInfo ClosestFingerCandidate(int index, const NodeInfo& successor);
+
+  // pings node and folds the round trip into its smoothed rtt, nullopt if
+  // it did not answer
+  std::optional<double> MeasureRtt(const NodeInfo& node);
+
+  // weight of the newest sample in the smoothed rtt
+  static constexpr double kRttSmoothing = 0.3;
 
   bool IsAlive(const NodeAddress& address);
 
+  // successor followed by its list, cut where it wraps back to us
+  void UpdateSuccessorList(const NodeInfo& successor,
+                           const std::vector<NodeInfo>& theirs);
+
+  // forgets a peer that stopped answering. if it was the successor, the
+  // next live node on the successor list takes over straight away
+  void HandleDeadPeer(const NodeInfo& peer);
+
+  // replication
+
+  // replica pushes are repeated this often even when nothing changed, to
+  // repair copies that missed a write
+  static constexpr u64 kReplicaRefreshRounds = 30;
+  static constexpr size_t kReplicaWorkers = 8;
+  static constexpr size_t kTransferWorkers = 2;
+
+  // looks the owner up and remembers it in the location cache
+  std::optional<NodeInfo> OwnerOf(KeyID key_id);
+
+  [[nodiscard]] bool OwnsId(KeyID key_id) const;
+
+  // who owns key_id without a lookup, from the membership in one hop mode
+  // or else the location cache. never us. the guess must be sent an owned
+  // request and reported to OwnerGuessFailed if that fails
+  std::optional<NodeInfo> GuessOwner(KeyID key_id);
+
+  void OwnerGuessFailed(const NodeInfo& owner);
+
+  // one hop
+
+  // catches up on peer's membership changes. stabilise thread only
+  void PullMembership(const NodeInfo& peer);
+
+  // rebalancing
+
+  // shed once we carry this much of the load between us and our
+  // predecessor, keys and requests counting the same
+  static constexpr double kShedShare = 0.65;
+  // below this many keys and requests a second there is nothing to shed
+  static constexpr u64 kMinShedLoad = 16;
+  // rounds between sheds, so both sides' new loads are measured first
+  static constexpr int kShedCooldown = 5;
+
+  // records per TransferKeys reply while taking over an arc on join or
+  // leave
+  static constexpr u32 kHandoffBatch = 512;
+  // a leaving node waits this long on its heir, which pulls everything
+  // before it answers
+  static constexpr auto kLeaveTimeout = std::chrono::minutes(5);
+
+  // swaps loads with the successor, takes back a delegated range from a
+  // predecessor that is gone and, if we are too busy, sheds the bottom of
+  // our arc or hands back the top of what we adopted. transfer batch only,
+  // see StartTransfers
+  void Rebalance();
+
+  // the fraction of our load to move for the two of us to be even, and
+  // whether it is requests rather than keys, if we carry too much
+  static std::optional<std::pair<double, bool>> Imbalance(
+      const LoadSummary& ours, const LoadSummary& theirs);
+
+  // each returns true if it tried, whether or not the move went through
+  bool ShedToPredecessor(const LoadSummary& ours, const NodeInfo& predecessor,
+                         const LoadSummary& theirs);
+  bool ReturnToSuccessor(const LoadSummary& ours, const NodeInfo& successor,
+                         const LoadSummary& theirs);
+
+  // moving (start, end] to a neighbour would not just make it the busy one,
+  // on either count
+  bool MoveKeepsBalance(const LoadSummary& ours, const LoadSummary& theirs,
+                        KeyID start, KeyID end);
+
+  // keys we answer for and our request rate
+  LoadSummary MeasureLoad();
+
+  // stored keys or recently requested ones in (start, end], in ring order
+  std::vector<KeyID> LoadPoints(KeyID start, KeyID end, bool by_requests);
+
+  // with ring_mutex_ held
+  [[nodiscard]] bool InAdoptedRange(KeyID key_id) const;
+  [[nodiscard]] bool InDelegatedRange(KeyID key_id) const;
+
+  // the owner followed by the nodes after it, replication_factor at most.
+  // empty if the owner could not be found
+  std::vector<NodeInfo> ReplicasFor(KeyID key_id);
+
+  // runs op against every replica at once and returns the number that
+  // succeeded, as soon as needed of them did or all have answered. the local
+  // replica runs inline, stragglers finish in the background, so op must
+  // own everything it touches
+  size_t FanOut(const std::vector<NodeInfo>& replicas, size_t needed,
+                std::function<bool(const NodeInfo&)> op);
+
+  bool QuorumPut(std::string_view key, KeyID key_id, EncodedValue value,
+                 std::chrono::milliseconds ttl);
+
+  ValueSlice QuorumGet(std::string_view key, KeyID key_id);
+
+  bool QuorumRemove(std::string_view key, KeyID key_id);
+
+  // has the first replication_factor - 1 successors pull (predecessor, us]
+  // whenever they or the range change. transfer batch only, see
+  // StartTransfers
+  void MaintainReplicas();
+
+  // MaintainReplicas and Rebalance wait on whole ranges moving, here or at
+  // the peer, so a stabilise round queues them on the host's transfer_pool_
+  // instead of holding a scheduler worker. one batch per node at a time, a
+  // round that finds the last one still going leaves the work to it
+  void StartTransfers();
+
   // state
 
   Config config_;
   NodeID id_;
   NodeAddress address_;
+  // the process's first node for a virtual node, null for the first itself
+  Node* host_;
 
   std::optional<NodeInfo> predecessor_;
   std::optional<NodeInfo> successor_;
   std::vector<NodeInfo> successor_list_;
   mutable std::mutex ring_mutex_;
+  std::atomic<const RingView*> ring_view_;
+
+  // shared by every virtual node in the process
+  std::shared_ptr<Storage> storage_;
+  std::shared_ptr<ValueCodec> codec_;
+  std::shared_ptr<PeerTable> peers_;
 
+  // holds handles into peers_, so it has to go first
   std::unique_ptr<FingerTable> finger_table_;
-  Storage storage_;
 
   std::unique_ptr<TcpServer> server_;
 
   std::atomic<bool> running_{false};
-  std::jthread stabilise_thread_;
-  std::jthread fix_fingers_thread_;
-  std::jthread check_predecessor_thread_;
-
-  int next_finger_{0};
+  std::atomic<u64> topology_changes_{0};
+  std::atomic<u64> maintenance_rpcs_{0};
+  mutable std::mutex rpc_rate_mutex_;
+  std::chrono::steady_clock::time_point rpc_window_start_{
+      std::chrono::steady_clock::now()};
+  u64 rpc_window_count_{0};
+  double rpc_rate_{0.0};
+
+  std::atomic<u64> finger_passes_{0};
+  std::atomic<u64> finger_lookups_{0};
+  std::atomic<u64> fingers_inferred_{0};
+
+  std::atomic<u64> successor_failovers_{0};
+  std::atomic<u64> lookup_retries_{0};
+
+  std::atomic<u64> lookups_{0};
+  std::atomic<u64> lookup_failed_{0};
+  std::atomic<u64> lookup_hops_{0};
+  // requests still in flight when a parallel lookup had its answer
+  std::atomic<u64> lookup_stragglers_{0};
+  util::LatencyHistogram lookup_latency_;
+
+  // smoothed round trip per peer, only kept with proximity_fingers
+  mutable std::mutex rtt_mutex_;
+  std::unordered_map<NodeID, double> rtt_ms_;
+  std::atomic<u64> proximity_swaps_{0};
+
+  LocationCache location_cache_;
+
+  // null unless one_hop
+  std::unique_ptr<Membership> membership_;
+  // where each peer's event log was at our last pull, stabilise thread only
+  std::unordered_map<NodeID, u64> membership_cursors_;
+  int membership_finger_{0};
+  std::atomic<u64> one_hop_sent_{0};
+  std::atomic<u64> one_hop_refused_{0};
+
+  LoadTracker load_;
+  // (start_, end_] at the bottom of our arc, answered for by peer_ while it
+  // is our predecessor
+  std::optional<Delegation> delegated_;
+  // (start_, end_] just past us, ours while peer_ is our successor
+  std::optional<Delegation> adopted_;
+  // ours as of the last round, and what our predecessor last reported
+  LoadSummary load_summary_;
+  std::optional<std::pair<NodeID, LoadSummary>> predecessor_load_;
+  int shed_cooldown_{0};
+  std::atomic<u64> sheds_{0};
+  std::atomic<u64> keys_shed_{0};
+  std::atomic<u64> adoptions_{0};
+  std::atomic<u64> reclaims_{0};
+
+  // (start_, end_] is moving between peer_ and us: ours but maybe still
+  // at peer_ while TakeOverArc or PeerLeaving pulls it, or on its way to
+  // peer_ while we leave
+  std::optional<Delegation> handoff_;
+  // HandOverRange gives up ranges we still own
+  std::atomic<bool> leaving_{false};
+  // (start_, end_] that peer_, our predecessor, took off us when it joined.
+  // requests for it that still come here go on to peer_
+  std::optional<Delegation> handed_;
+  std::atomic<u64> join_keys_{0};
+  std::atomic<u64> leave_keys_{0};
+  std::atomic<u64> keys_handed_over_{0};
+  mutable std::atomic<u64> handoff_forwards_{0};
+
+  // what MaintainReplicas last pushed, and to whom
+  std::optional<NodeID> replicated_from_;
+  std::vector<NodeID> replicated_to_;
+  u64 replica_rounds_{0};
+
+  std::atomic<u64> quorum_writes_{0};
+  std::atomic<u64> write_quorum_failed_{0};
+  std::atomic<u64> write_us_{0};
+  std::atomic<u64> quorum_reads_{0};
+  std::atomic<u64> read_quorum_failed_{0};
+  std::atomic<u64> read_second_waves_{0};
+  std::atomic<u64> read_us_{0};
+  std::atomic<u64> replica_syncs_{0};
+  std::atomic<u64> replica_sync_failed_{0};
+
+  std::atomic<u64> sync_runs_{0};
+  std::atomic<u64> sync_digests_{0};
+  std::atomic<u64> sync_leaves_{0};
+  std::atomic<u64> sync_records_{0};
 
   SecurityPolicy security_policy_;
   // this might be a terrible idea :/
   std::shared_ptr<mod::HoneypotMonitor> honeypot_monitor_;
+
+  // our other virtual nodes, empty unless we are the first
+  std::vector<std::unique_ptr<Node>> vnodes_;
+
+  // replica calls in flight, declared last so it drains before anything
+  // they touch goes away, virtual nodes included. null without replication
+  // and on virtual nodes, which use their host's
+  std::unique_ptr<util::ThreadPool> replica_pool_;
+  // StartTransfers batches, null unless there is something to move and on
+  // virtual nodes
+  std::unique_ptr<util::ThreadPool> transfer_pool_;
+  std::atomic<bool> transfers_running_{false};
+
+  // shared by every node in the process. the routines come last of all,
+  // so they are stopped before anything a round uses goes away
+  std::shared_ptr<util::Scheduler> scheduler_;
+  std::unique_ptr<util::Routine> stabilise_routine_;
+  std::unique_ptr<util::Routine> fix_fingers_routine_;
+  std::unique_ptr<util::Routine> check_predecessor_routine_;
 };
 }  // namespace tsc::node
 
@@ -0,0 +1,138 @@
+#include "node/peer_table.h"
+
+#include "util/epoch.h"
+
+namespace tsc::node {
+PeerTable::~PeerTable() {
+  for (auto& chunk : chunks_) {
+    delete[] chunk.load(std::memory_order_relaxed);
+  }
+}
+
+PeerHandle PeerTable::Intern(const NodeInfo& node, size_t keep_free) {
+  Key key = KeyOf(node);
+  std::lock_guard lock(mutex_);
+  interned_.fetch_add(1, std::memory_order_relaxed);
+  auto [first, last] = index_.equal_range(key);
+  for (auto it = first; it != last; ++it) {
+    if (Resolve(it->second) == node) {
+      ++refs_[it->second];
+      return it->second;
+    }
+  }
+  if (first != last) {
+    // non ipv4 addresses that hashed alike share a key
+    collisions_.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (index_.size() + keep_free >= kCapacity) {
+    full_.fetch_add(1, std::memory_order_relaxed);
+    return kNone;
+  }
+  PeerHandle handle = Append(node);
+  if (handle != kNone) {
+    index_.emplace(key, handle);
+    refs_[handle] = 1;
+  }
+  return handle;
+}
+
+void PeerTable::Release(PeerHandle handle) {
+  if (handle == kNone) {
+    return;
+  }
+  {
+    std::lock_guard lock(mutex_);
+    if (--refs_[handle] != 0) {
+      return;
+    }
+    auto [first, last] = index_.equal_range(KeyOf(Resolve(handle)));
+    for (auto it = first; it != last; ++it) {
+      if (it->second == handle) {
+        index_.erase(it);
+        break;
+      }
+    }
+  }
+  released_.fetch_add(1, std::memory_order_relaxed);
+  // outside mutex_, Retire may run other deleters right here
+  util::Epoch::Retire([free = free_, handle] {
+    std::lock_guard lock(free->mutex_);
+    free->handles_.push_back(handle);
+  });
+}
+
+size_t PeerTable::Size() const {
+  std::lock_guard lock(mutex_);
+  return index_.size();
+}
+
+util::ModuleMetrics PeerTable::Metrics() const {
+  size_t slots;
+  size_t indexed;
+  {
+    std::lock_guard lock(mutex_);
+    slots = refs_.size();
+    indexed = index_.size();
+  }
+  size_t chunks = (slots + kChunkSize - 1) / kChunkSize;
+  return {
+    .module_name = "PeerTable",
+    .counters = {
+      {"peers", indexed},
+      {"slots", slots},
+      {"interned", interned_.load(std::memory_order_relaxed)},
+      {"released", released_.load(std::memory_order_relaxed)},
+      {"collisions", collisions_.load(std::memory_order_relaxed)},
+      {"full", full_.load(std::memory_order_relaxed)},
+      // entries and index nodes, not counting heap held by non sso ips
+      {"bytes", sizeof(PeerTable) + chunks * kChunkSize * sizeof(NodeInfo) +
+                indexed * (sizeof(Key) + sizeof(PeerHandle) +
+                           2 * sizeof(void*))},
+    },
+    .gauges = {},
+  };
+}
+
+PeerTable::Key PeerTable::KeyOf(const NodeInfo& node) {
+  const NodeAddress& address = node.address_;
+  u64 packed = u64{address.port_} << 8 | address.vnode_;
+  if (auto ip = address.Ipv4()) {
+    return Key{.id_ = node.id_, .address_ = u64{*ip} << 24 | packed};
+  }
+  return Key{
+    .id_ = node.id_,
+    .address_ = (std::hash<std::string>{}(address.ip_) << 24 | packed) |
+                u64{1} << 63,
+  };
+}
+
+PeerHandle PeerTable::Append(const NodeInfo& node) {
+  PeerHandle handle = kNone;
+  {
+    std::lock_guard lock(free_->mutex_);
+    if (!free_->handles_.empty()) {
+      handle = free_->handles_.back();
+      free_->handles_.pop_back();
+    }
+  }
+  if (handle == kNone) {
+    if (refs_.size() == kCapacity) {
+      full_.fetch_add(1, std::memory_order_relaxed);
+      return kNone;
+    }
+    handle = static_cast<PeerHandle>(refs_.size());
+    refs_.push_back(0);
+  }
+
+  auto& chunk = chunks_[handle >> kChunkBits];
+  NodeInfo* entries = chunk.load(std::memory_order_relaxed);
+  if (!entries) {
+    entries = new NodeInfo[kChunkSize];
+    chunk.store(entries, std::memory_order_release);
+  }
+  // nobody can be reading a reused slot, and whoever gets the handle reads
+  // it after a release of their own (a snapshot swap or a mutex)
+  entries[handle & (kChunkSize - 1)] = node;
+  return handle;
+}
+} // namespace tsc::node
@@ -0,0 +1,110 @@
+#ifndef PEER_TABLE_H
+#define PEER_TABLE_H
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "types/types.h"
+#include "util/metrics.h"
+
+namespace tsc::node {
+using namespace tsc::type;
+
+// index into a PeerTable
+using PeerHandle = u32;
+
+// every peer a node keeps a reference to, each stored once and named by a
+// small handle. structures that hold many references to the same few
+// peers, like finger table snapshots and location cache arcs, keep handles
+// and resolve them when a NodeInfo is handed out.
+//
+// every Intern counts as one reference and is paired with a Release. an
+// entry nobody references leaves the index at once, but its slot is only
+// reused once util::Epoch says no reader can still hold the handle, so a
+// handle read from a published snapshot resolves without a lock. entries
+// are never moved and their memory goes with the table. if the table is
+// full anyway Intern gives kNone and callers go without caching the peer.
+class PeerTable {
+public:
+  static constexpr PeerHandle kNone = UINT32_MAX;
+
+  PeerTable() = default;
+  ~PeerTable();
+
+  PeerTable(const PeerTable&) = delete;
+  PeerTable& operator=(const PeerTable&) = delete;
+
+  // a reference to node's entry, the same handle every time for the same
+  // id and address while it is referenced. kNone if node is new and fewer
+  // than keep_free entries would be left, so callers that merely cache can
+  // leave room for the ones that need it
+  PeerHandle Intern(const NodeInfo& node, size_t keep_free = 0);
+
+  // gives back a reference from Intern, kNone is ignored
+  void Release(PeerHandle handle);
+
+  // handle must have come from Intern on this table
+  [[nodiscard]] const NodeInfo& Resolve(PeerHandle handle) const {
+    return chunks_[handle >> kChunkBits].load(std::memory_order_acquire)
+        [handle & (kChunkSize - 1)];
+  }
+
+  // entries referenced right now
+  [[nodiscard]] size_t Size() const;
+
+  [[nodiscard]] util::ModuleMetrics Metrics() const;
+
+  // entries that can be referenced at once
+  static constexpr size_t kCapacity = size_t{1} << 20;
+
+private:
+  static constexpr u32 kChunkBits = 8;
+  static constexpr u32 kChunkSize = 1u << kChunkBits;
+  static constexpr u32 kMaxChunks = kCapacity / kChunkSize;
+
+  // id plus ipv4, port and vnode packed into one word. addresses that are
+  // not ipv4 use a hash of ip_ instead, so one key can name several entries
+  struct Key {
+    bool operator==(const Key&) const = default;
+
+    NodeID id_;
+    u64 address_;
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      return std::hash<u64>{}(key.address_ ^ (u64{key.id_} << 32 | key.id_));
+    }
+  };
+
+  static Key KeyOf(const NodeInfo& node);
+
+  // slots that are safe to reuse. shared with the retired callbacks, which
+  // can run after the table is gone
+  struct FreeList {
+    std::mutex mutex_;
+    std::vector<PeerHandle> handles_;
+  };
+
+  // with mutex_ held, kNone if full
+  PeerHandle Append(const NodeInfo& node);
+
+  mutable std::mutex mutex_;
+  std::unordered_multimap<Key, PeerHandle, KeyHash> index_;
+  std::array<std::atomic<NodeInfo*>, kMaxChunks> chunks_{};
+  // references per slot ever handed out, with mutex_ held
+  std::vector<u32> refs_;
+  std::shared_ptr<FreeList> free_{std::make_shared<FreeList>()};
+
+  std::atomic<u64> interned_{0};
+  std::atomic<u64> collisions_{0};
+  std::atomic<u64> full_{0};
+  std::atomic<u64> released_{0};
+};
+} // namespace tsc::node
+
+#endif // PEER_TABLE_H
@@ -0,0 +1,53 @@
+#include "node/record.h"
+
+#include <chrono>
+
+namespace tsc::node {
+u64 Record::NowMs() {
+  return static_cast<u64>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+}
+
+std::string Record::Encode(std::string payload,
+                           std::optional<u64> expires_at_ms, bool compressed) {
+  u8 flags = (expires_at_ms ? kExpires : 0) | (compressed ? kCompressed : 0);
+  // a no-op for buffers that came with kMaxTrailer to spare
+  payload.reserve(payload.size() + kMaxTrailer);
+  if (expires_at_ms) {
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      payload.push_back(static_cast<char>((*expires_at_ms >> shift) & 0xFF));
+    }
+  }
+  payload.push_back(static_cast<char>(flags));
+  return payload;
+}
+
+std::optional<Record> Record::Decode(std::string_view blob) {
+  if (blob.empty()) {
+    return std::nullopt;
+  }
+
+  Record record;
+  record.flags_ = static_cast<u8>(blob.back());
+  size_t trailer = 1;
+
+  if (record.flags_ & kExpires) {
+    if (blob.size() < trailer + 8) {
+      return std::nullopt;
+    }
+    size_t offset = blob.size() - trailer - 8;
+    u64 expires_at = 0;
+    for (size_t i{}; i < 8; ++i) {
+      expires_at = (expires_at << 8) | static_cast<u8>(blob[offset + i]);
+    }
+    record.expires_at_ms_ = expires_at;
+    trailer += 8;
+  }
+
+  record.trailer_size_ = trailer;
+  record.payload_ = blob.substr(0, blob.size() - trailer);
+  return record;
+}
+} // namespace tsc::node
@@ -0,0 +1,57 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "types/types.h"
+
+namespace tsc::node {
+using namespace tsc::type;
+
+// what the backends actually hold for every value. the metadata rides along
+// with the bytes, so anything that copies records verbatim (key transfers,
+// compaction) keeps it without having to know about it.
+//
+//   payload | [u64 expires_at, big endian, if kExpires] | u8 flags
+//
+// it trails the payload so a value can be sealed in its own buffer, which
+// is what lets a received value reach the backend without being copied.
+// with kCompressed set the payload is util::lz output.
+struct Record {
+  enum Flags : u8 {
+    kExpires = 1 << 0,
+    kCompressed = 1 << 1,
+  };
+
+  // wall clock so deadlines mean the same thing on every node
+  static u64 NowMs();
+
+  // largest trailer Encode appends. buffers that are going to end up as
+  // records reserve this much so sealing them never reallocates
+  static constexpr size_t kMaxTrailer = sizeof(u64) + sizeof(u8);
+
+  // appends the trailer to payload in place and hands the buffer back
+  static std::string Encode(std::string payload,
+                            std::optional<u64> expires_at_ms = std::nullopt,
+                            bool compressed = false);
+
+  // nullopt for a blob too short to hold its own trailer
+  static std::optional<Record> Decode(std::string_view blob);
+
+  [[nodiscard]] bool ExpiredAt(u64 now_ms) const {
+    return expires_at_ms_ && *expires_at_ms_ <= now_ms;
+  }
+
+  [[nodiscard]] bool Compressed() const { return flags_ & kCompressed; }
+
+  u8 flags_{};
+  std::optional<u64> expires_at_ms_;
+  // points into the blob that was decoded
+  std::string_view payload_;
+  size_t trailer_size_{};
+};
+} // namespace tsc::node
+
+#endif // RECORD_H
@@ -1,93 +1,346 @@
 #include "storage.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "node/backends/lsm_backend.h"
+#include "node/backends/memory_backend.h"
 #include "util/hash.h"
+#include "util/lz.h"
 
 namespace tsc::node {
 using namespace tsc::hsh;
-void Storage::Put(const std::string& key, const std::string& value) {
-  std::lock_guard lock(mutex_);
-  data_[key] = value;
+Storage::Storage(const Config& config)
+    : expiry_wheel_(kExpiryTick.count(), Record::NowMs()) {
+  if (config.backend == Config::Backend::kLsm) {
+    backend_ = std::make_unique<backend::LsmBackend>(backend::LsmBackend::Config{
+      .dir = config.data_dir,
+      .memtable_bytes = config.memtable_bytes,
+    });
+  }
+  else {
+    backend_ = std::make_unique<backend::MemoryBackend>(
+        backend::MemoryBackend::Config{.max_bytes = config.max_bytes});
+  }
+
+  // digests cover the payload only, so replicas that got the same value at
+  // different times still agree
+  backend_->SetChangeListener([this](KeyID id, std::string_view key,
+                                     const std::string* before,
+                                     const std::string* after) {
+    // what compression saves, counted on the way in and out
+    auto account = [this](const Record& record, i64 sign) {
+      if (!record.Compressed()) {
+        return;
+      }
+      auto raw = util::lz::RawSize(record.payload_);
+      compressed_records_.fetch_add(sign, std::memory_order_relaxed);
+      compressed_saved_bytes_.fetch_add(
+          sign * (static_cast<i64>(raw.value_or(0)) -
+                  static_cast<i64>(record.payload_.size())),
+          std::memory_order_relaxed);
+    };
+
+    std::optional<std::string_view> old_payload;
+    std::optional<std::string_view> new_payload;
+    if (before) {
+      if (auto record = Record::Decode(*before)) {
+        old_payload = record->payload_;
+        account(*record, -1);
+      }
+    }
+    if (after) {
+      if (auto record = Record::Decode(*after)) {
+        new_payload = record->payload_;
+        account(*record, 1);
+      }
+    }
+    merkle_.Update(id, key, old_payload ? &*old_payload : nullptr,
+                   new_payload ? &*new_payload : nullptr);
+  });
+
+  reaper_ = std::jthread([this](std::stop_token stop) { ExpireLoop(stop); });
+}
+
+bool Storage::Put(std::string_view key, std::string value,
+                  std::chrono::milliseconds ttl) {
+  return PutPayload(key, std::move(value), false, ttl);
+}
+
+bool Storage::PutEncoded(std::string_view key, EncodedValue value,
+                         std::chrono::milliseconds ttl) {
+  return PutPayload(key, std::move(value.bytes_), value.compressed_, ttl);
+}
+
+bool Storage::PutPayload(std::string_view key, std::string payload,
+                         bool compressed, std::chrono::milliseconds ttl) {
+  if (ttl.count() <= 0) {
+    return PutRecord(key, Record::Encode(std::move(payload), std::nullopt,
+                                         compressed));
+  }
+
+  u64 expires_at = Record::NowMs() + static_cast<u64>(ttl.count());
+  if (!PutRecord(key, Record::Encode(std::move(payload), expires_at,
+                                     compressed))) {
+    return false;
+  }
+  ScheduleExpiry(key, expires_at);
+  return true;
 }
 
-std::optional<std::string> Storage::Get(const std::string& key) const {
-  std::lock_guard lock(mutex_);
-  auto it = data_.find(key);
-  if(it != data_.end()) {
-    return it->second;
+std::optional<std::string> Storage::Get(std::string_view key) const {
+  auto value = GetShared(key);
+  if (!value) {
+    return std::nullopt;
   }
-  return std::nullopt;
+  if (value.compressed_) {
+    return util::lz::Decompress(value.view_);
+  }
+  return std::string{value.view_};
+}
+
+std::optional<std::string> Storage::Expand(const Record& record) {
+  if (record.Compressed()) {
+    return util::lz::Decompress(record.payload_);
+  }
+  return std::string{record.payload_};
+}
+
+ValueSlice Storage::GetShared(std::string_view key) const {
+  auto blob = backend_->GetShared(Hash::HashKey(key), key);
+  if (!blob) {
+    return {};
+  }
+
+  // lazy expiry, the reaper deletes it on its next tick
+  auto record = Record::Decode(*blob);
+  if (!record || record->ExpiredAt(Record::NowMs())) {
+    return {};
+  }
+  return {std::move(blob), record->payload_, record->Compressed()};
 }
 
-bool Storage::Remove(const std::string& key) {
-  std::lock_guard lock(mutex_);
-  return data_.erase(key) > 0;
+bool Storage::Remove(std::string_view key) {
+  std::lock_guard lock(WriteStripe(key));
+  return backend_->Remove(Hash::HashKey(key), key);
 }
 
-bool Storage::Contains(const std::string& key) const {
-  std::lock_guard lock(mutex_);
-  return data_.find(key) != data_.end();
+bool Storage::Contains(std::string_view key) const {
+  return static_cast<bool>(GetShared(key));
 }
 
 size_t Storage::Size() const {
-  std::lock_guard lock(mutex_);
-  return data_.size();
+  return backend_->Size();
 }
 
 std::vector<std::string> Storage::Keys() const {
-  std::lock_guard lock(mutex_);
   std::vector<std::string> keys;
-  keys.reserve(data_.size());
-  for (const auto& [key, value] : data_) {
-    keys.push_back(key);
-  }
+  u64 now = Record::NowMs();
+  backend_->ScanAll([&](const std::string& key, const std::string& blob) {
+    auto record = Record::Decode(blob);
+    if (record && !record->ExpiredAt(now)) {
+      keys.push_back(key);
+    }
+    return true;
+  });
   return keys;
 }
 
+size_t Storage::CountRange(KeyID start, KeyID end) const {
+  return static_cast<size_t>(std::llround(merkle_.Count(start, end)));
+}
+
+std::vector<KeyID> Storage::RangeIds(KeyID start, KeyID end) const {
+  std::vector<KeyID> ids;
+  u64 now = Record::NowMs();
+  backend_->Scan(start, end,
+                 [&](const std::string& key, const std::string& blob) {
+                   auto record = Record::Decode(blob);
+                   if (record && !record->ExpiredAt(now)) {
+                     ids.push_back(Hash::HashKey(key));
+                   }
+                   return true;
+                 });
+  return ids;
+}
+
 std::vector<std::pair<std::string, std::string>> Storage::GetRange(
     KeyID start, KeyID end) const {
-  std::lock_guard lock(mutex_);
   KeySet result;
+  u64 now = Record::NowMs();
+  backend_->Scan(start, end,
+                 [&](const std::string& key, const std::string& blob) {
+                   auto record = Record::Decode(blob);
+                   if (record && !record->ExpiredAt(now)) {
+                     if (auto value = Expand(*record)) {
+                       result.emplace_back(key, std::move(*value));
+                     }
+                   }
+                   return true;
+                 });
+  return result;
+}
 
-  for (const auto& [key, value] : data_) {
-    KeyID key_id = Hash::HashKey(key);
-    if (InRangeExclusiveInclusive(key_id, start, end)) {
-      result.emplace_back(key, value);
+std::vector<std::pair<std::string, std::string>> Storage::RemoveRange(
+    KeyID start, KeyID end) {
+  KeySet result = ExtractRange(start, end);
+  std::erase_if(result, [](auto& entry) {
+    auto record = Record::Decode(entry.second);
+    auto value = record ? Expand(*record) : std::nullopt;
+    if (!value) {
+      return true;
     }
+    entry.second = std::move(*value);
+    return false;
+  });
+  return result;
+}
+
+void Storage::PutAll(KeySet items) {
+  for(auto& [key, value] : items) {
+    Put(key, std::move(value));
   }
+}
 
+KeySet Storage::ExportRange(KeyID start, KeyID end, size_t limit) const {
+  KeySet result;
+  u64 now = Record::NowMs();
+  backend_->Scan(start, end,
+                 [&](const std::string& key, const std::string& blob) {
+                   auto record = Record::Decode(blob);
+                   if (record && !record->ExpiredAt(now)) {
+                     result.emplace_back(key, blob);
+                   }
+                   return limit == 0 || result.size() < limit;
+                 });
   return result;
 }
 
-std::vector<std::pair<std::string, std::string>> Storage::RemoveRange(
-    KeyID start, KeyID end) {
-  std::lock_guard lock(mutex_);
-  KeySet result;
-  std::vector<std::string> keys_to_remove;
+KeySet Storage::ExtractRange(KeyID start, KeyID end, size_t limit) {
+  KeySet result = ExportRange(start, end, limit);
+  std::erase_if(result, [this](auto& entry) {
+    return !TakeRecord(entry.first, entry.second);
+  });
+  return result;
+}
 
-  for (const auto& [key, value] : data_) {
-    KeyID key_id = Hash::HashKey(key);
-    if (InRangeExclusiveInclusive(key_id, start, end)) {
-      result.emplace_back(key, value);
-      keys_to_remove.push_back(key);
+bool Storage::TakeRecord(std::string_view key, std::string& record) {
+  std::lock_guard lock(WriteStripe(key));
+  KeyID id = Hash::HashKey(key);
+  // a write since the scan replaces what goes out, so what is removed is
+  // always what is returned
+  auto current = backend_->GetShared(id, key);
+  if (!current) {
+    return false;
+  }
+  if (*current != record) {
+    record = *current;
+  }
+  backend_->Remove(id, key);
+  return true;
+}
+
+void Storage::ImportMissing(KeySet records) {
+  std::erase_if(records, [this](const auto& record) {
+    return Contains(record.first);
+  });
+  ImportAll(std::move(records));
+}
+
+void Storage::ImportAll(KeySet records) {
+  u64 now = Record::NowMs();
+  for (auto& [key, blob] : records) {
+    auto record = Record::Decode(blob);
+    if (!record || record->ExpiredAt(now)) {
+      continue;
+    }
+    if (!PutRecord(key, std::move(blob))) {
+      continue;
+    }
+    if (record->expires_at_ms_) {
+      ScheduleExpiry(key, *record->expires_at_ms_);
     }
   }
+}
+
+void Storage::Clear() {
+  backend_->Clear();
+  merkle_.Clear();
+}
+
+util::ModuleMetrics Storage::Metrics() const {
+  util::ModuleMetrics metrics{
+    .module_name = "Storage",
+    .counters = {
+      {"keys", Size()},
+      {"expired", Expired()},
+      {"compressed_records", static_cast<u64>(std::max<i64>(
+          compressed_records_.load(std::memory_order_relaxed), 0))},
+      {"compressed_saved_bytes", static_cast<u64>(std::max<i64>(
+          compressed_saved_bytes_.load(std::memory_order_relaxed), 0))},
+    },
+    .gauges = {},
+  };
+  backend_->CollectMetrics(metrics);
+  return metrics;
+}
+
+bool Storage::PutRecord(std::string_view key, std::string record) {
+  std::lock_guard lock(WriteStripe(key));
+  return backend_->Put(Hash::HashKey(key), key, std::move(record));
+}
 
-  for (const auto& key : keys_to_remove) {
-    data_.erase(key);
+void Storage::ScheduleExpiry(std::string_view key, u64 expires_at_ms) {
+  bool was_empty;
+  {
+    std::lock_guard lock(expiry_mutex_);
+    was_empty = expiry_wheel_.Empty();
+    expiry_wheel_.Schedule(expires_at_ms, std::string{key});
   }
+  if (was_empty) {
+    expiry_cv_.notify_one();
+  }
+}
 
-  return result;
+void Storage::ExpireLoop(std::stop_token stop) {
+  std::vector<std::string> due;
+  while (!stop.stop_requested()) {
+    {
+      std::unique_lock lock(expiry_mutex_);
+      // nothing to do until the first ttl shows up
+      expiry_cv_.wait(lock, stop, [this] { return !expiry_wheel_.Empty(); });
+      expiry_cv_.wait_for(lock, stop, kExpiryTick, [] { return false; });
+      if (stop.stop_requested()) {
+        return;
+      }
+      expiry_wheel_.Advance(Record::NowMs(), [&due](std::string&& key) {
+        due.push_back(std::move(key));
+      });
+    }
+
+    u64 now = Record::NowMs();
+    for (const auto& key : due) {
+      ExpireIfDue(key, now);
+    }
+    due.clear();
+  }
 }
 
-void Storage::PutAll(
-    const std::vector<std::pair<std::string, std::string>>& items) {
-  std::lock_guard lock(mutex_);
-  for(const auto& [key, value] : items) {
-    data_[key] = value;
+void Storage::ExpireIfDue(const std::string& key, u64 now_ms) {
+  std::lock_guard lock(WriteStripe(key));
+  KeyID id = Hash::HashKey(key);
+  auto blob = backend_->GetShared(id, key);
+  if (!blob) {
+    return;
+  }
+  auto record = Record::Decode(*blob);
+  if (record && record->ExpiredAt(now_ms)) {
+    backend_->Remove(id, key);
+    expired_.fetch_add(1, std::memory_order_relaxed);
   }
 }
 
-void Storage::Clear() {
-  std::lock_guard lock(mutex_);
-  data_.clear();
+std::mutex& Storage::WriteStripe(std::string_view key) const {
+  return write_stripes_[std::hash<std::string_view>{}(key) % kWriteStripes];
 }
-} // namespace tsc::node
\ No newline at end of file
+} // namespace tsc::node
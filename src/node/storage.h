@@ -1,32 +1,83 @@
 #ifndef STORAGE_H
 #define STORAGE_H
 
-#include <unordered_map>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <optional>
-#include <mutex>
+#include <thread>
 #include <vector>
 
+#include "node/backends/storage_backend.h"
+#include "node/merkle_tree.h"
+#include "node/record.h"
 #include "types/types.h"
+#include "util/metrics.h"
+#include "util/timer_wheel.h"
 
 namespace tsc::node {
 using namespace tsc::type;
 class Storage {
 public:
-  Storage() = default;
+  struct Config {
+    enum class Backend : u8 { kMemory, kLsm };
+
+    Backend backend{Backend::kMemory};
+
+    // memory only, byte budget before least recently used entries are
+    // evicted. 0 is unbounded
+    size_t max_bytes{0};
+
+    // lsm only
+    std::string data_dir{};
+    size_t memtable_bytes{4 << 20};
+  };
+
+  // granularity of the expiry wheel. reads check the exact deadline, this
+  // only bounds how long an expired entry can sit in the backend
+  static constexpr std::chrono::milliseconds kExpiryTick{100};
+
+  Storage() : Storage(Config{}) {}
+  explicit Storage(const Config& config);
+
+  // a zero ttl never expires. the value buffer becomes the stored record,
+  // so move it in; a copy is only made when the caller keeps theirs. false
+  // if the backend refused it, see IStorageBackend::Put
+  bool Put(std::string_view key, std::string value,
+           std::chrono::milliseconds ttl = {});
 
-  void Put(const std::string& key, const std::string& value);
+  // stores the bytes as given, compressed values stay compressed
+  bool PutEncoded(std::string_view key, EncodedValue value,
+                  std::chrono::milliseconds ttl = {});
 
-  std::optional<std::string> Get(const std::string& key) const;
+  // always the plain value
+  std::optional<std::string> Get(std::string_view key) const;
 
-  bool Remove(const std::string& key);
+  // hands out the stored buffer itself, which may still be compressed (see
+  // ValueSlice::compressed_). empty when missing
+  ValueSlice GetShared(std::string_view key) const;
 
-  bool Contains(const std::string& key) const;
+  bool Remove(std::string_view key);
+
+  bool Contains(std::string_view key) const;
 
   size_t Size() const;
 
   std::vector<std::string> Keys() const;
 
+  // keys in (start, end] from the MerkleTree's per leaf counts, so no key
+  // is looked at. the two leaves at the edges are pro rata, and expired
+  // keys count until the reaper removes them
+  size_t CountRange(KeyID start, KeyID end) const;
+
+  // ring positions of the live keys in (start, end], unordered
+  std::vector<KeyID> RangeIds(KeyID start, KeyID end) const;
+
   std::vector<std::pair<std::string, std::string>> GetRange(
     KeyID start,
     KeyID end
@@ -37,14 +88,83 @@ public:
     KeyID end
   );
 
-  void PutAll(const std::vector<std::pair<std::string, std::string>>& items);
+  void PutAll(KeySet items);
+
+  // the same ranges as encoded records (see Record) instead of plain values.
+  // this is what moves between nodes, so expiry survives a transfer.
+  // limit caps the records returned, 0 for no cap
+  KeySet ExportRange(KeyID start, KeyID end, size_t limit = 0) const;
+
+  KeySet ExtractRange(KeyID start, KeyID end, size_t limit = 0);
+
+  void ImportAll(KeySet records);
+
+  // ImportAll that leaves keys we already hold alone, for records that may
+  // be older than a write made here since
+  void ImportMissing(KeySet records);
 
   void Clear();
 
+  [[nodiscard]] std::string BackendName() const { return backend_->Name(); }
+
+  // entries dropped because their ttl ran out
+  [[nodiscard]] u64 Expired() const {
+    return expired_.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] util::ModuleMetrics Metrics() const;
+
+  // digest of everything stored under a MerkleTree node, kept up to date on
+  // every write so anti-entropy never has to scan
+  [[nodiscard]] u64 MerkleHash(int level, u32 index) const {
+    return merkle_.Hash(level, index);
+  }
+
 private:
-  std::unordered_map<std::string, std::string> data_;
-  mutable std::mutex mutex_;
+  static constexpr size_t kWriteStripes = 16;
+
+  bool PutPayload(std::string_view key, std::string payload, bool compressed,
+                  std::chrono::milliseconds ttl);
+
+  bool PutRecord(std::string_view key, std::string record);
+
+  // removes key under its write stripe, setting record to what was stored.
+  // false if it is gone
+  bool TakeRecord(std::string_view key, std::string& record);
+
+  // payload as the user sees it, nullopt if it does not decompress
+  static std::optional<std::string> Expand(const Record& record);
+
+  void ScheduleExpiry(std::string_view key, u64 expires_at_ms);
+
+  void ExpireLoop(std::stop_token stop);
+
+  // removes key if its current record is past its deadline
+  void ExpireIfDue(const std::string& key, u64 now_ms);
+
+  std::mutex& WriteStripe(std::string_view key) const;
+
+  MerkleTree merkle_;
+
+  // the backend does its own locking
+  std::unique_ptr<backend::IStorageBackend> backend_;
+
+  // writes and expiry of the same key are serialised here so the reaper can
+  // never delete a value that was rewritten after it looked
+  mutable std::array<std::mutex, kWriteStripes> write_stripes_;
+
+  // the wheel only holds keys. a rewrite does not cancel the old timer, the
+  // reaper just finds a live record when it fires and leaves it alone.
+  std::mutex expiry_mutex_;
+  std::condition_variable_any expiry_cv_;
+  util::TimerWheel<std::string> expiry_wheel_;
+  std::atomic<u64> expired_{0};
+
+  // compressed records held and the bytes compression saves on them
+  std::atomic<i64> compressed_records_{0};
+  std::atomic<i64> compressed_saved_bytes_{0};
+  std::jthread reaper_;
 };
 } // namespace tsc::node
 
-#endif
\ No newline at end of file
+#endif
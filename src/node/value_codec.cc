@@ -0,0 +1,87 @@
+#include "node/value_codec.h"
+
+#include <chrono>
+
+#include "util/lz.h"
+
+namespace tsc::node {
+namespace {
+u64 ElapsedNs(std::chrono::steady_clock::time_point since) {
+  return static_cast<u64>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - since)
+          .count());
+}
+} // namespace
+
+EncodedValue ValueCodec::Encode(std::string value) {
+  if (min_bytes_ == 0 || value.size() < min_bytes_) {
+    return {.bytes_ = std::move(value), .compressed_ = false};
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::string packed = util::lz::Compress(value);
+  compress_ns_.fetch_add(ElapsedNs(start), std::memory_order_relaxed);
+
+  if (packed.size() > value.size() - value.size() / kMinGainDivisor) {
+    not_worth_.fetch_add(1, std::memory_order_relaxed);
+    return {.bytes_ = std::move(value), .compressed_ = false};
+  }
+
+  compressed_.fetch_add(1, std::memory_order_relaxed);
+  raw_bytes_.fetch_add(value.size(), std::memory_order_relaxed);
+  packed_bytes_.fetch_add(packed.size(), std::memory_order_relaxed);
+  return {.bytes_ = std::move(packed), .compressed_ = true};
+}
+
+std::optional<std::string> ValueCodec::Decode(const ValueSlice& value) {
+  if (!value) {
+    return std::nullopt;
+  }
+  if (!value.compressed_) {
+    return std::string{value.view_};
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  auto plain = util::lz::Decompress(value.view_);
+  expand_ns_.fetch_add(ElapsedNs(start), std::memory_order_relaxed);
+
+  if (!plain) {
+    corrupt_.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+  }
+  expanded_.fetch_add(1, std::memory_order_relaxed);
+  return plain;
+}
+
+util::ModuleMetrics ValueCodec::Metrics() const {
+  u64 raw = raw_bytes_.load(std::memory_order_relaxed);
+  u64 packed = packed_bytes_.load(std::memory_order_relaxed);
+  u64 compressed = compressed_.load(std::memory_order_relaxed);
+  u64 expanded = expanded_.load(std::memory_order_relaxed);
+  u64 compress_ns = compress_ns_.load(std::memory_order_relaxed);
+  u64 expand_ns = expand_ns_.load(std::memory_order_relaxed);
+
+  return {
+    .module_name = "Compression",
+    .counters = {
+      {"min_bytes", min_bytes_},
+      {"values_compressed", compressed},
+      {"values_not_worth_it", not_worth_.load(std::memory_order_relaxed)},
+      {"raw_bytes", raw},
+      {"compressed_bytes", packed},
+      {"values_expanded", expanded},
+      {"corrupt", corrupt_.load(std::memory_order_relaxed)},
+      {"compress_ns", compress_ns},
+      {"expand_ns", expand_ns},
+    },
+    .gauges = {
+      {"ratio", packed == 0 ? 0.0 : static_cast<double>(raw) / packed},
+      {"compress_mb_per_s",
+       compress_ns == 0 ? 0.0 : raw * 1e3 / static_cast<double>(compress_ns)},
+      {"expand_us_avg",
+       expanded == 0 ? 0.0 : expand_ns / 1e3 / static_cast<double>(expanded)},
+    },
+  };
+}
+} // namespace tsc::node
@@ -0,0 +1,50 @@
+#ifndef VALUE_CODEC_H
+#define VALUE_CODEC_H
+
+#include <atomic>
+#include <optional>
+#include <string>
+
+#include "types/types.h"
+#include "util/metrics.h"
+
+namespace tsc::node {
+using namespace tsc::type;
+
+// decides which values get compressed and expands them again for clients.
+//
+// values are compressed once, by the node a client hands them to, and stay
+// compressed in storage and through every relay. they are only expanded by
+// the node handing the value back to a client that cannot read compressed
+// values (or by Node::Get for local callers).
+class ValueCodec {
+public:
+  // a value has to shrink by at least 1/kMinGainDivisor to be kept
+  // compressed, otherwise readers pay for nothing
+  static constexpr size_t kMinGainDivisor = 8;
+
+  // 0 turns compression off, values from peers are still stored as sent
+  explicit ValueCodec(size_t min_bytes) : min_bytes_(min_bytes) {}
+
+  [[nodiscard]] EncodedValue Encode(std::string value);
+
+  // nullopt if a compressed value turns out to be corrupt
+  [[nodiscard]] std::optional<std::string> Decode(const ValueSlice& value);
+
+  [[nodiscard]] util::ModuleMetrics Metrics() const;
+
+private:
+  size_t min_bytes_;
+
+  std::atomic<u64> compressed_{0};
+  std::atomic<u64> not_worth_{0};
+  std::atomic<u64> raw_bytes_{0};
+  std::atomic<u64> packed_bytes_{0};
+  std::atomic<u64> compress_ns_{0};
+  std::atomic<u64> expanded_{0};
+  std::atomic<u64> expand_ns_{0};
+  std::atomic<u64> corrupt_{0};
+};
+} // namespace tsc::node
+
+#endif // VALUE_CODEC_H
@@ -1,6 +1,7 @@
 #include "protocol/message.h"
 
 #include <algorithm>
+#include <stdexcept>
 
 namespace tsc::msg {
 namespace {
@@ -29,6 +30,15 @@ u32 ReadU32(const std::byte* data) {
          (static_cast<u32>(std::to_integer<u8>(data[3])) << 0);
 }
 
+void WriteU64(std::vector<std::byte>& buff, u64 value) {
+  WriteU32(buff, static_cast<u32>(value >> 32));
+  WriteU32(buff, static_cast<u32>(value & 0xFFFFFFFF));
+}
+
+u64 ReadU64(const std::byte* data) {
+  return static_cast<u64>(ReadU32(data)) << 32 | ReadU32(data + 4);
+}
+
 void WriteU16(std::vector<std::byte>& buff, u16 value) {
   buff.push_back(
       static_cast<std::vector<std::byte>::value_type>(value >> 8 & 0xFF));
@@ -36,6 +46,26 @@ void WriteU16(std::vector<std::byte>& buff, u16 value) {
     static_cast<std::vector<std::byte>::value_type>(value & 0xFF));
 }
 
+// ids go on the wire at full width, big endian like everything else
+constexpr size_t kIdBytes = sizeof(NodeID);
+
+void WriteId(std::vector<std::byte>& buff, NodeID id) {
+  if constexpr (kIdBytes == 4) {
+    WriteU32(buff, id);
+  } else {
+    WriteU64(buff, id);
+  }
+}
+
+template <typename Byte>
+NodeID ReadId(const Byte* data) {
+  if constexpr (kIdBytes == 4) {
+    return ReadU32(data);
+  } else {
+    return static_cast<u64>(ReadU32(data)) << 32 | ReadU32(data + 4);
+  }
+}
+
 u16 ReadU16(const u8* data) {
   return static_cast<u16>(data[0]) << 8 | static_cast<u16>(data[1]);
 }
@@ -60,37 +90,55 @@ std::string ReadString(const u8* data) {
   return result;
 }
 
-std::string ReadString(std::byte*& data) {
+// data is the length prefix. a length that runs past end means the message
+// was cut short. spare reserves room behind the string for the caller to
+// append to
+std::string ReadString(std::byte*& data, const std::byte* end,
+                       size_t spare = 0) {
+  auto left = static_cast<size_t>(end - data);
+  if (left < 4 || left - 4 < ReadU32(data)) {
+    throw std::runtime_error("truncated string");
+  }
   u32 len = ReadU32(data);
   data += 4;
-  std::string result{reinterpret_cast<const char*>(data), len};
+  std::string result;
+  result.reserve(len + spare);
+  result.assign(reinterpret_cast<const char*>(data), len);
   data += len;
   return result;
 }
 
 void WriteNodeInfo(std::vector<std::byte>& buff, const NodeInfo& node) {
-  WriteU32(buff, node.id_);
+  WriteId(buff, node.id_);
   WriteString(buff, node.address_.ip_);
   WriteU16(buff, node.address_.port_);
+  buff.push_back(static_cast<std::byte>(node.address_.vnode_));
 }
 
 NodeInfo ReadNodeInfo(const u8* data) {
   NodeInfo node;
-  node.id_ = ReadU32(data);
-  data += 4;
+  node.id_ = ReadId(data);
+  data += kIdBytes;
   node.address_.ip_ = ReadString(data);
   node.address_.port_ = ReadU16(data);
   data += 2;
   return node;
 }
 
-NodeInfo ReadNodeInfo(std::byte*& data) {
+NodeInfo ReadNodeInfo(std::byte*& data, const std::byte* end) {
+  if (static_cast<size_t>(end - data) < kIdBytes) {
+    throw std::runtime_error("truncated node info");
+  }
   NodeInfo node;
-  node.id_ = ReadU32(data);
-  data += 4;
-  node.address_.ip_ = ReadString(data);
+  node.id_ = ReadId(data);
+  data += kIdBytes;
+  node.address_.ip_ = ReadString(data, end);
+  if (end - data < 3) {
+    throw std::runtime_error("truncated node info");
+  }
   node.address_.port_ = ReadU16(data);
   data += 2;
+  node.address_.vnode_ = std::to_integer<u8>(*data++);
   return node;
 }
 } // namespace
@@ -102,7 +150,7 @@ NodeInfo ReadNodeInfo(std::byte*& data) {
 std::vector<std::byte> FindSuccessorRequest::Serialise() const {
   std::vector<std::byte> buffer;
   buffer.push_back(static_cast<std::byte>(type_));
-  WriteU32(buffer, id_);
+  WriteId(buffer, id_);
   if (sender_) {
     buffer.push_back(std::byte{1});
     WriteNodeInfo(buffer, *sender_);
@@ -114,13 +162,16 @@ std::vector<std::byte> FindSuccessorRequest::Serialise() const {
 
 FindSuccessorRequest FindSuccessorRequest::Deserialise(
     std::span<std::byte> data) {
+  if (data.size() < 2 + kIdBytes) {
+    throw std::runtime_error("truncated find successor request");
+  }
   FindSuccessorRequest request;
   std::byte* ptr = data.data() + 1;
-  request.id_ = ReadU32(ptr);
-  ptr += 4;
+  request.id_ = ReadId(ptr);
+  ptr += kIdBytes;
   bool has_sender = (*ptr++ != std::byte{0});
   if (has_sender) {
-    request.sender_ = ReadNodeInfo(ptr);
+    request.sender_ = ReadNodeInfo(ptr, data.data() + data.size());
   }
   return request;
 }
@@ -141,11 +192,14 @@ std::vector<std::byte> FindSuccessorResponse::Serialise() const {
 
 FindSuccessorResponse FindSuccessorResponse::Deserialise(
     std::span<std::byte> data) {
+  if (data.size() < 2) {
+    throw std::runtime_error("truncated find successor response");
+  }
   FindSuccessorResponse response;
   std::byte* ptr = data.data() + 1;
   response.found_ = *ptr++ != std::byte{0};
   if(response.found_) {
-    response.successor_ = ReadNodeInfo(ptr);
+    response.successor_ = ReadNodeInfo(ptr, data.data() + data.size());
   }
   return response;
 }
@@ -179,11 +233,14 @@ std::vector<std::byte> GetPredecessorResponse::Serialise() const {
 
 GetPredecessorResponse GetPredecessorResponse::Deserialise(
     std::span<std::byte> data) {
+  if (data.size() < 2) {
+    throw std::runtime_error("truncated predecessor response");
+  }
   GetPredecessorResponse response;
   std::byte* ptr = data.data() + 1;
   response.has_predecessor_ = *ptr++ != std::byte{0};
   if(response.has_predecessor_) {
-    response.predecessor_ = ReadNodeInfo(ptr);
+    response.predecessor_ = ReadNodeInfo(ptr, data.data() + data.size());
   }
   return response;
 }
@@ -202,7 +259,7 @@ std::vector<std::byte> NotifyMessage::Serialise() const {
 NotifyMessage NotifyMessage::Deserialise(std::span<std::byte> data) {
   NotifyMessage message;
   std::byte* ptr = data.data() + 1;
-  message.node_ = ReadNodeInfo(ptr);
+  message.node_ = ReadNodeInfo(ptr, data.data() + data.size());
   return message;
 }
 
@@ -216,7 +273,7 @@ std::vector<std::byte> NotifyAck::Serialise() const {
 
 NotifyAck NotifyAck::Deserialise(std::span<std::byte> data) {
   NotifyAck ack;
-  ack.accepted_ = data[1] != std::byte{0};
+  ack.accepted_ = data.size() > 1 && data[1] != std::byte{0};
   return ack;
 }
 
@@ -244,6 +301,189 @@ PongMessage PongMessage::Deserialise(std::span<std::byte> data) {
   return {};
 }
 
+// -------------------------------------------
+// GetSuccessorListRequest
+// -------------------------------------------
+
+std::vector<std::byte> GetSuccessorListRequest::Serialise() const {
+  return {static_cast<std::byte>(type_)};
+}
+
+GetSuccessorListRequest GetSuccessorListRequest::Deserialise(
+    std::span<std::byte>) {
+  return {};
+}
+
+// -------------------------------------------
+// GetSuccessorListResponse
+// -------------------------------------------
+
+std::vector<std::byte> GetSuccessorListResponse::Serialise() const {
+  std::vector<std::byte> buffer;
+  buffer.push_back(static_cast<std::byte>(type_));
+  auto count = static_cast<u8>(
+      std::min<size_t>(successors_.size(), kMaxEntries));
+  buffer.push_back(static_cast<std::byte>(count));
+  for (u8 i{}; i < count; ++i) {
+    WriteNodeInfo(buffer, successors_[i]);
+  }
+  return buffer;
+}
+
+GetSuccessorListResponse GetSuccessorListResponse::Deserialise(
+    std::span<std::byte> data) {
+  if (data.size() < 2) {
+    throw std::runtime_error("truncated successor list");
+  }
+  GetSuccessorListResponse response;
+  std::byte* ptr = data.data() + 1;
+  auto count = std::to_integer<u8>(*ptr++);
+  if (count > kMaxEntries) {
+    throw std::runtime_error("successor list too long");
+  }
+  const std::byte* end = data.data() + data.size();
+  for (u8 i{}; i < count; ++i) {
+    response.successors_.push_back(ReadNodeInfo(ptr, end));
+  }
+  return response;
+}
+
+// -------------------------------------------
+// NextHopRequest
+// -------------------------------------------
+
+std::vector<std::byte> NextHopRequest::Serialise() const {
+  std::vector<std::byte> buffer;
+  buffer.push_back(static_cast<std::byte>(type_));
+  WriteId(buffer, id_);
+  if (more_ != 0) {
+    buffer.push_back(static_cast<std::byte>(more_));
+  }
+  return buffer;
+}
+
+NextHopRequest NextHopRequest::Deserialise(std::span<std::byte> data) {
+  if (data.size() < 1 + kIdBytes) {
+    throw std::runtime_error("truncated next hop request");
+  }
+  u8 more = data.size() > 1 + kIdBytes
+      ? std::to_integer<u8>(data[1 + kIdBytes]) : 0;
+  return NextHopRequest{ReadId(data.data() + 1), more};
+}
+
+// -------------------------------------------
+// NextHopResponse
+// -------------------------------------------
+
+std::vector<std::byte> NextHopResponse::Serialise() const {
+  std::vector<std::byte> buffer;
+  buffer.push_back(static_cast<std::byte>(type_));
+  u8 flags = (hop_ ? kFound : 0) | (hop_ && hop_->final_ ? kFinal : 0);
+  buffer.push_back(static_cast<std::byte>(flags));
+  if (hop_) {
+    WriteNodeInfo(buffer, hop_->node_);
+    // older readers stop after the first node
+    if (!hop_->more_.empty()) {
+      auto count = static_cast<u8>(std::min(hop_->more_.size(), kMaxMore));
+      buffer.push_back(static_cast<std::byte>(count));
+      for (u8 i{}; i < count; ++i) {
+        WriteNodeInfo(buffer, hop_->more_[i]);
+      }
+    }
+  }
+  return buffer;
+}
+
+NextHopResponse NextHopResponse::Deserialise(std::span<std::byte> data) {
+  if (data.size() < 2) {
+    throw std::runtime_error("truncated next hop response");
+  }
+  NextHopResponse response;
+  std::byte* ptr = data.data() + 1;
+  auto flags = std::to_integer<u8>(*ptr++);
+  if (!(flags & kFound)) {
+    return response;
+  }
+
+  const std::byte* end = data.data() + data.size();
+  response.hop_ = LookupHop{
+    .node_ = ReadNodeInfo(ptr, end),
+    .final_ = (flags & kFinal) != 0,
+    .more_ = {},
+  };
+  if (ptr < end) {
+    auto count = std::to_integer<u8>(*ptr++);
+    if (count > kMaxMore) {
+      throw std::runtime_error("too many next hop candidates");
+    }
+    for (u8 i{}; i < count; ++i) {
+      response.hop_->more_.push_back(ReadNodeInfo(ptr, end));
+    }
+  }
+  return response;
+}
+
+// -------------------------------------------
+// MembershipRequest
+// -------------------------------------------
+
+std::vector<std::byte> MembershipRequest::Serialise() const {
+  std::vector<std::byte> buffer;
+  buffer.push_back(static_cast<std::byte>(type_));
+  WriteU64(buffer, since_);
+  return buffer;
+}
+
+MembershipRequest MembershipRequest::Deserialise(std::span<std::byte> data) {
+  if (data.size() < 9) {
+    throw std::runtime_error("truncated membership request");
+  }
+  return MembershipRequest{ReadU64(data.data() + 1)};
+}
+
+// -------------------------------------------
+// MembershipResponse
+// -------------------------------------------
+
+std::vector<std::byte> MembershipResponse::Serialise() const {
+  std::vector<std::byte> buffer;
+  buffer.push_back(static_cast<std::byte>(type_));
+  WriteU64(buffer, delta_.cursor_);
+  buffer.push_back(static_cast<std::byte>(delta_.full_ ? 1 : 0));
+  auto count = static_cast<u16>(
+      std::min(delta_.events_.size(), kMaxEvents));
+  WriteU16(buffer, count);
+  for (u16 i{}; i < count; ++i) {
+    buffer.push_back(static_cast<std::byte>(delta_.events_[i].joined_ ? 1 : 0));
+    WriteNodeInfo(buffer, delta_.events_[i].node_);
+  }
+  return buffer;
+}
+
+MembershipResponse MembershipResponse::Deserialise(std::span<std::byte> data) {
+  if (data.size() < 12) {
+    throw std::runtime_error("truncated membership response");
+  }
+  MembershipResponse response;
+  std::byte* ptr = data.data() + 1;
+  response.delta_.cursor_ = ReadU64(ptr);
+  ptr += 8;
+  response.delta_.full_ = *ptr++ != std::byte{0};
+  u16 count = ReadU16(ptr);
+  ptr += 2;
+  const std::byte* end = data.data() + data.size();
+  response.delta_.events_.reserve(count);
+  for (u16 i{}; i < count; ++i) {
+    if (ptr == end) {
+      throw std::runtime_error("truncated membership response");
+    }
+    bool joined = *ptr++ != std::byte{0};
+    response.delta_.events_.push_back({.node_ = ReadNodeInfo(ptr, end),
+                                       .joined_ = joined});
+  }
+  return response;
+}
+
 // -------------------------------------------
 // GetRequest
 // -------------------------------------------
@@ -252,13 +492,27 @@ std::vector<std::byte> GetRequest::Serialise() const {
   std::vector<std::byte> buffer;
   buffer.push_back(static_cast<std::byte>(type_));
   WriteString(buffer, key_);
+  u8 flags = (accept_compressed_ ? kAcceptCompressed : 0) |
+             (local_ ? kLocal : 0) | (owned_ ? kOwned : 0) |
+             (forwarded_ ? kForwarded : 0);
+  if (flags != 0) {
+    buffer.push_back(static_cast<std::byte>(flags));
+  }
   return buffer;
 }
 
 GetRequest GetRequest::Deserialise(std::span<std::byte> data) {
   GetRequest request;
   std::byte* ptr = data.data() + 1;
-  request.key_ = ReadString(ptr);
+  const std::byte* end = data.data() + data.size();
+  request.key_ = ReadString(ptr, end);
+  if (ptr < end) {
+    auto flags = std::to_integer<u8>(*ptr);
+    request.accept_compressed_ = flags & kAcceptCompressed;
+    request.local_ = flags & kLocal;
+    request.owned_ = flags & kOwned;
+    request.forwarded_ = flags & kForwarded;
+  }
   return request;
 }
 
@@ -269,19 +523,33 @@ GetRequest GetRequest::Deserialise(std::span<std::byte> data) {
 std::vector<std::byte> GetResponse::Serialise() const {
   std::vector<std::byte> buffer;
   buffer.push_back(static_cast<std::byte>(type_));
-  buffer.push_back(found_ ? std::byte{1} : std::byte{0});
+  buffer.push_back(!found_ ? std::byte{0}
+                   : compressed_ ? std::byte{2} : std::byte{1});
   if(found_) {
     WriteString(buffer, value_);
   }
   return buffer;
 }
 
+std::vector<std::byte> GetResponse::SerialiseHeader(u32 value_size,
+                                                    bool compressed) {
+  std::vector<std::byte> buffer;
+  buffer.push_back(static_cast<std::byte>(MessageType::kGetResponse));
+  buffer.push_back(compressed ? std::byte{2} : std::byte{1});
+  WriteU32(buffer, value_size);
+  return buffer;
+}
+
 GetResponse GetResponse::Deserialise(std::span<std::byte> data) {
+  if (data.size() < 2) {
+    throw std::runtime_error("truncated get response");
+  }
   GetResponse response;
   std::byte* ptr = data.data() + 1;
+  response.compressed_ = *ptr == std::byte{2};
   response.found_ = *ptr++ != std::byte{0};
   if(response.found_) {
-    response.value_ = ReadString(ptr);
+    response.value_ = ReadString(ptr, data.data() + data.size());
   }
   return response;
 }
@@ -295,14 +563,35 @@ std::vector<std::byte> PutRequest::Serialise() const {
   buffer.push_back(static_cast<std::byte>(type_));
   WriteString(buffer, key_);
   WriteString(buffer, value_);
+  bool flagged = encoded_ || replica_ || owned_;
+  if (ttl_ms_ != 0 || flagged) {
+    WriteU64(buffer, ttl_ms_);
+  }
+  if (flagged) {
+    buffer.push_back(static_cast<std::byte>(
+        kEncoded | (compressed_ ? kCompressed : 0) |
+        (replica_ ? kReplica : 0) | (owned_ ? kOwned : 0)));
+  }
   return buffer;
 }
 
 PutRequest PutRequest::Deserialise(std::span<std::byte> data) {
   PutRequest request;
   std::byte* ptr = data.data() + 1;
-  request.key_ = ReadString(ptr);
-  request.value_ = ReadString(ptr);
+  const std::byte* end = data.data() + data.size();
+  request.key_ = ReadString(ptr, end);
+  request.value_ = ReadString(ptr, end, kValueSpare);
+  if (ptr + 8 <= end) {
+    request.ttl_ms_ = ReadU64(ptr);
+    ptr += 8;
+  }
+  if (ptr < end) {
+    auto flags = std::to_integer<u8>(*ptr);
+    request.encoded_ = flags & kEncoded;
+    request.compressed_ = flags & kCompressed;
+    request.replica_ = flags & kReplica;
+    request.owned_ = flags & kOwned;
+  }
   return request;
 }
 
@@ -317,7 +606,52 @@ std::vector<std::byte> PutResponse::Serialise() const {
 
 PutResponse PutResponse::Deserialise(std::span<std::byte> data) {
   PutResponse response;
-  response.success_ = (data[1] != std::byte{0});
+  response.success_ = data.size() > 1 && data[1] != std::byte{0};
+  return response;
+}
+
+// -------------------------------------------
+// DeleteRequest
+// -------------------------------------------
+
+std::vector<std::byte> DeleteRequest::Serialise() const {
+  std::vector<std::byte> buffer;
+  buffer.push_back(static_cast<std::byte>(type_));
+  WriteString(buffer, key_);
+  u8 flags = (local_ ? kLocal : 0) | (owned_ ? kOwned : 0) |
+             (forwarded_ ? kForwarded : 0);
+  if (flags != 0) {
+    buffer.push_back(static_cast<std::byte>(flags));
+  }
+  return buffer;
+}
+
+DeleteRequest DeleteRequest::Deserialise(std::span<std::byte> data) {
+  DeleteRequest request;
+  std::byte* ptr = data.data() + 1;
+  const std::byte* end = data.data() + data.size();
+  request.key_ = ReadString(ptr, end);
+  if (ptr < end) {
+    auto flags = std::to_integer<u8>(*ptr);
+    request.local_ = flags & kLocal;
+    request.owned_ = flags & kOwned;
+    request.forwarded_ = flags & kForwarded;
+  }
+  return request;
+}
+
+// -------------------------------------------
+// DeleteResponse
+// -------------------------------------------
+
+std::vector<std::byte> DeleteResponse::Serialise() const {
+  return {static_cast<std::byte>(type_),
+    static_cast<std::byte>(removed_ ? 1 : 0)};
+}
+
+DeleteResponse DeleteResponse::Deserialise(std::span<std::byte> data) {
+  DeleteResponse response;
+  response.removed_ = data.size() > 1 && data[1] != std::byte{0};
   return response;
 }
 
@@ -328,17 +662,36 @@ PutResponse PutResponse::Deserialise(std::span<std::byte> data) {
 std::vector<std::byte> TransferKeysRequest::Serialise() const {
   std::vector<std::byte> buffer;
   buffer.push_back(static_cast<std::byte>(type_));
-  WriteU32(buffer, start_);
-  WriteU32(buffer, end_);
+  WriteId(buffer, start_);
+  WriteId(buffer, end_);
+  // older readers stop after the range
+  if (mover_ || limit_ != 0) {
+    buffer.push_back(static_cast<std::byte>(mover_ ? 1 : 0));
+    WriteU32(buffer, limit_);
+  }
+  if (mover_) {
+    WriteNodeInfo(buffer, *mover_);
+  }
   return buffer;
 }
 
 TransferKeysRequest TransferKeysRequest::Deserialise(
     std::span<std::byte> data) {
+  constexpr size_t kRange = 1 + 2 * kIdBytes;
+  if (data.size() < kRange) {
+    throw std::runtime_error("truncated transfer keys request");
+  }
   TransferKeysRequest request;
-  request.start_ = ReadU32(data.data() + 1);
-  // this might be an issue...
-  request.end_ = ReadU32(data.data() + 5);
+  request.start_ = ReadId(data.data() + 1);
+  request.end_ = ReadId(data.data() + 1 + kIdBytes);
+  if (data.size() >= kRange + 5) {
+    bool move = data[kRange] != std::byte{0};
+    request.limit_ = ReadU32(data.data() + kRange + 1);
+    if (move) {
+      std::byte* ptr = data.data() + kRange + 5;
+      request.mover_ = ReadNodeInfo(ptr, data.data() + data.size());
+    }
+  }
   return request;
 }
 
@@ -359,18 +712,256 @@ std::vector<std::byte> TransferKeysResponse::Serialise() const {
 
 TransferKeysResponse TransferKeysResponse::Deserialise(
     std::span<std::byte> data) {
+  if (data.size() < 5) {
+    throw std::runtime_error("truncated transfer keys response");
+  }
   TransferKeysResponse response;
   std::byte* ptr = data.data() + 1;
+  const std::byte* end = data.data() + data.size();
   u32 count = ReadU32(ptr);
   ptr += 4;
   for(u32 i{}; i < count; ++i) {
-    std::string key = ReadString(ptr);
-    std::string value = ReadString(ptr);
+    std::string key = ReadString(ptr, end);
+    std::string value = ReadString(ptr, end);
     response.keys_.emplace_back(key, value);
   }
   return response;
 }
 
+// -------------------------------------------
+// MerkleRequest
+// -------------------------------------------
+
+std::vector<std::byte> MerkleRequest::Serialise() const {
+  std::vector<std::byte> buffer;
+  buffer.push_back(static_cast<std::byte>(type_));
+  buffer.push_back(static_cast<std::byte>(level_));
+  WriteU32(buffer, static_cast<u32>(indices_.size()));
+  for (u32 index : indices_) {
+    WriteU32(buffer, index);
+  }
+  return buffer;
+}
+
+MerkleRequest MerkleRequest::Deserialise(std::span<std::byte> data) {
+  if (data.size() < 6) {
+    throw std::runtime_error("bad merkle request");
+  }
+  MerkleRequest request;
+  request.level_ = std::to_integer<u8>(data[1]);
+  u32 count = ReadU32(data.data() + 2);
+  if (count > kMaxIndices || data.size() < 6 + size_t{count} * 4) {
+    throw std::runtime_error("bad merkle request");
+  }
+  const std::byte* ptr = data.data() + 6;
+  for (u32 i{}; i < count; ++i) {
+    request.indices_.push_back(ReadU32(ptr));
+    ptr += 4;
+  }
+  return request;
+}
+
+// -------------------------------------------
+// MerkleResponse
+// -------------------------------------------
+
+std::vector<std::byte> MerkleResponse::Serialise() const {
+  std::vector<std::byte> buffer;
+  buffer.push_back(static_cast<std::byte>(type_));
+  WriteU32(buffer, static_cast<u32>(hashes_.size()));
+  for (u64 hash : hashes_) {
+    WriteU64(buffer, hash);
+  }
+  return buffer;
+}
+
+MerkleResponse MerkleResponse::Deserialise(std::span<std::byte> data) {
+  if (data.size() < 5) {
+    throw std::runtime_error("truncated merkle response");
+  }
+  MerkleResponse response;
+  u32 count = ReadU32(data.data() + 1);
+  if (data.size() < 5 + size_t{count} * 8) {
+    throw std::runtime_error("truncated merkle response");
+  }
+  const std::byte* ptr = data.data() + 5;
+  for (u32 i{}; i < count; ++i) {
+    response.hashes_.push_back(ReadU64(ptr));
+    ptr += 8;
+  }
+  return response;
+}
+
+// -------------------------------------------
+// ReplicateRequest
+// -------------------------------------------
+
+std::vector<std::byte> ReplicateRequest::Serialise() const {
+  std::vector<std::byte> buffer;
+  buffer.push_back(static_cast<std::byte>(type_));
+  WriteId(buffer, start_);
+  WriteId(buffer, end_);
+  WriteNodeInfo(buffer, source_);
+  if (adopt_) {
+    buffer.push_back(std::byte{1});
+  }
+  return buffer;
+}
+
+ReplicateRequest ReplicateRequest::Deserialise(std::span<std::byte> data) {
+  // type, start, end, then a node info of at least id, ip length, port and
+  // virtual node
+  constexpr size_t kFixed = 1 + 3 * kIdBytes + 4 + 2 + 1;
+  if (data.size() < kFixed) {
+    throw std::runtime_error("truncated replicate request");
+  }
+  ReplicateRequest request;
+  std::byte* ptr = data.data() + 1;
+  request.start_ = ReadId(ptr);
+  request.end_ = ReadId(ptr + kIdBytes);
+  ptr += 2 * kIdBytes;
+  size_t end = kFixed + size_t{ReadU32(ptr + kIdBytes)};
+  if (data.size() < end) {
+    throw std::runtime_error("truncated replicate request");
+  }
+  request.source_ = ReadNodeInfo(ptr, data.data() + data.size());
+  request.adopt_ = data.size() > end && data[end] != std::byte{0};
+  return request;
+}
+
+// -------------------------------------------
+// ReplicateResponse
+// -------------------------------------------
+
+std::vector<std::byte> ReplicateResponse::Serialise() const {
+  std::vector<std::byte> buffer;
+  buffer.push_back(static_cast<std::byte>(type_));
+  buffer.push_back(synced_ ? std::byte{1} : std::byte{0});
+  WriteU32(buffer, pulled_);
+  return buffer;
+}
+
+ReplicateResponse ReplicateResponse::Deserialise(std::span<std::byte> data) {
+  if (data.size() < 6) {
+    throw std::runtime_error("truncated replicate response");
+  }
+  ReplicateResponse response;
+  response.synced_ = data[1] != std::byte{0};
+  response.pulled_ = ReadU32(data.data() + 2);
+  return response;
+}
+
+// -------------------------------------------
+// LoadRequest
+// -------------------------------------------
+
+std::vector<std::byte> LoadRequest::Serialise() const {
+  std::vector<std::byte> buffer;
+  buffer.push_back(static_cast<std::byte>(type_));
+  WriteU64(buffer, load_.keys_);
+  WriteU32(buffer, load_.requests_);
+  WriteNodeInfo(buffer, sender_);
+  return buffer;
+}
+
+LoadRequest LoadRequest::Deserialise(std::span<std::byte> data) {
+  // type, keys, requests, then the sender's node info
+  constexpr size_t kFixed = 1 + 8 + 4 + kIdBytes + 4 + 2 + 1;
+  if (data.size() < kFixed) {
+    throw std::runtime_error("truncated load request");
+  }
+  LoadRequest request;
+  std::byte* ptr = data.data() + 1;
+  request.load_.keys_ = ReadU64(ptr);
+  request.load_.requests_ = ReadU32(ptr + 8);
+  ptr += 12;
+  if (data.size() < kFixed + size_t{ReadU32(ptr + kIdBytes)}) {
+    throw std::runtime_error("truncated load request");
+  }
+  request.sender_ = ReadNodeInfo(ptr, data.data() + data.size());
+  return request;
+}
+
+// -------------------------------------------
+// LoadResponse
+// -------------------------------------------
+
+std::vector<std::byte> LoadResponse::Serialise() const {
+  std::vector<std::byte> buffer;
+  buffer.push_back(static_cast<std::byte>(type_));
+  WriteU64(buffer, load_.keys_);
+  WriteU32(buffer, load_.requests_);
+  return buffer;
+}
+
+LoadResponse LoadResponse::Deserialise(std::span<std::byte> data) {
+  if (data.size() < 13) {
+    throw std::runtime_error("truncated load response");
+  }
+  LoadResponse response;
+  response.load_.keys_ = ReadU64(data.data() + 1);
+  response.load_.requests_ = ReadU32(data.data() + 9);
+  return response;
+}
+
+// -------------------------------------------
+// LeaveRequest
+// -------------------------------------------
+
+std::vector<std::byte> LeaveRequest::Serialise() const {
+  std::vector<std::byte> buffer;
+  buffer.push_back(static_cast<std::byte>(type_));
+  WriteId(buffer, start_);
+  buffer.push_back(heir_ ? std::byte{1} : std::byte{0});
+  WriteNodeInfo(buffer, node_);
+  WriteNodeInfo(buffer, successor_);
+  if (predecessor_) {
+    WriteNodeInfo(buffer, *predecessor_);
+  }
+  return buffer;
+}
+
+LeaveRequest LeaveRequest::Deserialise(std::span<std::byte> data) {
+  if (data.size() < 2 + kIdBytes) {
+    throw std::runtime_error("truncated leave request");
+  }
+  LeaveRequest request;
+  std::byte* ptr = data.data() + 1;
+  request.start_ = ReadId(ptr);
+  ptr += kIdBytes;
+  request.heir_ = *ptr++ != std::byte{0};
+
+  const std::byte* end = data.data() + data.size();
+  request.node_ = ReadNodeInfo(ptr, end);
+  request.successor_ = ReadNodeInfo(ptr, end);
+  if (ptr < end) {
+    request.predecessor_ = ReadNodeInfo(ptr, end);
+  }
+  return request;
+}
+
+// -------------------------------------------
+// LeaveResponse
+// -------------------------------------------
+
+std::vector<std::byte> LeaveResponse::Serialise() const {
+  std::vector<std::byte> buffer;
+  buffer.push_back(static_cast<std::byte>(type_));
+  buffer.push_back(accepted_ ? std::byte{1} : std::byte{0});
+  WriteU32(buffer, pulled_);
+  return buffer;
+}
+
+LeaveResponse LeaveResponse::Deserialise(std::span<std::byte> data) {
+  if (data.size() < 6) {
+    throw std::runtime_error("truncated leave response");
+  }
+  LeaveResponse response;
+  response.accepted_ = data[1] != std::byte{0};
+  response.pulled_ = ReadU32(data.data() + 2);
+  return response;
+}
+
 // -------------------------------------------
 // ErrorResponse
 // -------------------------------------------
@@ -385,7 +976,7 @@ std::vector<std::byte> ErrorResponse::Serialise() const {
 ErrorResponse ErrorResponse::Deserialise(std::span<std::byte> data) {
   ErrorResponse response;
   std::byte* ptr = data.data() + 1;
-  response.error_message_ = ReadString(ptr);
+  response.error_message_ = ReadString(ptr, data.data() + data.size());
   return response;
 }
 
@@ -396,4 +987,104 @@ Result<MessageType> GetMessageType(std::span<std::byte> data) {
   return static_cast<MessageType>(data[0]);
 }
 
+bool Complete(std::span<const std::byte> data) {
+  if (!data.empty() &&
+      static_cast<MessageType>(data[0]) == MessageType::kVNodeEnvelope) {
+    if (data.size() < 3) {
+      return false;
+    }
+    data = data.subspan(2);
+  }
+  if (data.empty()) {
+    return false;
+  }
+
+  size_t at = 1;
+  auto need = [&](size_t bytes) {
+    if (data.size() - at < bytes) {
+      return false;
+    }
+    at += bytes;
+    return true;
+  };
+  auto string = [&] {
+    return data.size() - at >= 4 &&
+           need(4 + size_t{ReadU32(data.data() + at)});
+  };
+  // id, ip, port, vnode
+  auto node = [&] { return need(kIdBytes) && string() && need(3); };
+
+  switch (static_cast<MessageType>(data[0])) {
+    case MessageType::kFindSuccessorRequest:
+      return need(kIdBytes + 1) && (data[at - 1] == std::byte{0} || node());
+    case MessageType::kNotify:
+      return node();
+    case MessageType::kNextHopRequest:
+      return need(kIdBytes);
+    case MessageType::kMembershipRequest:
+      return need(8);
+    case MessageType::kGetRequest:
+    case MessageType::kDeleteRequest:
+      return string();
+    case MessageType::kPutRequest:
+      return string() && string();
+    case MessageType::kTransferKeysRequest:
+      // a move carries the mover, a copy may end after the range
+      return need(2 * kIdBytes) &&
+             (data.size() - at < 5 || data[at] == std::byte{0} ||
+              (need(5) && node()));
+    case MessageType::kMerkleRequest: {
+      if (!need(5)) {
+        return false;
+      }
+      // too many is refused by Deserialise, there is nothing to wait for
+      u32 count = ReadU32(data.data() + 2);
+      return count > MerkleRequest::kMaxIndices || need(size_t{count} * 4);
+    }
+    case MessageType::kReplicateRequest:
+      return need(2 * kIdBytes) && node();
+    case MessageType::kLoadRequest:
+      return need(12) && node();
+    case MessageType::kLeaveRequest:
+      return need(kIdBytes + 1) && node() && node();
+    case MessageType::kFrame:
+      // a frame header still being read, FramedSize delimits the rest
+      return false;
+    default:
+      return true;
+  }
+}
+
+std::vector<std::byte> RequestHeader(u8 vnode, size_t request_size) {
+  std::vector<std::byte> header;
+  header.push_back(static_cast<std::byte>(MessageType::kFrame));
+  WriteU32(header, static_cast<u32>(request_size + (vnode != 0 ? 2 : 0)));
+  if (vnode != 0) {
+    header.push_back(static_cast<std::byte>(MessageType::kVNodeEnvelope));
+    header.push_back(static_cast<std::byte>(vnode));
+  }
+  return header;
+}
+
+std::optional<size_t> FramedSize(std::span<const std::byte> data) {
+  if (data.size() < kFrameHeader ||
+      static_cast<MessageType>(data[0]) != MessageType::kFrame) {
+    return std::nullopt;
+  }
+  return kFrameHeader + size_t{ReadU32(data.data() + 1)};
+}
+
+Result<u8> UnwrapVNode(std::span<std::byte>& data) {
+  if (data.empty() ||
+      static_cast<MessageType>(data[0]) != MessageType::kVNodeEnvelope) {
+    return 0;
+  }
+  if (data.size() < 3) {
+    return std::unexpected("truncated vnode envelope");
+  }
+  auto vnode = std::to_integer<u8>(data[1]);
+  data = data.subspan(2);
+  return vnode;
+}
+
 } // namespace tsc::msg
\ No newline at end of file
@@ -19,6 +19,14 @@ enum class MessageType : u8 {
   kNotifyAck = 0x06,
   kPing = 0x07,
   kPong = 0x08,
+  kGetSuccessorListRequest = 0x09,
+  kGetSuccessorListResponse = 0x0A,
+  kNextHopRequest = 0x0B,
+  kNextHopResponse = 0x0C,
+  kMembershipRequest = 0x0D,
+  kMembershipResponse = 0x0E,
+  // not a message of its own, see RequestHeader
+  kVNodeEnvelope = 0x0F,
 
   kGetRequest = 0x10,
   kGetResponse = 0x11,
@@ -29,7 +37,17 @@ enum class MessageType : u8 {
 
   kTransferKeysRequest = 0x20,
   kTransferKeysResponse = 0x21,
-
+  kMerkleRequest = 0x22,
+  kMerkleResponse = 0x23,
+  kReplicateRequest = 0x24,
+  kReplicateResponse = 0x25,
+  kLoadRequest = 0x26,
+  kLoadResponse = 0x27,
+  kLeaveRequest = 0x28,
+  kLeaveResponse = 0x29,
+
+  // not a message of its own either, see RequestHeader
+  kFrame = 0xFE,
   kErrorResponse = 0xFF,
 };
 
@@ -118,9 +136,91 @@ struct PongMessage : Message {
   static PongMessage Deserialise(std::span<std::byte> data);
 };
 
+struct GetSuccessorListRequest : Message {
+  GetSuccessorListRequest() { type_ = MessageType::kGetSuccessorListRequest; }
+
+  [[nodiscard]] std::vector<std::byte> Serialise() const override;
+  static GetSuccessorListRequest Deserialise(std::span<std::byte> data);
+};
+
+// nearest first, starting with the responder's own successor
+struct GetSuccessorListResponse : Message {
+  GetSuccessorListResponse() {
+    type_ = MessageType::kGetSuccessorListResponse;
+  }
+
+  [[nodiscard]] std::vector<std::byte> Serialise() const override;
+  static GetSuccessorListResponse Deserialise(std::span<std::byte> data);
+
+  std::vector<NodeInfo> successors_;
+
+  // more than any sane list size, keeps a bad count from allocating
+  static constexpr u8 kMaxEntries = 32;
+};
+
+// one step of an iterative lookup, answered from the responder's own
+// tables without any calls of its own
+struct NextHopRequest : Message {
+  NextHopRequest() { type_ = MessageType::kNextHopRequest; }
+  explicit NextHopRequest(NodeID id, u8 more = 0) : id_(id), more_(more) {
+    type_ = MessageType::kNextHopRequest;
+  }
+
+  [[nodiscard]] std::vector<std::byte> Serialise() const override;
+  static NextHopRequest Deserialise(std::span<std::byte> data);
+
+  NodeID id_;
+  // extra candidates wanted besides the next hop, sent only if nonzero
+  u8 more_{0};
+};
+
+struct NextHopResponse : Message {
+  enum Flags : u8 {
+    kFound = 1 << 0,
+    kFinal = 1 << 1,
+  };
+
+  NextHopResponse() { type_ = MessageType::kNextHopResponse; }
+
+  [[nodiscard]] std::vector<std::byte> Serialise() const override;
+  static NextHopResponse Deserialise(std::span<std::byte> data);
+
+  // empty when the responder has no successor yet
+  std::optional<LookupHop> hop_;
+
+  static constexpr size_t kMaxMore = 16;
+};
+
+// pull of the responder's membership changes for one hop routing
+struct MembershipRequest : Message {
+  MembershipRequest() { type_ = MessageType::kMembershipRequest; }
+  explicit MembershipRequest(u64 since) : since_(since) {
+    type_ = MessageType::kMembershipRequest;
+  }
+
+  [[nodiscard]] std::vector<std::byte> Serialise() const override;
+  static MembershipRequest Deserialise(std::span<std::byte> data);
+
+  // the cursor from the last response, 0 asks for everything
+  u64 since_{0};
+};
+
+struct MembershipResponse : Message {
+  MembershipResponse() { type_ = MessageType::kMembershipResponse; }
+
+  [[nodiscard]] std::vector<std::byte> Serialise() const override;
+  static MembershipResponse Deserialise(std::span<std::byte> data);
+
+  MembershipDelta delta_;
+
+  static constexpr size_t kMaxEvents = 0xFFFF;
+};
+
 struct GetRequest : Message {
   GetRequest() { type_ = MessageType::kGetRequest; }
-  explicit GetRequest(const std::string& key) : key_(key) {
+  explicit GetRequest(std::string key, bool accept_compressed = false)
+    : key_(std::move(key))
+    , accept_compressed_(accept_compressed) {
     type_ = MessageType::kGetRequest;
   }
 
@@ -128,6 +228,23 @@ struct GetRequest : Message {
   static GetRequest Deserialise(std::span<std::byte> data);
 
   std::string key_;
+  // optional trailing byte of kAcceptCompressed/kLocal/kOwned/kForwarded
+  // bits. nodes set it, plain clients leave it off and always get the value
+  // expanded
+  bool accept_compressed_{false};
+  // answer from local storage instead of routing, for quorum reads
+  bool local_{false};
+  // the sender thinks the receiver owns the key, from its location cache.
+  // answered locally, or with an ErrorResponse if the key is not ours
+  bool owned_{false};
+  // passed on by a node whose arc is changing hands. answered from storage
+  // only, so the two sides never bounce a miss between them
+  bool forwarded_{false};
+
+  static constexpr u8 kAcceptCompressed = 1 << 0;
+  static constexpr u8 kLocal = 1 << 1;
+  static constexpr u8 kOwned = 1 << 2;
+  static constexpr u8 kForwarded = 1 << 3;
 };
 
 struct GetResponse : Message {
@@ -136,15 +253,24 @@ struct GetResponse : Message {
   [[nodiscard]] std::vector<std::byte> Serialise() const override;
   static GetResponse Deserialise(std::span<std::byte> data);
 
+  // a found response up to (not including) the value bytes, so a caller
+  // holding the value in a shared buffer can send it straight after
+  static std::vector<std::byte> SerialiseHeader(u32 value_size,
+                                                bool compressed = false);
+
   std::string value_;
+  // on the wire the found byte is 0 missing, 1 plain, 2 compressed. only
+  // requests that accept compressed values ever see a 2.
   bool found_;
+  bool compressed_{false};
 };
 
 struct PutRequest : Message {
   PutRequest() { type_ = MessageType::kPutRequest; }
-  PutRequest(const std::string& key, const std::string& value)
-    : key_(key)
-    , value_(value)
+  PutRequest(std::string key, std::string value, u64 ttl_ms = 0)
+    : key_(std::move(key))
+    , value_(std::move(value))
+    , ttl_ms_(ttl_ms)
   { type_ = MessageType::kPutRequest; }
 
   [[nodiscard]] std::vector<std::byte> Serialise() const override;
@@ -152,6 +278,29 @@ struct PutRequest : Message {
 
   std::string key_;
   std::string value_;
+  // optional trailing fields, u64 ttl then a u8 of kEncoded/kCompressed
+  // bits. each is only written when it or a later one is set
+  u64 ttl_ms_{0};
+  // set by nodes: the value already went through a ValueCodec and must not
+  // be looked at again, compressed_ says which way it came out
+  bool encoded_{false};
+  bool compressed_{false};
+  // store on the receiver without routing, it is one of the key's replicas.
+  // implies encoded_
+  bool replica_{false};
+  // store on the receiver if it owns the key, refuse with an ErrorResponse
+  // otherwise. implies encoded_
+  bool owned_{false};
+
+  static constexpr u8 kEncoded = 1 << 0;
+  static constexpr u8 kCompressed = 1 << 1;
+  static constexpr u8 kReplica = 1 << 2;
+  static constexpr u8 kOwned = 1 << 3;
+
+  // Deserialise leaves this much spare capacity behind value_, so the
+  // receiver can append a small trailer (storage seals records that way)
+  // and move the buffer on without it ever being reallocated
+  static constexpr size_t kValueSpare = 16;
 };
 
 struct PutResponse : Message {
@@ -163,6 +312,36 @@ struct PutResponse : Message {
   bool success_;
 };
 
+struct DeleteRequest : Message {
+  DeleteRequest() { type_ = MessageType::kDeleteRequest; }
+  explicit DeleteRequest(std::string key) : key_(std::move(key)) {
+    type_ = MessageType::kDeleteRequest;
+  }
+
+  [[nodiscard]] std::vector<std::byte> Serialise() const override;
+  static DeleteRequest Deserialise(std::span<std::byte> data);
+
+  std::string key_;
+  // optional trailing byte of kLocal/kOwned/kForwarded bits, same meaning
+  // as on a GetRequest
+  bool local_{false};
+  bool owned_{false};
+  bool forwarded_{false};
+
+  static constexpr u8 kLocal = 1 << 0;
+  static constexpr u8 kOwned = 1 << 1;
+  static constexpr u8 kForwarded = 1 << 2;
+};
+
+struct DeleteResponse : Message {
+  DeleteResponse() { type_ = MessageType::kDeleteResponse; }
+
+  [[nodiscard]] std::vector<std::byte> Serialise() const override;
+  static DeleteResponse Deserialise(std::span<std::byte> data);
+
+  bool removed_;
+};
+
 struct TransferKeysRequest : Message {
   TransferKeysRequest() { type_ = MessageType::kTransferKeysRequest; }
 
@@ -171,8 +350,14 @@ struct TransferKeysRequest : Message {
 
   NodeID start_;
   NodeID end_;
+  // hand the records over to mover_, the node asking, instead of copying
+  // them. see Node::HandOverRange
+  std::optional<NodeInfo> mover_;
+  // records per reply, 0 for all of them
+  u32 limit_{0};
 };
 
+// values are encoded records (node/record.h), not plain values
 struct TransferKeysResponse : Message {
   TransferKeysResponse() { type_ = MessageType::kTransferKeysResponse; }
 
@@ -182,6 +367,125 @@ struct TransferKeysResponse : Message {
   std::vector<std::pair<std::string, std::string>> keys_;
 };
 
+// asks for the digests of a batch of merkle tree nodes on one level
+struct MerkleRequest : Message {
+  // keeps a request inside the server's single read
+  static constexpr size_t kMaxIndices = 512;
+
+  MerkleRequest() { type_ = MessageType::kMerkleRequest; }
+  MerkleRequest(u8 level, std::vector<u32> indices)
+    : level_(level)
+    , indices_(std::move(indices)) {
+    type_ = MessageType::kMerkleRequest;
+  }
+
+  [[nodiscard]] std::vector<std::byte> Serialise() const override;
+  static MerkleRequest Deserialise(std::span<std::byte> data);
+
+  u8 level_;
+  std::vector<u32> indices_;
+};
+
+// one digest per requested index, in request order
+struct MerkleResponse : Message {
+  MerkleResponse() { type_ = MessageType::kMerkleResponse; }
+
+  [[nodiscard]] std::vector<std::byte> Serialise() const override;
+  static MerkleResponse Deserialise(std::span<std::byte> data);
+
+  std::vector<u64> hashes_;
+};
+
+// asks a replica to bring (start_, end_] in line with source_, the range's
+// owner. the replica pulls whatever differs with the usual merkle walk.
+//
+// with adopt_ the receiver, a ring neighbour of source_, also takes the
+// range over from it, see Node::AdoptRange. sent as a trailing flag byte.
+struct ReplicateRequest : Message {
+  ReplicateRequest() { type_ = MessageType::kReplicateRequest; }
+  ReplicateRequest(KeyID start, KeyID end, const NodeInfo& source,
+                   bool adopt = false)
+    : start_(start)
+    , end_(end)
+    , source_(source)
+    , adopt_(adopt) {
+    type_ = MessageType::kReplicateRequest;
+  }
+
+  [[nodiscard]] std::vector<std::byte> Serialise() const override;
+  static ReplicateRequest Deserialise(std::span<std::byte> data);
+
+  KeyID start_;
+  KeyID end_;
+  NodeInfo source_;
+  bool adopt_{false};
+};
+
+struct ReplicateResponse : Message {
+  ReplicateResponse() { type_ = MessageType::kReplicateResponse; }
+
+  [[nodiscard]] std::vector<std::byte> Serialise() const override;
+  static ReplicateResponse Deserialise(std::span<std::byte> data);
+
+  bool synced_{false};
+  u32 pulled_{0};
+};
+
+// a node's load, sent to its successor every stabilise round when
+// rebalancing. the successor answers with its own
+struct LoadRequest : Message {
+  LoadRequest() { type_ = MessageType::kLoadRequest; }
+  LoadRequest(const NodeInfo& sender, const LoadSummary& load)
+    : sender_(sender)
+    , load_(load) {
+    type_ = MessageType::kLoadRequest;
+  }
+
+  [[nodiscard]] std::vector<std::byte> Serialise() const override;
+  static LoadRequest Deserialise(std::span<std::byte> data);
+
+  NodeInfo sender_;
+  LoadSummary load_;
+};
+
+struct LoadResponse : Message {
+  LoadResponse() { type_ = MessageType::kLoadResponse; }
+
+  [[nodiscard]] std::vector<std::byte> Serialise() const override;
+  static LoadResponse Deserialise(std::span<std::byte> data);
+
+  LoadSummary load_;
+};
+
+// node_ is leaving the ring. the receiver, one of its neighbours, links up
+// with whoever is on node_'s other side: predecessor_ if node_ was its
+// predecessor, successor_ if node_ was its successor.
+//
+// with heir_ the receiver also takes node_'s records in (start_, node_]
+// over, pulling them off it in batches before it answers
+struct LeaveRequest : Message {
+  LeaveRequest() { type_ = MessageType::kLeaveRequest; }
+
+  [[nodiscard]] std::vector<std::byte> Serialise() const override;
+  static LeaveRequest Deserialise(std::span<std::byte> data);
+
+  NodeInfo node_;
+  std::optional<NodeInfo> predecessor_;
+  NodeInfo successor_;
+  KeyID start_{};
+  bool heir_{false};
+};
+
+struct LeaveResponse : Message {
+  LeaveResponse() { type_ = MessageType::kLeaveResponse; }
+
+  [[nodiscard]] std::vector<std::byte> Serialise() const override;
+  static LeaveResponse Deserialise(std::span<std::byte> data);
+
+  bool accepted_{false};
+  u32 pulled_{0};
+};
+
 struct ErrorResponse : Message {
   ErrorResponse() { type_ = MessageType::kErrorResponse; }
   explicit ErrorResponse(const std::string& msg) : error_message_(msg) {
@@ -195,6 +499,27 @@ struct ErrorResponse : Message {
 };
 
 Result<MessageType> GetMessageType(std::span<std::byte> data);
+
+// a request from another node goes out framed: kFrame, the length of
+// everything after the five header bytes, then the request. one for virtual
+// node vnode has kVNodeEnvelope and the vnode ahead of the request, inside
+// the frame; vnode 0 goes without. this is what goes ahead of a request of
+// request_size bytes
+constexpr size_t kFrameHeader = 5;
+std::vector<std::byte> RequestHeader(u8 vnode, size_t request_size);
+
+// for a framed request, its whole size, header included, once the header is
+// in. nullopt before that or for a bare request
+std::optional<size_t> FramedSize(std::span<const std::byte> data);
+
+// plain clients send bare requests, which carry no length of their own. this
+// is true once data holds every field its request declares, vnode envelope
+// included. trailing fields a request may also end without, like a put's
+// ttl, cannot be waited for, which is why nodes frame theirs
+bool Complete(std::span<const std::byte> data);
+
+// takes the envelope off data, if there is one, and returns the vnode
+Result<u8> UnwrapVNode(std::span<std::byte>& data);
 std::vector<std::byte> ReadMessagePayload(std::span<std::byte> data);
 
 } // namespace tsc::msg
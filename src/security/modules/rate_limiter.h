@@ -22,7 +22,7 @@ public:
 
     std::lock_guard lock(mutex_);
     auto now = std::chrono::steady_clock::now();
-    auto& bucket = buckets_[sender.ip_];
+    auto& bucket = buckets_[IpKey(sender)];
 
     // Initialise new bucket
     if (bucket.tokens < 0) {
@@ -92,8 +92,16 @@ private:
     std::chrono::steady_clock::time_point last_refill;
   };
 
+  // packed ipv4, or a hash of anything else with the top bit set
+  static u64 IpKey(const NodeAddress& address) {
+    if (auto ip = address.Ipv4()) {
+      return *ip;
+    }
+    return std::hash<std::string>{}(address.ip_) | u64{1} << 63;
+  }
+
   Config config_;
-  std::unordered_map<std::string, TokenBucket> buckets_;
+  std::unordered_map<u64, TokenBucket> buckets_;
   mutable std::mutex mutex_;
   std::atomic<u64> allowed_count_{0};
   std::atomic<u64> throttled_count_{0};
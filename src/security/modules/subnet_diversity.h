@@ -13,9 +13,8 @@ public:
     : max_per_subnet_(max_per_subnet) {}
 
   bool AllowNode(const NodeInfo& node) override {
-    std::string subnet = ExtractSubnet(node.address_.ip_);
     std::lock_guard lock(mutex_);
-    auto& ids = subnet_counts_[subnet];
+    auto& ids = subnet_counts_[SubnetKey(node.address_)];
 
     if (ids.contains(node.id_)) {
       return true;
@@ -25,7 +24,7 @@ public:
       ++rejected_count_;
       over_limit_ids_.insert(node.id_);
       std::cerr << "[SubnetDiversity] Rejected node " << node.id_
-                << " from subnet " << subnet
+                << " from subnet " << ExtractSubnet(node.address_.ip_)
                 << " (count " << ids.size() << " >= max " << max_per_subnet_
                 << ")\n";
       return false;
@@ -56,9 +55,8 @@ public:
   }
 
   void NodeRemoved(const NodeInfo& node) {
-    std::string subnet = ExtractSubnet(node.address_.ip_);
     std::lock_guard lock(mutex_);
-    auto it = subnet_counts_.find(subnet);
+    auto it = subnet_counts_.find(SubnetKey(node.address_));
     if (it != subnet_counts_.end()) {
       it->second.erase(node.id_);
     }
@@ -95,8 +93,17 @@ private:
     return ip.substr(0, last_dot);
   }
 
+  // the /24 of an ipv4 address, or a hash of ExtractSubnet with the top
+  // bit set for anything else
+  static u64 SubnetKey(const NodeAddress& address) {
+    if (auto ip = address.Ipv4()) {
+      return *ip >> 8;
+    }
+    return std::hash<std::string>{}(ExtractSubnet(address.ip_)) | u64{1} << 63;
+  }
+
   int max_per_subnet_{};
-  std::unordered_map<std::string, std::unordered_set<NodeID>> subnet_counts_;
+  std::unordered_map<u64, std::unordered_set<NodeID>> subnet_counts_;
   std::unordered_set<NodeID> over_limit_ids_;
   mutable std::mutex mutex_;
   std::atomic<u64> accepted_count_{0};
@@ -8,16 +8,13 @@
 
 #include "types/types.h"
 #include "protocol/message.h"
+#include "util/metrics.h"
 
 namespace tsc::sec {
 using namespace tsc::type;
 using namespace tsc::msg;
 
-struct SecurityMetrics {
-  std::string module_name;
-  std::vector<std::pair<std::string, u64>> counters;
-  std::vector<std::pair<std::string, double>> gauges;
-};
+using SecurityMetrics = util::ModuleMetrics;
 
 // virtual class for security methods to inherit
 class ISecurityModule {
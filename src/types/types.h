@@ -1,9 +1,13 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+#include <charconv>
 #include <cstdint>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <expected>
+#include <memory>
 #include <vector>
 
 namespace tsc::type {
@@ -20,25 +24,81 @@ using i32 = std::int32_t;
 using i64 = std::int64_t;
 using i128 = __int128_t;
 
-using NodeID = u32;
-using KeyID = u32;
+// number of bits in the identifier space.
+// 32-bits will give us 4 billion possible ID's
+// the original chord paper uses 160 bits for identifier
+// space however this is overkill for the project and would
+// require too much compute to even demonstrate.
+//
+// rings with millions of keys or thousands of virtual nodes start to see
+// 32 bit collisions, those can build with -DTSC_ID_BITS=64. every node in
+// a ring has to agree, the width is part of the wire format
+#ifndef TSC_ID_BITS
+#define TSC_ID_BITS 32
+#endif
+constexpr int kMBits = TSC_ID_BITS;
+
+template <int Bits>
+struct IdWidth {
+  // wider ids would need hashing, printing and parsing for a type the
+  // standard library does not cover
+  static_assert(Bits == 32 || Bits == 64, "TSC_ID_BITS must be 32 or 64");
+};
+
+template <>
+struct IdWidth<32> {
+  using Type = u32;
+};
+
+template <>
+struct IdWidth<64> {
+  using Type = u64;
+};
+
+using NodeID = IdWidth<kMBits>::Type;
+using KeyID = NodeID;
+
+constexpr NodeID kMaxID = ~NodeID{0};
 
 template<typename T>
 using Result = std::expected<T, std::string>;
 
 using KeySet = std::vector<std::pair<std::string, std::string>>;
 
-// number of bits in the identifier space.
-// 32-bits will give us 4 billion possible ID's
-// the original chord paper uses 160 bits for identifier
-// space however this is overkill for the project and would
-// require too much compute to even demonstrate.
-constexpr int kMBits = 32;
-constexpr int kMaxID = UINT32_MAX;
+// immutable, reference counted value buffer shared between storage and readers
+using ValueRef = std::shared_ptr<const std::string>;
+
+// part of a shared buffer, e.g. a stored value minus its record header.
+// view_ stays valid for as long as buffer_ is held. compressed_ means view_
+// holds util::lz output rather than the value itself.
+struct ValueSlice {
+  ValueSlice() = default;
+  explicit ValueSlice(ValueRef buffer, bool compressed = false)
+    : buffer_(std::move(buffer))
+    , view_(buffer_ ? std::string_view{*buffer_} : std::string_view{})
+    , compressed_(compressed) {}
+  ValueSlice(ValueRef buffer, std::string_view view, bool compressed = false)
+    : buffer_(std::move(buffer))
+    , view_(view)
+    , compressed_(compressed) {}
+
+  explicit operator bool() const { return buffer_ != nullptr; }
+
+  ValueRef buffer_;
+  std::string_view view_;
+  bool compressed_{false};
+};
+
+// a value on its way into storage. compressed ones stay compressed through
+// every hop and are only expanded by whoever hands the value to a user.
+struct EncodedValue {
+  std::string bytes_;
+  bool compressed_{false};
+};
 
 struct NodeAddress {
   bool operator==(const NodeAddress& other) const {
-    return ip_ == other.ip_ && port_ == other.port_;
+    return ip_ == other.ip_ && port_ == other.port_ && vnode_ == other.vnode_;
   }
 
   bool operator!=(const NodeAddress& other) const {
@@ -46,11 +106,43 @@ struct NodeAddress {
   }
 
   [[nodiscard]] std::string ToString() const {
-    return ip_ + ":" + std::to_string(port_);
+    auto address = ip_ + ":" + std::to_string(port_);
+    return vnode_ == 0 ? address : address + "#" + std::to_string(vnode_);
+  }
+
+  // the same process, whichever of its virtual nodes
+  [[nodiscard]] bool SameHost(const NodeAddress& other) const {
+    return ip_ == other.ip_ && port_ == other.port_;
+  }
+
+  // ip_ as a number, most significant octet first, if it is dotted ipv4
+  [[nodiscard]] std::optional<u32> Ipv4() const {
+    u32 packed = 0;
+    const char* at = ip_.data();
+    const char* end = at + ip_.size();
+    for (int octet = 0; octet < 4; ++octet) {
+      if (octet > 0 && (at == end || *at++ != '.')) {
+        return std::nullopt;
+      }
+      u32 value = 0;
+      auto [next, error] = std::from_chars(at, end, value);
+      if (error != std::errc{} || next == at || value > 255) {
+        return std::nullopt;
+      }
+      packed = packed << 8 | value;
+      at = next;
+    }
+    if (at != end) {
+      return std::nullopt;
+    }
+    return packed;
   }
 
   std::string ip_;
   u16 port_;
+  // which of the process's virtual nodes, 0 is the one clients talk to.
+  // part of ToString, so every virtual node hashes to its own id
+  u8 vnode_{0};
 };
 
 struct NodeInfo {
@@ -70,6 +162,39 @@ struct NodeInfo {
   NodeAddress address_;
 };
 
+// one step of a lookup. final_ means node_ is the successor of the id that
+// was asked for, otherwise node_ is the next node to ask
+struct LookupHop {
+  NodeInfo node_;
+  bool final_{false};
+  // further candidates after node_, closest to the id first. only filled in
+  // for lookups that keep several hops in flight
+  std::vector<NodeInfo> more_;
+};
+
+// a node entering or leaving the ring, as passed between full membership
+// tables in one hop mode
+struct MembershipEvent {
+  NodeInfo node_;
+  bool joined_{true};
+};
+
+// what a peer's membership table changed since some point in its history.
+// full_ means the cursor was too old and events_ is every member instead
+struct MembershipDelta {
+  u64 cursor_{0};
+  bool full_{false};
+  std::vector<MembershipEvent> events_;
+};
+
+// how busy a node is with the arc it owns, swapped between ring neighbours
+// for load aware rebalancing
+struct LoadSummary {
+  u64 keys_{0};
+  // gets, puts and deletes answered as owner per second, smoothed
+  u32 requests_{0};
+};
+
 inline bool InRangeExclusive(NodeID id, NodeID start, NodeID end) {
   if (start == end) {
     return id != start;
@@ -0,0 +1,40 @@
+#ifndef ADAPTIVE_INTERVAL_H
+#define ADAPTIVE_INTERVAL_H
+
+#include <algorithm>
+#include <chrono>
+
+namespace tsc::util {
+// how long a maintenance routine waits between rounds.
+//
+// every round that saw nothing change doubles the interval, up to max, so
+// a quiet ring costs a trickle of rpcs. anything that changed puts it back
+// to min at once.
+//
+// not thread safe, the owner locks.
+class AdaptiveInterval {
+public:
+  using Duration = std::chrono::milliseconds;
+
+  AdaptiveInterval(Duration min, Duration max)
+      : min_(min), max_(max), current_(min) {}
+
+  void Relax() { current_ = std::min(current_ * 2, max_); }
+
+  // true if the interval got shorter
+  bool Tighten() {
+    bool shorter = current_ > min_;
+    current_ = min_;
+    return shorter;
+  }
+
+  [[nodiscard]] Duration Current() const { return current_; }
+
+private:
+  Duration min_;
+  Duration max_;
+  Duration current_;
+};
+} // namespace tsc::util
+
+#endif // ADAPTIVE_INTERVAL_H
@@ -0,0 +1,94 @@
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+#include "types/types.h"
+
+namespace tsc::util {
+using namespace tsc::type;
+
+// classic bloom filter using double hashing (Kirsch-Mitzenmacher) over a
+// single 64-bit FNV-1a digest. the hash has to be stable across runs since
+// filters are written to disk alongside the sstables.
+class BloomFilter {
+public:
+  BloomFilter() = default;
+
+  explicit BloomFilter(size_t expected_entries, int bits_per_key = 10)
+    : num_hashes_(NumHashesFor(bits_per_key))
+    , bits_(BytesFor(expected_entries, bits_per_key), 0) {}
+
+  BloomFilter(std::vector<u8> bits, int num_hashes)
+    : num_hashes_(num_hashes)
+    , bits_(std::move(bits)) {}
+
+  void Add(std::string_view key) { AddHash(Hash(key)); }
+
+  [[nodiscard]] bool MayContain(std::string_view key) const {
+    return MayContainHash(Hash(key));
+  }
+
+  // lets a writer collect digests up front and size the filter afterwards
+  void AddHash(u64 h) {
+    if (bits_.empty()) {
+      return;
+    }
+    u64 delta = (h >> 33) | (h << 31);
+    u64 nbits = bits_.size() * 8;
+    for (int i{}; i < num_hashes_; ++i) {
+      u64 bit = h % nbits;
+      bits_[bit / 8] |= static_cast<u8>(1u << (bit % 8));
+      h += delta;
+    }
+  }
+
+  [[nodiscard]] bool MayContainHash(u64 h) const {
+    if (bits_.empty()) {
+      return true;
+    }
+    u64 delta = (h >> 33) | (h << 31);
+    u64 nbits = bits_.size() * 8;
+    for (int i{}; i < num_hashes_; ++i) {
+      u64 bit = h % nbits;
+      if ((bits_[bit / 8] & (1u << (bit % 8))) == 0) {
+        return false;
+      }
+      h += delta;
+    }
+    return true;
+  }
+
+  [[nodiscard]] const std::vector<u8>& Bits() const { return bits_; }
+  [[nodiscard]] int NumHashes() const { return num_hashes_; }
+
+  static u64 Hash(std::string_view key) {
+    u64 h = 14695981039346656037ULL;
+    for (char c : key) {
+      h ^= static_cast<u8>(c);
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+private:
+  static int NumHashesFor(int bits_per_key) {
+    // k = ln(2) * m/n, clamped to something sane
+    int k = static_cast<int>(bits_per_key * 0.69);
+    return std::clamp(k, 1, 30);
+  }
+
+  static size_t BytesFor(size_t entries, int bits_per_key) {
+    // small filters have a terrible false positive rate, so use at least 64 bits
+    size_t bits = std::max<size_t>(entries * bits_per_key, 64);
+    return (bits + 7) / 8;
+  }
+
+  int num_hashes_{0};
+  std::vector<u8> bits_;
+};
+} // namespace tsc::util
+
+#endif // BLOOM_FILTER_H
@@ -0,0 +1,258 @@
+#ifndef CONCURRENT_MAP_H
+#define CONCURRENT_MAP_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "util/epoch.h"
+
+namespace tsc::util {
+// string keyed hash map whose reads never take a lock.
+//
+// buckets are singly linked lists of immutable nodes. writers serialise on a
+// striped mutex and never modify a node in place: an update links in a fresh
+// node and retires the old one through Epoch, so a reader can always finish
+// walking a chain it started on. growing copies every node into a new table
+// and retires the old table as a whole.
+template <typename Value>
+class ConcurrentHashMap {
+public:
+  explicit ConcurrentHashMap(size_t initial_buckets = 1024)
+    : initial_buckets_(std::bit_ceil(std::max(initial_buckets, kStripes)))
+    , table_(new Table(initial_buckets_)) {}
+
+  ~ConcurrentHashMap() { DeleteTable(table_.load()); }
+
+  ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+  ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
+
+  [[nodiscard]] std::optional<Value> Find(std::string_view key) const {
+    size_t hash = Hash(key);
+    EpochGuard guard;
+    const Table* table = table_.load(std::memory_order_acquire);
+    for (const Node* node = table->Bucket(hash).load(std::memory_order_acquire);
+         node != nullptr; node = node->next_.load(std::memory_order_acquire)) {
+      if (node->hash_ == hash && node->key_ == key) {
+        return node->value_;
+      }
+    }
+    return std::nullopt;
+  }
+
+  // insert or overwrite, returns true when the key was new
+  bool Insert(std::string key, Value value) {
+    return !Exchange(std::move(key), std::move(value)).has_value();
+  }
+
+  // insert or overwrite, returns the value that was replaced
+  std::optional<Value> Exchange(std::string key, Value value) {
+    size_t hash = Hash(key);
+    {
+      std::lock_guard lock(stripes_[hash % kStripes]);
+      Table* table = table_.load(std::memory_order_relaxed);
+      auto& head = table->Bucket(hash);
+
+      std::atomic<Node*>* link = &head;
+      Node* node = link->load(std::memory_order_relaxed);
+      while (node != nullptr) {
+        if (node->hash_ == hash && node->key_ == key) {
+          auto* replacement =
+              new Node(std::move(key), hash, std::move(value),
+                       node->next_.load(std::memory_order_relaxed));
+          link->store(replacement, std::memory_order_release);
+          std::optional<Value> previous = node->value_;
+          Epoch::Retire(node);
+          return previous;
+        }
+        link = &node->next_;
+        node = link->load(std::memory_order_relaxed);
+      }
+
+      auto* fresh = new Node(std::move(key), hash, std::move(value),
+                             head.load(std::memory_order_relaxed));
+      head.store(fresh, std::memory_order_release);
+    }
+
+    if (size_.fetch_add(1, std::memory_order_relaxed) + 1 >
+        BucketCount() * kMaxLoad) {
+      Grow();
+    }
+    return std::nullopt;
+  }
+
+  bool Erase(std::string_view key) { return Extract(key).has_value(); }
+
+  // erase, returning the value that was removed
+  std::optional<Value> Extract(std::string_view key) {
+    size_t hash = Hash(key);
+    std::lock_guard lock(stripes_[hash % kStripes]);
+    Table* table = table_.load(std::memory_order_relaxed);
+
+    std::atomic<Node*>* link = &table->Bucket(hash);
+    Node* node = link->load(std::memory_order_relaxed);
+    while (node != nullptr) {
+      if (node->hash_ == hash && node->key_ == key) {
+        link->store(node->next_.load(std::memory_order_relaxed),
+                    std::memory_order_release);
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        std::optional<Value> removed = node->value_;
+        Epoch::Retire(node);
+        return removed;
+      }
+      link = &node->next_;
+      node = link->load(std::memory_order_relaxed);
+    }
+    return std::nullopt;
+  }
+
+  [[nodiscard]] size_t Size() const {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+  // weakly consistent walk, fn returns false to stop
+  void ForEach(
+      const std::function<bool(const std::string&, const Value&)>& fn) const {
+    EpochGuard guard;
+    const Table* table = table_.load(std::memory_order_acquire);
+    for (size_t i{}; i <= table->mask_; ++i) {
+      for (const Node* node = table->buckets_[i].load(std::memory_order_acquire);
+           node != nullptr;
+           node = node->next_.load(std::memory_order_acquire)) {
+        if (!fn(node->key_, node->value_)) {
+          return;
+        }
+      }
+    }
+  }
+
+  // like ForEach but starts at the bucket picked by seed and wraps around,
+  // so a random seed gives a cheap random sample of the entries
+  void SampleFrom(
+      size_t seed,
+      const std::function<bool(const std::string&, const Value&)>& fn) const {
+    EpochGuard guard;
+    const Table* table = table_.load(std::memory_order_acquire);
+    for (size_t i{}; i <= table->mask_; ++i) {
+      const auto& bucket = table->buckets_[(seed + i) & table->mask_];
+      for (const Node* node = bucket.load(std::memory_order_acquire);
+           node != nullptr;
+           node = node->next_.load(std::memory_order_acquire)) {
+        if (!fn(node->key_, node->value_)) {
+          return;
+        }
+      }
+    }
+  }
+
+  void Clear() {
+    auto locks = LockAll();
+    Table* old = table_.exchange(new Table(initial_buckets_),
+                                 std::memory_order_acq_rel);
+    size_.store(0, std::memory_order_relaxed);
+    Epoch::Retire([old] { DeleteTable(old); });
+  }
+
+private:
+  static constexpr size_t kStripes = 64;
+  static constexpr size_t kMaxLoad = 1;
+
+  struct Node {
+    Node(std::string key, size_t hash, Value value, Node* next)
+      : key_(std::move(key))
+      , hash_(hash)
+      , value_(std::move(value))
+      , next_(next) {}
+
+    const std::string key_;
+    const size_t hash_;
+    const Value value_;
+    std::atomic<Node*> next_;
+  };
+
+  // the bucket count is a power of two no smaller than kStripes, so two keys
+  // in the same bucket always map to the same stripe
+  struct Table {
+    explicit Table(size_t buckets)
+      : mask_(buckets - 1)
+      , buckets_(new std::atomic<Node*>[buckets]) {
+      for (size_t i{}; i < buckets; ++i) {
+        buckets_[i].store(nullptr, std::memory_order_relaxed);
+      }
+    }
+
+    std::atomic<Node*>& Bucket(size_t hash) const {
+      return buckets_[hash & mask_];
+    }
+
+    size_t mask_;
+    std::unique_ptr<std::atomic<Node*>[]> buckets_;
+  };
+
+  static size_t Hash(std::string_view key) {
+    return std::hash<std::string_view>{}(key);
+  }
+
+  static void DeleteTable(Table* table) {
+    for (size_t i{}; i <= table->mask_; ++i) {
+      Node* node = table->buckets_[i].load(std::memory_order_relaxed);
+      while (node != nullptr) {
+        Node* next = node->next_.load(std::memory_order_relaxed);
+        delete node;
+        node = next;
+      }
+    }
+    delete table;
+  }
+
+  size_t BucketCount() const {
+    return table_.load(std::memory_order_relaxed)->mask_ + 1;
+  }
+
+  std::array<std::unique_lock<std::mutex>, kStripes> LockAll() {
+    std::array<std::unique_lock<std::mutex>, kStripes> locks;
+    for (size_t i{}; i < kStripes; ++i) {
+      locks[i] = std::unique_lock(stripes_[i]);
+    }
+    return locks;
+  }
+
+  void Grow() {
+    auto locks = LockAll();
+    Table* old = table_.load(std::memory_order_relaxed);
+    size_t buckets = old->mask_ + 1;
+    if (size_.load(std::memory_order_relaxed) <= buckets * kMaxLoad) {
+      return;  // somebody else already grew it
+    }
+
+    // nodes cannot be relinked while readers walk the old chains, so copy
+    auto* table = new Table(buckets * 2);
+    for (size_t i{}; i < buckets; ++i) {
+      for (Node* node = old->buckets_[i].load(std::memory_order_relaxed);
+           node != nullptr; node = node->next_.load(std::memory_order_relaxed)) {
+        auto& head = table->Bucket(node->hash_);
+        head.store(new Node(node->key_, node->hash_, node->value_,
+                            head.load(std::memory_order_relaxed)),
+                   std::memory_order_relaxed);
+      }
+    }
+
+    table_.store(table, std::memory_order_release);
+    Epoch::Retire([old] { DeleteTable(old); });
+  }
+
+  size_t initial_buckets_;
+  std::atomic<Table*> table_;
+  mutable std::array<std::mutex, kStripes> stripes_;
+  std::atomic<size_t> size_{0};
+};
+} // namespace tsc::util
+
+#endif // CONCURRENT_MAP_H
@@ -0,0 +1,148 @@
+#include "util/epoch.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tsc::util {
+namespace {
+constexpr u64 kInactive = std::numeric_limits<u64>::max();
+constexpr size_t kMaxSlots = 512;
+constexpr size_t kReclaimEvery = 64;
+
+struct alignas(64) Slot {
+  std::atomic<u64> epoch_{kInactive};
+  std::atomic<bool> in_use_{false};
+};
+
+struct Retired {
+  u64 tag_;
+  std::function<void()> deleter_;
+};
+
+struct Domain {
+  std::atomic<u64> global_{1};
+  std::array<Slot, kMaxSlots> slots_;
+
+  std::mutex retired_mutex_;
+  std::vector<Retired> retired_;
+  size_t since_reclaim_{0};
+};
+
+// leaked on purpose, thread_local slots may outlive static destruction
+Domain& GetDomain() {
+  static auto* domain = new Domain();
+  return *domain;
+}
+
+class ThreadSlot {
+public:
+  ThreadSlot() {
+    auto& domain = GetDomain();
+    while (true) {
+      for (auto& slot : domain.slots_) {
+        bool expected = false;
+        if (slot.in_use_.compare_exchange_strong(expected, true)) {
+          slot_ = &slot;
+          return;
+        }
+      }
+      // more live threads than slots, wait for one to exit
+      std::this_thread::yield();
+    }
+  }
+
+  ~ThreadSlot() {
+    slot_->epoch_.store(kInactive, std::memory_order_release);
+    slot_->in_use_.store(false, std::memory_order_release);
+  }
+
+  ThreadSlot(const ThreadSlot&) = delete;
+  ThreadSlot& operator=(const ThreadSlot&) = delete;
+
+  Slot* slot_{nullptr};
+  int depth_{0};
+};
+
+ThreadSlot& LocalSlot() {
+  thread_local ThreadSlot slot;
+  return slot;
+}
+} // namespace
+
+Epoch::Guard::Guard() {
+  auto& local = LocalSlot();
+  if (local.depth_++ == 0) {
+    local.slot_->epoch_.store(GetDomain().global_.load());
+    // the slot must be visible before the caller loads any shared pointer
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+}
+
+Epoch::Guard::~Guard() {
+  auto& local = LocalSlot();
+  if (--local.depth_ == 0) {
+    local.slot_->epoch_.store(kInactive, std::memory_order_release);
+  }
+}
+
+void Epoch::Retire(std::function<void()> deleter) {
+  auto& domain = GetDomain();
+  // readers that enter from here on get a newer epoch than the tag
+  u64 tag = domain.global_.fetch_add(1);
+
+  bool reclaim = false;
+  {
+    std::lock_guard lock(domain.retired_mutex_);
+    domain.retired_.push_back({.tag_ = tag, .deleter_ = std::move(deleter)});
+    reclaim = ++domain.since_reclaim_ >= kReclaimEvery;
+  }
+
+  if (reclaim) {
+    Reclaim();
+  }
+}
+
+void Epoch::Reclaim() {
+  auto& domain = GetDomain();
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  u64 oldest = kInactive;
+  for (const auto& slot : domain.slots_) {
+    if (slot.in_use_.load()) {
+      oldest = std::min(oldest, slot.epoch_.load());
+    }
+  }
+
+  std::vector<std::function<void()>> ready;
+  {
+    std::lock_guard lock(domain.retired_mutex_);
+    domain.since_reclaim_ = 0;
+    std::vector<Retired> waiting;
+    for (auto& retired : domain.retired_) {
+      if (retired.tag_ < oldest) {
+        ready.push_back(std::move(retired.deleter_));
+      }
+      else {
+        waiting.push_back(std::move(retired));
+      }
+    }
+    domain.retired_ = std::move(waiting);
+  }
+
+  // run outside the lock, deleters may retire more objects
+  for (auto& deleter : ready) {
+    deleter();
+  }
+}
+
+size_t Epoch::Pending() {
+  auto& domain = GetDomain();
+  std::lock_guard lock(domain.retired_mutex_);
+  return domain.retired_.size();
+}
+} // namespace tsc::util
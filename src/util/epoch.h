@@ -0,0 +1,48 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <functional>
+
+#include "types/types.h"
+
+namespace tsc::util {
+using namespace tsc::type;
+
+// process wide epoch based reclamation.
+//
+// readers wrap every access to shared nodes in an EpochGuard, which only
+// publishes the current epoch into a per-thread slot (no locks, no RMW).
+// writers unlink a node and Retire() it, which tags it with the epoch at
+// that moment and bumps the global epoch. a retired node is freed once every
+// thread that is inside a guard entered after the tag.
+class Epoch {
+public:
+  // RAII read-side critical section, cheap and re-entrant
+  class Guard {
+  public:
+    Guard();
+    ~Guard();
+
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+  };
+
+  // runs deleter once no reader can still observe the retired object
+  static void Retire(std::function<void()> deleter);
+
+  template <typename T>
+  static void Retire(T* ptr) {
+    Retire([ptr] { delete ptr; });
+  }
+
+  // frees everything that has become safe, writers call this periodically
+  static void Reclaim();
+
+  // number of retired objects still waiting on readers
+  static size_t Pending();
+};
+
+using EpochGuard = Epoch::Guard;
+} // namespace tsc::util
+
+#endif // EPOCH_H
@@ -3,6 +3,7 @@
 
 #include <openssl/sha.h>
 #include <cstring>
+#include <string_view>
 
 #include "types/types.h"
 
@@ -10,7 +11,7 @@ namespace tsc::hsh {
 using namespace tsc::type;
 class Hash {
 public:
-  static KeyID HashKey(const std::string& key) {
+  static KeyID HashKey(std::string_view key) {
     return ComputeHash(key);
   }
 
@@ -18,11 +19,12 @@ public:
     return ComputeHash(address.ToString());
   }
 
-  static u32 ComputeHash(const std::string& input) {
+  // the leading bytes of the sha1 digest, as wide as an id
+  static NodeID ComputeHash(std::string_view input) {
     u8 hash[SHA_DIGEST_LENGTH];
-    SHA1(reinterpret_cast<const u8*>(input.c_str()), input.length(), hash);
+    SHA1(reinterpret_cast<const u8*>(input.data()), input.length(), hash);
 
-    u32 result;
+    NodeID result;
     std::memcpy(&result, hash, sizeof(result));
     return result;
   }
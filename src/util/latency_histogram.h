@@ -0,0 +1,78 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+
+#include "types/types.h"
+
+namespace tsc::util {
+using namespace tsc::type;
+
+// lock free log-linear histogram of durations in microseconds. every power
+// of two is split into four buckets, so percentiles are within 25% of the
+// real value whatever the scale, and recording is a single relaxed add.
+class LatencyHistogram {
+public:
+  void Record(std::chrono::microseconds elapsed) {
+    auto us = static_cast<u64>(std::max<i64>(elapsed.count(), 0));
+    buckets_[BucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] u64 Count() const {
+    u64 total = 0;
+    for (const auto& bucket : buckets_) {
+      total += bucket.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  // upper edge of the bucket holding the pct-th percentile, 0 when empty
+  [[nodiscard]] double PercentileMs(double pct) const {
+    u64 total = Count();
+    if (total == 0) {
+      return 0.0;
+    }
+    auto rank = static_cast<u64>(static_cast<double>(total) * pct / 100.0);
+    rank = std::clamp<u64>(rank, 1, total);
+    u64 seen = 0;
+    for (size_t i{}; i < kBuckets; ++i) {
+      seen += buckets_[i].load(std::memory_order_relaxed);
+      if (seen >= rank) {
+        return static_cast<double>(UpperEdge(i)) / 1000.0;
+      }
+    }
+    return static_cast<double>(UpperEdge(kBuckets - 1)) / 1000.0;
+  }
+
+private:
+  static constexpr int kSubBits = 2;
+  static constexpr size_t kSub = size_t{1} << kSubBits;
+  static constexpr size_t kBuckets = 64 * kSub;
+
+  static size_t BucketOf(u64 us) {
+    if (us < kSub) {
+      return us;
+    }
+    int msb = std::bit_width(us) - 1;
+    auto sub = static_cast<size_t>((us >> (msb - kSubBits)) & (kSub - 1));
+    return static_cast<size_t>(msb - kSubBits + 1) * kSub + sub;
+  }
+
+  static u64 UpperEdge(size_t bucket) {
+    if (bucket < kSub) {
+      return bucket;
+    }
+    int msb = static_cast<int>(bucket / kSub) + kSubBits - 1;
+    u64 width = u64{1} << (msb - kSubBits);
+    return ((kSub + bucket % kSub) << (msb - kSubBits)) + width - 1;
+  }
+
+  std::array<std::atomic<u64>, kBuckets> buckets_{};
+};
+} // namespace tsc::util
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,211 @@
+#include "util/lz.h"
+
+#include <array>
+#include <cstring>
+
+namespace tsc::util::lz {
+namespace {
+constexpr size_t kMinMatch = 4;
+constexpr size_t kMaxOffset = 65535;
+constexpr int kHashBits = 12;
+// the last bytes are always literals so the match loop never reads past
+// the end
+constexpr size_t kTailLiterals = 5;
+
+u32 Load32(const char* p) {
+  u32 v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+u32 HashOf(u32 v) {
+  return (v * 2654435761U) >> (32 - kHashBits);
+}
+
+void WriteLength(std::string& out, size_t length) {
+  while (length >= 255) {
+    out.push_back(static_cast<char>(255));
+    length -= 255;
+  }
+  out.push_back(static_cast<char>(length));
+}
+
+void WriteSequence(std::string& out, std::string_view literals,
+                   size_t offset, size_t match_length) {
+  size_t lit = literals.size();
+  size_t ml = match_length ? match_length - kMinMatch : 0;
+
+  u8 token = static_cast<u8>((std::min<size_t>(lit, 15) << 4) |
+                             std::min<size_t>(ml, 15));
+  out.push_back(static_cast<char>(token));
+  if (lit >= 15) {
+    WriteLength(out, lit - 15);
+  }
+  out.append(literals);
+
+  if (match_length == 0) {
+    return;
+  }
+  out.push_back(static_cast<char>(offset & 0xFF));
+  out.push_back(static_cast<char>(offset >> 8));
+  if (ml >= 15) {
+    WriteLength(out, ml - 15);
+  }
+}
+
+// reads a length continuation, false on truncation
+bool ReadLength(std::string_view in, size_t& pos, size_t& length) {
+  while (true) {
+    if (pos >= in.size()) {
+      return false;
+    }
+    u8 b = static_cast<u8>(in[pos++]);
+    length += b;
+    if (b != 255) {
+      return true;
+    }
+  }
+}
+
+bool ReadVarint(std::string_view in, size_t& pos, u64& value) {
+  value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (pos >= in.size()) {
+      return false;
+    }
+    u8 b = static_cast<u8>(in[pos++]);
+    value |= static_cast<u64>(b & 0x7F) << shift;
+    if ((b & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+} // namespace
+
+std::string Compress(std::string_view input) {
+  std::string out;
+  out.reserve(input.size() / 2 + 16);
+
+  u64 raw = input.size();
+  do {
+    u8 b = raw & 0x7F;
+    raw >>= 7;
+    out.push_back(static_cast<char>(raw ? b | 0x80 : b));
+  } while (raw);
+
+  const char* base = input.data();
+  size_t n = input.size();
+  size_t anchor = 0;
+
+  if (n > kMinMatch + kTailLiterals) {
+    std::array<u32, size_t{1} << kHashBits> table{};
+    size_t limit = n - kTailLiterals;
+    size_t pos = 0;
+
+    while (pos + kMinMatch <= limit) {
+      u32 seq = Load32(base + pos);
+      u32 h = HashOf(seq);
+      size_t candidate = table[h];
+      table[h] = static_cast<u32>(pos);
+
+      if (candidate >= pos || pos - candidate > kMaxOffset ||
+          Load32(base + candidate) != seq) {
+        ++pos;
+        continue;
+      }
+
+      size_t length = kMinMatch;
+      while (pos + length < limit &&
+             base[candidate + length] == base[pos + length]) {
+        ++length;
+      }
+
+      WriteSequence(out, input.substr(anchor, pos - anchor), pos - candidate,
+                    length);
+      pos += length;
+      anchor = pos;
+    }
+  }
+
+  WriteSequence(out, input.substr(anchor), 0, 0);
+  return out;
+}
+
+std::optional<std::string> Decompress(std::string_view input) {
+  size_t pos = 0;
+  u64 raw = 0;
+  if (!ReadVarint(input, pos, raw)) {
+    return std::nullopt;
+  }
+  // a sequence can at most expand 255x, refuse anything claiming more
+  if (raw > input.size() * 255 + 64) {
+    return std::nullopt;
+  }
+
+  std::string out(raw, '\0');
+  size_t w = 0;
+
+  while (pos < input.size()) {
+    u8 token = static_cast<u8>(input[pos++]);
+
+    size_t lit = token >> 4;
+    if (lit == 15 && !ReadLength(input, pos, lit)) {
+      return std::nullopt;
+    }
+    if (input.size() - pos < lit || raw - w < lit) {
+      return std::nullopt;
+    }
+    std::memcpy(out.data() + w, input.data() + pos, lit);
+    w += lit;
+    pos += lit;
+
+    if (pos == input.size()) {
+      break;
+    }
+
+    if (input.size() - pos < 2) {
+      return std::nullopt;
+    }
+    size_t offset = static_cast<u8>(input[pos]) |
+                    static_cast<size_t>(static_cast<u8>(input[pos + 1])) << 8;
+    pos += 2;
+
+    size_t length = token & 0x0F;
+    if (length == 15 && !ReadLength(input, pos, length)) {
+      return std::nullopt;
+    }
+    length += kMinMatch;
+
+    if (offset == 0 || offset > w || raw - w < length) {
+      return std::nullopt;
+    }
+    // matches may overlap their own output, so memcpy only when they don't
+    char* dst = out.data() + w;
+    const char* src = dst - offset;
+    if (offset >= length) {
+      std::memcpy(dst, src, length);
+    }
+    else {
+      for (size_t i{}; i < length; ++i) {
+        dst[i] = src[i];
+      }
+    }
+    w += length;
+  }
+
+  if (w != raw) {
+    return std::nullopt;
+  }
+  return out;
+}
+
+std::optional<size_t> RawSize(std::string_view input) {
+  size_t pos = 0;
+  u64 raw = 0;
+  if (!ReadVarint(input, pos, raw)) {
+    return std::nullopt;
+  }
+  return raw;
+}
+} // namespace tsc::util::lz
@@ -0,0 +1,34 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "types/types.h"
+
+namespace tsc::util::lz {
+using namespace tsc::type;
+
+// small LZ77 block codec in the spirit of LZ4, fast enough to sit on the put
+// path. trying to avoid libraries again, and values are small enough that a
+// 64 KiB window catches the repetition in typical JSON.
+//
+//   varint raw_size | sequences
+//   sequence: token (literal len << 4 | match len - 4)
+//             [extra literal len bytes] literals [u16 offset LE
+//             [extra match len bytes]]
+//
+// the last sequence has literals only. a length nibble of 15 continues in
+// extra bytes that each add up to 255.
+
+std::string Compress(std::string_view input);
+
+// nullopt when input is not a well formed block
+std::optional<std::string> Decompress(std::string_view input);
+
+// size the block expands to, read from its header
+std::optional<size_t> RawSize(std::string_view input);
+} // namespace tsc::util::lz
+
+#endif // LZ_H
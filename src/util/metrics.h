@@ -0,0 +1,24 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "types/types.h"
+
+namespace tsc::util {
+using namespace tsc::type;
+
+// one named block in the METRICS:{"modules":[...]} line the python harness
+// reads. security modules, storage and routing all report in this shape.
+struct ModuleMetrics {
+  std::string module_name;
+  std::vector<std::pair<std::string, u64>> counters;
+  std::vector<std::pair<std::string, double>> gauges;
+};
+
+std::string MetricsToJSON(const std::vector<ModuleMetrics>& modules);
+} // namespace tsc::util
+
+#endif // METRICS_H
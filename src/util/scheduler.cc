@@ -0,0 +1,172 @@
+#include "util/scheduler.h"
+
+#include <vector>
+
+namespace tsc::util {
+Scheduler::Scheduler(size_t workers, std::chrono::milliseconds tick)
+    : epoch_(std::chrono::steady_clock::now())
+    , tick_(tick)
+    , wheel_(static_cast<u64>(tick.count()))
+    , pool_(workers)
+    , ticker_([this](std::stop_token stop) { TickLoop(stop); }) {}
+
+Scheduler::~Scheduler() {
+  ticker_.request_stop();
+  cv_.notify_all();
+}
+
+std::shared_ptr<Scheduler> Scheduler::Shared() {
+  static std::mutex mutex;
+  static std::weak_ptr<Scheduler> shared;
+  std::lock_guard lock(mutex);
+  auto scheduler = shared.lock();
+  if (!scheduler) {
+    scheduler = std::make_shared<Scheduler>(kSharedWorkers, kSharedTick);
+    shared = scheduler;
+  }
+  return scheduler;
+}
+
+TimerId Scheduler::After(std::chrono::milliseconds delay, Task task) {
+  TimerId id;
+  bool was_empty;
+  {
+    std::lock_guard lock(mutex_);
+    u64 now = NowMs();
+    was_empty = wheel_.Empty();
+    if (was_empty) {
+      // the wheel stops turning while empty, bring it up to now first
+      wheel_.Advance(now, [](Task&&) {});
+    }
+    id = wheel_.Schedule(now + static_cast<u64>(std::max<i64>(delay.count(), 0)),
+                         std::move(task));
+  }
+  if (was_empty) {
+    cv_.notify_all();
+  }
+  return id;
+}
+
+bool Scheduler::Cancel(TimerId id) {
+  std::lock_guard lock(mutex_);
+  return wheel_.Cancel(id);
+}
+
+size_t Scheduler::Pending() const {
+  std::lock_guard lock(mutex_);
+  return wheel_.Size();
+}
+
+void Scheduler::TickLoop(std::stop_token stop) {
+  std::unique_lock lock(mutex_);
+  while (!stop.stop_requested()) {
+    if (wheel_.Empty()) {
+      cv_.wait(lock, stop, [this] { return !wheel_.Empty(); });
+      continue;
+    }
+    cv_.wait_for(lock, stop, tick_, [] { return false; });
+
+    std::vector<Task> due;
+    wheel_.Advance(NowMs(), [&due](Task&& task) {
+      due.push_back(std::move(task));
+    });
+    if (due.empty()) {
+      continue;
+    }
+    lock.unlock();
+    for (auto& task : due) {
+      pool_.Submit(std::move(task));
+    }
+    lock.lock();
+  }
+}
+
+u64 Scheduler::NowMs() const {
+  return static_cast<u64>(std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - epoch_).count());
+}
+
+Routine::Routine(std::shared_ptr<Scheduler> scheduler,
+                 AdaptiveInterval::Duration min, AdaptiveInterval::Duration max,
+                 std::function<void()> round)
+    : scheduler_(std::move(scheduler))
+    , state_(std::make_shared<State>(AdaptiveInterval(min, max),
+                                     std::move(round))) {}
+
+Routine::~Routine() {
+  Stop();
+}
+
+void Routine::Start() {
+  std::lock_guard lock(state_->mutex_);
+  if (!state_->stopped_) {
+    return;
+  }
+  state_->stopped_ = false;
+  state_->last_end_ = std::chrono::steady_clock::now();
+  Arm(state_, *scheduler_);
+}
+
+void Routine::Tighten() {
+  std::lock_guard lock(state_->mutex_);
+  state_->changed_ = true;
+  if (!state_->interval_.Tighten() || !state_->timer_) {
+    return;
+  }
+  // a timer that already fired has its round on the way anyway
+  if (scheduler_->Cancel(*state_->timer_)) {
+    Arm(state_, *scheduler_);
+  }
+}
+
+void Routine::Stop() {
+  std::unique_lock lock(state_->mutex_);
+  state_->stopped_ = true;
+  if (state_->timer_) {
+    scheduler_->Cancel(*state_->timer_);
+    state_->timer_.reset();
+  }
+  state_->cv_.wait(lock, [this] { return !state_->running_; });
+}
+
+AdaptiveInterval::Duration Routine::Current() const {
+  std::lock_guard lock(state_->mutex_);
+  return state_->interval_.Current();
+}
+
+void Routine::Arm(const std::shared_ptr<State>& state, Scheduler& scheduler) {
+  auto due = state->last_end_ + state->interval_.Current();
+  auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+      due - std::chrono::steady_clock::now());
+  state->timer_ = scheduler.After(wait, [state, &scheduler] {
+    Run(state, scheduler);
+  });
+}
+
+void Routine::Run(const std::shared_ptr<State>& state, Scheduler& scheduler) {
+  {
+    std::lock_guard lock(state->mutex_);
+    if (state->stopped_ || state->running_) {
+      return;
+    }
+    state->timer_.reset();
+    state->running_ = true;
+    state->changed_ = false;
+  }
+
+  state->round_();
+
+  {
+    std::lock_guard lock(state->mutex_);
+    state->running_ = false;
+    if (!state->changed_) {
+      state->interval_.Relax();
+    }
+    state->last_end_ = std::chrono::steady_clock::now();
+    if (!state->stopped_) {
+      Arm(state, scheduler);
+    }
+  }
+  state->cv_.notify_all();
+}
+} // namespace tsc::util
@@ -0,0 +1,115 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "types/types.h"
+#include "util/adaptive_interval.h"
+#include "util/thread_pool.h"
+#include "util/timer_wheel.h"
+
+namespace tsc::util {
+using namespace tsc::type;
+
+// runs callbacks after a delay, for every node in the process.
+//
+// timers sit in a TimerWheel driven by one ticker thread, so a pending
+// timer costs a list entry rather than a sleeping thread and cancelling one
+// takes effect at once. callbacks run on a small pool, never on the ticker,
+// so a round stuck on the network holds up its worker and not the clock.
+class Scheduler {
+public:
+  using Task = std::function<void()>;
+
+  Scheduler(size_t workers, std::chrono::milliseconds tick);
+  ~Scheduler();
+
+  Scheduler(const Scheduler&) = delete;
+  Scheduler& operator=(const Scheduler&) = delete;
+
+  // the process wide one, made on first use and gone with its last user
+  static std::shared_ptr<Scheduler> Shared();
+
+  TimerId After(std::chrono::milliseconds delay, Task task);
+
+  // false if it already fired or never existed
+  bool Cancel(TimerId id);
+
+  [[nodiscard]] size_t Pending() const;
+
+private:
+  static constexpr size_t kSharedWorkers = 4;
+  static constexpr auto kSharedTick = std::chrono::milliseconds(10);
+
+  void TickLoop(std::stop_token stop);
+
+  [[nodiscard]] u64 NowMs() const;
+
+  const std::chrono::steady_clock::time_point epoch_;
+  const std::chrono::milliseconds tick_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable_any cv_;
+  TimerWheel<Task> wheel_;
+  ThreadPool pool_;
+  // declared last, the ticker must stop before the pool and wheel go
+  std::jthread ticker_;
+};
+
+// one maintenance task run over and over on a scheduler, each round due an
+// AdaptiveInterval after the previous one finished. rounds never overlap.
+class Routine {
+public:
+  Routine(std::shared_ptr<Scheduler> scheduler, AdaptiveInterval::Duration min,
+          AdaptiveInterval::Duration max, std::function<void()> round);
+  ~Routine();
+
+  Routine(const Routine&) = delete;
+  Routine& operator=(const Routine&) = delete;
+
+  // first round after the min interval
+  void Start();
+
+  // something changed, the next round comes after the min interval from
+  // the end of the last one, sooner than already planned if need be
+  void Tighten();
+
+  // no rounds once this returns, waiting out one that is running
+  void Stop();
+
+  [[nodiscard]] AdaptiveInterval::Duration Current() const;
+
+private:
+  // shared with the pending callback, which may outlive the routine
+  struct State {
+    State(AdaptiveInterval interval, std::function<void()> round)
+        : interval_(interval), round_(std::move(round)) {}
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    AdaptiveInterval interval_;
+    std::function<void()> round_;
+    std::optional<TimerId> timer_;
+    std::chrono::steady_clock::time_point last_end_;
+    bool running_{false};
+    bool stopped_{true};
+    // Tighten was called while the round ran
+    bool changed_{false};
+  };
+
+  // with the state's mutex held
+  static void Arm(const std::shared_ptr<State>& state, Scheduler& scheduler);
+  static void Run(const std::shared_ptr<State>& state, Scheduler& scheduler);
+
+  std::shared_ptr<Scheduler> scheduler_;
+  std::shared_ptr<State> state_;
+};
+} // namespace tsc::util
+
+#endif // SCHEDULER_H
@@ -0,0 +1,48 @@
+#include "util/thread_pool.h"
+
+namespace tsc::util {
+ThreadPool::ThreadPool(size_t workers) {
+  workers_.reserve(workers);
+  for (size_t i{}; i < workers; ++i) {
+    workers_.emplace_back([this](std::stop_token stop) { WorkerLoop(stop); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  for (auto& worker : workers_) {
+    worker.request_stop();
+  }
+  cv_.notify_all();
+  workers_.clear();
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+  {
+    std::lock_guard lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  cv_.notify_one();
+}
+
+size_t ThreadPool::Pending() const {
+  std::lock_guard lock(mutex_);
+  return tasks_.size();
+}
+
+void ThreadPool::WorkerLoop(std::stop_token stop) {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock lock(mutex_);
+      // wakes for work or for a stop, then drains before leaving
+      cv_.wait(lock, stop, [this] { return !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+} // namespace tsc::util
@@ -0,0 +1,47 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "types/types.h"
+
+namespace tsc::util {
+using namespace tsc::type;
+
+// fixed set of workers draining one fifo queue.
+//
+// destruction stops new work from being picked up only once the queue is
+// empty, so every submitted task runs exactly once. tasks that block on the
+// network therefore hold up shutdown by at most their own timeout.
+class ThreadPool {
+public:
+  explicit ThreadPool(size_t workers);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  void Submit(std::function<void()> task);
+
+  // tasks queued but not yet picked up
+  [[nodiscard]] size_t Pending() const;
+
+  [[nodiscard]] size_t Workers() const { return workers_.size(); }
+
+private:
+  void WorkerLoop(std::stop_token stop);
+
+  mutable std::mutex mutex_;
+  std::condition_variable_any cv_;
+  std::deque<std::function<void()>> tasks_;
+  // declared last, workers must stop before the queue goes away
+  std::vector<std::jthread> workers_;
+};
+} // namespace tsc::util
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,144 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <algorithm>
+#include <array>
+#include <list>
+#include <unordered_map>
+
+#include "types/types.h"
+
+namespace tsc::util {
+using namespace tsc::type;
+
+using TimerId = u64;
+
+// hierarchical timing wheel (Varghese & Lauck) with four levels of 64 slots.
+//
+// level n slots are 64^n ticks wide. a timer is filed in the lowest level
+// whose span covers its distance from now, and drops one level each time the
+// wheel below it wraps. insert and cancel are O(1), advancing is O(1) per
+// tick plus the cascades, which amortise to O(1) per timer. deadlines beyond
+// 64^4 ticks are parked in the last slot and re-filed when they come round.
+//
+// not thread safe, the owner locks.
+template <typename T>
+class TimerWheel {
+public:
+  explicit TimerWheel(u64 tick_ms, u64 now_ms = 0)
+    : tick_ms_(tick_ms)
+    , current_tick_(now_ms / tick_ms) {}
+
+  TimerId Schedule(u64 deadline_ms, T value) {
+    TimerId id = next_id_++;
+    // round up so nothing fires early, and never file a timer in the past,
+    // it fires on the next tick instead
+    u64 tick = std::max((deadline_ms + tick_ms_ - 1) / tick_ms_,
+                        current_tick_ + 1);
+    auto& slot = SlotFor(tick);
+    slot.push_front(Timer{.id_ = id, .tick_ = tick, .slot_ = &slot,
+                          .value_ = std::move(value)});
+    index_[id] = slot.begin();
+    return id;
+  }
+
+  bool Cancel(TimerId id) {
+    auto it = index_.find(id);
+    if (it == index_.end()) {
+      return false;
+    }
+    it->second->slot_->erase(it->second);
+    index_.erase(it);
+    return true;
+  }
+
+  // fires fn(T&&) for every timer whose deadline is <= now_ms
+  template <typename Fn>
+  size_t Advance(u64 now_ms, Fn&& fn) {
+    u64 target = now_ms / tick_ms_;
+    size_t fired = 0;
+
+    if (index_.empty()) {
+      current_tick_ = std::max(current_tick_, target);
+      return 0;
+    }
+
+    while (current_tick_ < target) {
+      ++current_tick_;
+
+      // wrap lower levels into place before firing this tick's slot
+      for (size_t level = 1; level < kLevels; ++level) {
+        if ((current_tick_ & ((1ULL << (kBits * level)) - 1)) != 0) {
+          break;
+        }
+        Cascade(level);
+      }
+
+      auto& slot = levels_[0][current_tick_ & kMask];
+      while (!slot.empty()) {
+        Timer timer = std::move(slot.front());
+        slot.pop_front();
+        index_.erase(timer.id_);
+        fn(std::move(timer.value_));
+        ++fired;
+      }
+
+      if (index_.empty()) {
+        current_tick_ = target;
+      }
+    }
+    return fired;
+  }
+
+  [[nodiscard]] size_t Size() const { return index_.size(); }
+  [[nodiscard]] bool Empty() const { return index_.empty(); }
+  [[nodiscard]] u64 TickMs() const { return tick_ms_; }
+
+private:
+  static constexpr size_t kBits = 6;
+  static constexpr size_t kSlots = 1 << kBits;
+  static constexpr u64 kMask = kSlots - 1;
+  static constexpr size_t kLevels = 4;
+
+  struct Timer;
+  using Slot = std::list<Timer>;
+
+  struct Timer {
+    TimerId id_;
+    u64 tick_;
+    Slot* slot_;
+    T value_;
+  };
+
+  Slot& SlotFor(u64 tick) {
+    u64 delta = tick - current_tick_;
+    for (size_t level = 0; level < kLevels; ++level) {
+      if (delta < (1ULL << (kBits * (level + 1)))) {
+        return levels_[level][(tick >> (kBits * level)) & kMask];
+      }
+    }
+    // out of range, park it in the furthest slot of the top level
+    u64 parked = current_tick_ + (1ULL << (kBits * kLevels)) - 1;
+    return levels_[kLevels - 1][(parked >> (kBits * (kLevels - 1))) & kMask];
+  }
+
+  void Cascade(size_t level) {
+    auto& slot = levels_[level][(current_tick_ >> (kBits * level)) & kMask];
+    while (!slot.empty()) {
+      auto it = slot.begin();
+      auto& target = SlotFor(std::max(it->tick_, current_tick_));
+      // splice keeps the iterator in index_ valid
+      target.splice(target.begin(), slot, it);
+      it->slot_ = &target;
+    }
+  }
+
+  u64 tick_ms_;
+  u64 current_tick_;
+  TimerId next_id_{1};
+  std::array<std::array<Slot, kSlots>, kLevels> levels_;
+  std::unordered_map<TimerId, typename Slot::iterator> index_;
+};
+} // namespace tsc::util
+
+#endif // TIMER_WHEEL_H
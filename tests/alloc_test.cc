@@ -0,0 +1,83 @@
+// a value read off the wire is allocated once and that buffer is what ends
+// up stored. decode, encode, the record trailer and the backend all move it
+// along, so any step that copies shows up here as a second big allocation
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+
+#include "node/node.h"
+#include "protocol/message.h"
+
+using namespace tsc::msg;
+
+namespace {
+int failures = 0;
+
+// only this thread's allocations at least this big count, so the node's own
+// threads and the small bookkeeping on the way do not
+thread_local size_t watch_from = 0;
+thread_local size_t big_allocations = 0;
+
+void Check(bool ok, const char* what, size_t value_size) {
+  if (!ok) {
+    std::cerr << "FAIL " << what << " for " << value_size << " bytes\n";
+    ++failures;
+  }
+}
+
+void PutFromWire(tsc::node::Node& node, size_t value_size,
+                 std::chrono::milliseconds ttl) {
+  PutRequest put;
+  put.key_ = "key" + std::to_string(value_size) + "/" +
+             std::to_string(ttl.count());
+  put.value_ = std::string(value_size, 'v');
+  put.ttl_ms_ = static_cast<tsc::type::u64>(ttl.count());
+  auto wire = put.Serialise();
+
+  big_allocations = 0;
+  watch_from = value_size;
+  auto got = PutRequest::Deserialise(wire);
+  bool stored = node.Put(got.key_, std::move(got.value_),
+                         std::chrono::milliseconds(got.ttl_ms_));
+  watch_from = 0;
+
+  Check(stored, "put", value_size);
+  Check(big_allocations == 1, "allocations", value_size);
+  if (big_allocations != 1) {
+    std::cerr << "  " << big_allocations << " allocations of at least "
+              << value_size << " bytes\n";
+  }
+  auto back = node.Get(put.key_);
+  Check(back && *back == put.value_, "get", value_size);
+}
+} // namespace
+
+void* operator new(size_t size) {
+  if (watch_from != 0 && size >= watch_from) {
+    ++big_allocations;
+  }
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+int main() {
+  // never started, a lone node owns the whole ring so every put is local
+  tsc::node::Node node(tsc::node::Node::Config{.port_ = 18631});
+  for (size_t size : {4096, 65536, 1 << 20}) {
+    PutFromWire(node, size, {});
+    PutFromWire(node, size, std::chrono::minutes(5));
+  }
+  if (failures == 0) {
+    std::cout << "alloc_test passed\n";
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+// a framed request comes off the socket whole however the wire splits it.
+// the case that matters is a replica put whose ttl and flags straddle one
+// of the reader's buffer steps: cut short there it would parse as a plain
+// client put with no ttl
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "net/tcp_server.h"
+#include "protocol/message.h"
+
+using namespace tsc::msg;
+using tsc::tcp::TcpServer;
+
+namespace {
+int failures = 0;
+
+void Check(bool ok, const char* what, size_t at) {
+  if (!ok) {
+    std::cerr << "FAIL " << what << " at " << at << '\n';
+    ++failures;
+  }
+}
+
+// writes bytes in two parts with a pause between, so the reader sees the
+// first part on its own
+void WriteSplit(int socket, const std::vector<std::byte>& bytes,
+                size_t split) {
+  (void)!write(socket, bytes.data(), split);
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  (void)!write(socket, bytes.data() + split, bytes.size() - split);
+}
+
+void ReplicaPutAcross(size_t boundary, size_t short_by, tsc::type::u8 vnode) {
+  PutRequest put;
+  put.key_ = "key";
+  put.ttl_ms_ = 0x0102030405060708;
+  put.encoded_ = true;
+  put.compressed_ = true;
+  put.replica_ = true;
+  // header, envelope, type, key, value length
+  size_t fixed = kFrameHeader + (vnode != 0 ? 2 : 0) + 1 + 4 + 3 + 4;
+  put.value_ = std::string(boundary - short_by - fixed, 'v');
+
+  auto body = put.Serialise();
+  auto wire = RequestHeader(vnode, body.size());
+  size_t trailer = wire.size() + body.size() - 9;
+  wire.insert(wire.end(), body.begin(), body.end());
+
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+    Check(false, "socketpair", boundary - short_by);
+    return;
+  }
+  timeval tv{.tv_sec = 1, .tv_usec = 0};
+  setsockopt(sockets[0], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  std::thread writer(WriteSplit, sockets[1], std::cref(wire), trailer);
+  std::vector<std::byte> buffer;
+  auto request = TcpServer::ReadRequest(sockets[0], buffer);
+  writer.join();
+  close(sockets[0]);
+  close(sockets[1]);
+
+  size_t at = boundary - short_by;
+  Check(request.has_value(), "read", at);
+  if (!request) {
+    return;
+  }
+  std::span<std::byte> message = *request;
+  auto unwrapped = UnwrapVNode(message);
+  Check(unwrapped && *unwrapped == vnode, "vnode", at);
+  auto got = PutRequest::Deserialise(message);
+  Check(got.key_ == put.key_ && got.value_ == put.value_, "value", at);
+  Check(got.ttl_ms_ == put.ttl_ms_, "ttl", at);
+  Check(got.encoded_ && got.compressed_ && got.replica_ && !got.owned_,
+        "flags", at);
+}
+} // namespace
+
+int main() {
+  for (size_t boundary : {4096, 8192, 16384}) {
+    for (size_t short_by = 0; short_by <= 12; ++short_by) {
+      ReplicaPutAcross(boundary, short_by, 0);
+    }
+    ReplicaPutAcross(boundary, 4, 3);
+  }
+  if (failures == 0) {
+    std::cout << "framing_test passed\n";
+  }
+  return failures == 0 ? 0 : 1;
+}